@@ -3,4 +3,5 @@ cd pawn/source/compiler
 cmake -G "Unix Makefiles"
 make
 cp pawncc ../../../bin
+cp pawnccd ../../../bin
 cd ../../../
@@ -2,6 +2,25 @@
 """
 include_path = 'include/'
 
-# use this format string with tuple (input_file,include_path,output_file)
-pawn_cmd_line = 'bin/pawncc %s -V2048 -O2 -S64 -v2 -C- -i%s TARGET_PLEO=100 TARGET=100 -o%s'
+# use this format string with tuple (input_file,include_path,index_dir,output_file) -
+# index_dir holds the resource ID includes pleo_build generates (sounds.inc, motions.inc)
+pawn_cmd_line = 'bin/pawncc %s -V2048 -O2 -S64 -v2 -C- -i%s -i%s TARGET_PLEO=100 TARGET=100 -o%s'
 
+# pawncc compile server, used for pawn_cmd_line when it has been built - use
+# this format string with tuple (socket_file,include_path)
+pawn_server_cmd_line = 'bin/pawnccd -s %s -p %s -t 60'
+
+# use this format string with tuple (output_dir,manifest_file) - manifest lines are "path name"
+usf_batch_cmd_line = 'pleofiles/standalone/usf_batch -o %s %s'
+
+# use this format string with tuple (archive_file,staging_dir,list_file) - list lines are
+# staged files ("sounds/name.UGSF"), in UPF order
+urf_tool_cmd_line = 'pleofiles/standalone/urf_tool c %s %s %s'
+
+# compile motion CSVs to UGMF with csv2umf - our packing of UGMF isn't checked
+# against Ugobe's tools, so it's off unless asked for (CSV motions are then
+# left out of the URF with a warning)
+build_umf_motions = False
+
+# use this format string with tuple (cache_dir,umf_file,csv_file,motion_name)
+csv2umf_cmd_line = 'pleofiles/standalone/csv2umf -c %s -o %s %s %s'
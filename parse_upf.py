@@ -1,43 +1,121 @@
-from BeautifulSoup import BeautifulSoup
 import sys
+import re
 import pprint
 """ A really hackish little UPF parser
+
+    Uses the native reader (pleofiles/_pleoproject.so, see pleofiles/Makefile)
+    when it has been built, BeautifulSoup otherwise.
 """
+try:
+   from pleofiles import pleoproject
+except ImportError:
+   pleoproject = None
+
+VAR_REFERENCE = re.compile(r'\$\{([^}]*)\}')
 
-def expand_path(vars,path,passes=3):
-    """ expands a path using the variables provided
-        does multiple passes, not the correct way to do stuff, but works
+def expand_path(vars,path,resolving=None):
+    """ expands ${VAR} references in a path using the variables provided,
+        each variable being expanded (in vars) the first time it's used.
+        Unknown variables are left as written, as the native reader does
     """
-    for x in xrange(passes):
-        for k,v in vars.items():
-            path = path.replace('${%s}' % k,v)
-    return path
+    if resolving is None:
+       resolving = {}
+    def expand_reference(match):
+        name = match.group(1)
+        if not vars.has_key(name):
+           return match.group(0)
+        if resolving.get(name) == 1:
+           raise Exception('${%s} refers back to itself' % name)
+        if resolving.get(name) != 2:
+           resolving[name] = 1
+           vars[name] = expand_path(vars,vars[name],resolving)
+           resolving[name] = 2
+        return vars[name]
+    return VAR_REFERENCE.sub(expand_reference,path)
+
+def read_native_project(project):
+    """ Converts a pleoproject.pleo_project_type already read into the
+        parse_upf_str result, with options & include directories added
+    """
+    retval = {}
+    retval['proj_name'] = project.m_project_name
+    retval['variables'] = {}
+    for i in xrange(project.get_entry_count(pleoproject.PLEO_PROJECT_VARIABLE)):
+        retval['variables'][project.get_entry_name(pleoproject.PLEO_PROJECT_VARIABLE,i)] = project.get_entry_value(pleoproject.PLEO_PROJECT_VARIABLE,i)
+    retval['resources'] = {}
+    retval['resources']['scripts'] = []
+    retval['resources']['sounds']  = []
+    retval['resources']['motions'] = []
+    for i in xrange(project.get_entry_count(pleoproject.PLEO_PROJECT_RESOURCE)):
+        tag = project.get_entry_name(pleoproject.PLEO_PROJECT_RESOURCE,i)
+        retval['resources'].setdefault(tag+'s',[]).append(project.get_entry_value(pleoproject.PLEO_PROJECT_RESOURCE,i))
+    retval['options'] = {}
+    for i in xrange(project.get_entry_count(pleoproject.PLEO_PROJECT_OPTION)):
+        retval['options'][project.get_entry_name(pleoproject.PLEO_PROJECT_OPTION,i)] = project.get_entry_value(pleoproject.PLEO_PROJECT_OPTION,i)
+    retval['include'] = []
+    for i in xrange(project.get_entry_count(pleoproject.PLEO_PROJECT_INCLUDE)):
+        retval['include'].append(project.get_entry_value(pleoproject.PLEO_PROJECT_INCLUDE,i))
+    return retval
 
 def parse_upf_str(s):
     """ Parses a UPF file passed as a long string
     """
+    if pleoproject:
+       project = pleoproject.pleo_project_type()
+       if project.read_project_image(s,len(s)) < 0:
+          print project.m_error
+          raise Exception('Parse error')
+       return read_native_project(project)
+
+    return parse_upf_soup(s)
+
+def parse_upf_soup(s):
+    """ Parses a UPF string with BeautifulSoup, giving the same result as
+        the native reader
+    """
+    from BeautifulSoup import BeautifulSoup
     soup = BeautifulSoup(s)
     try:
+       project = soup.find('ugobe_project')
        retval = {}
-       retval['proj_name'] = soup.contents[0]['name']
+       retval['proj_name'] = project.get('name','')
        retval['variables'] = {}
-       for varset in soup.findAll('set'):
-           retval['variables'][varset['name']] = varset['value']
-       for varset in soup.findAll('set-default'):
-           retval['variables'][varset['name']] = varset['value']
        retval['resources'] = {}
        retval['resources']['scripts'] = []
        retval['resources']['sounds']  = []
        retval['resources']['motions'] = []
-       resources = soup.find('resources')
+       retval['options'] = {}
+       retval['include'] = []
        vars = retval['variables']
-       for script in resources.findAll('script'):
-           retval['resources']['scripts'].append(expand_path(vars,script['path']))
-       for sound in resources.findAll('sound'):
-           retval['resources']['sounds'].append(expand_path(vars,sound['path']))
-       for motion in resources.findAll('motion'):
-           retval['resources']['motions'].append(expand_path(vars,motion['path']))
- 
+       defaults = {}
+       options = []
+       for element in project.findAll(True):
+           parents = [parent.name for parent in element.findParents()]
+           parents.reverse()
+           if element.name in ('set','set-default'):
+              # <set> replaces anything, <set-default> only another default
+              name = element.get('name')
+              is_default = (element.name == 'set-default')
+              if name is not None and (not vars.has_key(name) or not is_default or defaults[name]):
+                 vars[name] = element.get('value','')
+                 defaults[name] = is_default
+           elif 'resources' in parents and element.get('path') is not None:
+              retval['resources'].setdefault(element.name+'s',[]).append(element['path'])
+           elif 'options' in parents and element.get('value') is not None:
+              below = parents[parents.index('options')+1:]
+              options.append(('/'.join(below+[element.name]),element['value']))
+
+       resolving = {}
+       for name in vars.keys():
+           expand_path(vars,'${%s}' % name,resolving)
+       for paths in retval['resources'].values():
+           for i in xrange(len(paths)):
+               paths[i] = expand_path(vars,paths[i],resolving)
+       for name,value in options:
+           value = expand_path(vars,value,resolving)
+           retval['options'][name] = value
+           if name == 'include':
+              retval['include'] += [dir for dir in value.split(':') if dir]
     except Exception,e:
        print e
        raise Exception('Parse error')
@@ -46,6 +124,12 @@ def parse_upf_str(s):
 def parse_upf_file(filename):
     """ Parses a UPF file
     """
+    if pleoproject:
+       project = pleoproject.pleo_project_type()
+       if project.read_project_file(filename) < 0:
+          print project.m_error
+          raise Exception('Parse error')
+       return read_native_project(project)
     f = open(filename,'r')
     data = f.read()
     f.close()
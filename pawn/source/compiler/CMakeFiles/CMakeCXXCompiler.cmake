@@ -1,36 +0,0 @@
-SET(CMAKE_CXX_COMPILER "/usr/lib/ccache/c++")
-SET(CMAKE_CXX_COMPILER_ARG1 "")
-SET(CMAKE_CXX_COMPILER_ID "GNU")
-SET(CMAKE_CXX_PLATFORM_ID "Linux")
-SET(CMAKE_AR "/usr/bin/ar")
-SET(CMAKE_RANLIB "/usr/bin/ranlib")
-SET(CMAKE_COMPILER_IS_GNUCXX 1)
-SET(CMAKE_CXX_COMPILER_LOADED 1)
-SET(CMAKE_COMPILER_IS_MINGW )
-SET(CMAKE_COMPILER_IS_CYGWIN )
-IF(CMAKE_COMPILER_IS_CYGWIN)
-  SET(CYGWIN 1)
-  SET(UNIX 1)
-ENDIF(CMAKE_COMPILER_IS_CYGWIN)
-
-SET(CMAKE_CXX_COMPILER_ENV_VAR "CXX")
-
-IF(CMAKE_COMPILER_IS_MINGW)
-  SET(MINGW 1)
-ENDIF(CMAKE_COMPILER_IS_MINGW)
-SET(CMAKE_CXX_COMPILER_ID_RUN 1)
-SET(CMAKE_CXX_IGNORE_EXTENSIONS inl;h;H;o;O;obj;OBJ;def;DEF;rc;RC)
-SET(CMAKE_CXX_SOURCE_FILE_EXTENSIONS C;M;c++;cc;cpp;cxx;m;mm)
-SET(CMAKE_CXX_LINKER_PREFERENCE 30)
-
-# Save compiler ABI information.
-SET(CMAKE_CXX_SIZEOF_DATA_PTR "4")
-SET(CMAKE_CXX_COMPILER_ABI "ELF")
-
-IF(CMAKE_CXX_SIZEOF_DATA_PTR)
-  SET(CMAKE_SIZEOF_VOID_P "${CMAKE_CXX_SIZEOF_DATA_PTR}")
-ENDIF(CMAKE_CXX_SIZEOF_DATA_PTR)
-
-IF(CMAKE_CXX_COMPILER_ABI)
-  SET(CMAKE_INTERNAL_PLATFORM_ABI "${CMAKE_CXX_COMPILER_ABI}")
-ENDIF(CMAKE_CXX_COMPILER_ABI)
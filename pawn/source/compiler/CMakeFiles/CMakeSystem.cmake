@@ -1,15 +0,0 @@
-
-
-SET(CMAKE_SYSTEM "Linux-2.6.27.19-170.2.35.fc10.i686")
-SET(CMAKE_SYSTEM_NAME "Linux")
-SET(CMAKE_SYSTEM_VERSION "2.6.27.19-170.2.35.fc10.i686")
-SET(CMAKE_SYSTEM_PROCESSOR "i686")
-
-SET(CMAKE_HOST_SYSTEM "Linux-2.6.27.19-170.2.35.fc10.i686")
-SET(CMAKE_HOST_SYSTEM_NAME "Linux")
-SET(CMAKE_HOST_SYSTEM_VERSION "2.6.27.19-170.2.35.fc10.i686")
-SET(CMAKE_HOST_SYSTEM_PROCESSOR "i686")
-
-SET(CMAKE_CROSSCOMPILING "FALSE")
-
-SET(CMAKE_SYSTEM_LOADED 1)
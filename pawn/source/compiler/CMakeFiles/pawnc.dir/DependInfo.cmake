@@ -1,38 +0,0 @@
-# The set of languages for which implicit dependencies are needed:
-SET(CMAKE_DEPENDS_LANGUAGES
-  "C"
-  )
-# The set of files for implicit dependencies of each language:
-SET(CMAKE_DEPENDS_CHECK_C
-  "/home/gareth/open_pdk/pawn/source/linux/binreloc.c" "/home/gareth/open_pdk/pawn/source/compiler/CMakeFiles/pawnc.dir/home/gareth/open_pdk/pawn/source/linux/binreloc.o"
-  "/home/gareth/open_pdk/pawn/source/compiler/libpawnc.c" "/home/gareth/open_pdk/pawn/source/compiler/CMakeFiles/pawnc.dir/libpawnc.o"
-  "/home/gareth/open_pdk/pawn/source/compiler/lstring.c" "/home/gareth/open_pdk/pawn/source/compiler/CMakeFiles/pawnc.dir/lstring.o"
-  "/home/gareth/open_pdk/pawn/source/compiler/memfile.c" "/home/gareth/open_pdk/pawn/source/compiler/CMakeFiles/pawnc.dir/memfile.o"
-  "/home/gareth/open_pdk/pawn/source/compiler/sc1.c" "/home/gareth/open_pdk/pawn/source/compiler/CMakeFiles/pawnc.dir/sc1.o"
-  "/home/gareth/open_pdk/pawn/source/compiler/sc2.c" "/home/gareth/open_pdk/pawn/source/compiler/CMakeFiles/pawnc.dir/sc2.o"
-  "/home/gareth/open_pdk/pawn/source/compiler/sc3.c" "/home/gareth/open_pdk/pawn/source/compiler/CMakeFiles/pawnc.dir/sc3.o"
-  "/home/gareth/open_pdk/pawn/source/compiler/sc4.c" "/home/gareth/open_pdk/pawn/source/compiler/CMakeFiles/pawnc.dir/sc4.o"
-  "/home/gareth/open_pdk/pawn/source/compiler/sc5.c" "/home/gareth/open_pdk/pawn/source/compiler/CMakeFiles/pawnc.dir/sc5.o"
-  "/home/gareth/open_pdk/pawn/source/compiler/sc6.c" "/home/gareth/open_pdk/pawn/source/compiler/CMakeFiles/pawnc.dir/sc6.o"
-  "/home/gareth/open_pdk/pawn/source/compiler/sc7.c" "/home/gareth/open_pdk/pawn/source/compiler/CMakeFiles/pawnc.dir/sc7.o"
-  "/home/gareth/open_pdk/pawn/source/compiler/scexpand.c" "/home/gareth/open_pdk/pawn/source/compiler/CMakeFiles/pawnc.dir/scexpand.o"
-  "/home/gareth/open_pdk/pawn/source/compiler/sci18n.c" "/home/gareth/open_pdk/pawn/source/compiler/CMakeFiles/pawnc.dir/sci18n.o"
-  "/home/gareth/open_pdk/pawn/source/compiler/sclist.c" "/home/gareth/open_pdk/pawn/source/compiler/CMakeFiles/pawnc.dir/sclist.o"
-  "/home/gareth/open_pdk/pawn/source/compiler/scmemfil.c" "/home/gareth/open_pdk/pawn/source/compiler/CMakeFiles/pawnc.dir/scmemfil.o"
-  "/home/gareth/open_pdk/pawn/source/compiler/scstate.c" "/home/gareth/open_pdk/pawn/source/compiler/CMakeFiles/pawnc.dir/scstate.o"
-  "/home/gareth/open_pdk/pawn/source/compiler/scvars.c" "/home/gareth/open_pdk/pawn/source/compiler/CMakeFiles/pawnc.dir/scvars.o"
-  )
-SET(CMAKE_C_COMPILER_ID "GNU")
-
-# Preprocessor definitions for this target.
-SET(CMAKE_TARGET_DEFINITIONS
-  "HAVE_UNISTD_H"
-  "HAVE_INTTYPES_H"
-  "HAVE_STDINT_H"
-  "HAVE_ALLOCA_H"
-  "ENABLE_BINRELOC"
-  )
-
-# Targets to which this target links.
-SET(CMAKE_TARGET_LINKED_INFO_FILES
-  )
@@ -1,27 +0,0 @@
-FILE(REMOVE_RECURSE
-  "CMakeFiles/pawnc.dir/sc1.o"
-  "CMakeFiles/pawnc.dir/sc2.o"
-  "CMakeFiles/pawnc.dir/sc3.o"
-  "CMakeFiles/pawnc.dir/sc4.o"
-  "CMakeFiles/pawnc.dir/sc5.o"
-  "CMakeFiles/pawnc.dir/sc6.o"
-  "CMakeFiles/pawnc.dir/sc7.o"
-  "CMakeFiles/pawnc.dir/scexpand.o"
-  "CMakeFiles/pawnc.dir/sci18n.o"
-  "CMakeFiles/pawnc.dir/sclist.o"
-  "CMakeFiles/pawnc.dir/scmemfil.o"
-  "CMakeFiles/pawnc.dir/scstate.o"
-  "CMakeFiles/pawnc.dir/scvars.o"
-  "CMakeFiles/pawnc.dir/lstring.o"
-  "CMakeFiles/pawnc.dir/memfile.o"
-  "CMakeFiles/pawnc.dir/libpawnc.o"
-  "CMakeFiles/pawnc.dir/home/gareth/open_pdk/pawn/source/linux/binreloc.o"
-  "libpawnc.pdb"
-  "libpawnc.a"
-  "libpawnc.so"
-)
-
-# Per-language clean rules from dependency scanning.
-FOREACH(lang C)
-  INCLUDE(CMakeFiles/pawnc.dir/cmake_clean_${lang}.cmake OPTIONAL)
-ENDFOREACH(lang)
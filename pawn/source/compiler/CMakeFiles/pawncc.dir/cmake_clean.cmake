@@ -1,10 +0,0 @@
-FILE(REMOVE_RECURSE
-  "CMakeFiles/pawncc.dir/pawncc.o"
-  "pawncc.pdb"
-  "pawncc"
-)
-
-# Per-language clean rules from dependency scanning.
-FOREACH(lang C)
-  INCLUDE(CMakeFiles/pawncc.dir/cmake_clean_${lang}.cmake OPTIONAL)
-ENDFOREACH(lang)
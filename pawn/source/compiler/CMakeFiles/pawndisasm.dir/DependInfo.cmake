@@ -1,22 +0,0 @@
-# The set of languages for which implicit dependencies are needed:
-SET(CMAKE_DEPENDS_LANGUAGES
-  "C"
-  )
-# The set of files for implicit dependencies of each language:
-SET(CMAKE_DEPENDS_CHECK_C
-  "/home/gareth/open_pdk/pawn/source/compiler/pawndisasm.c" "/home/gareth/open_pdk/pawn/source/compiler/CMakeFiles/pawndisasm.dir/pawndisasm.o"
-  )
-SET(CMAKE_C_COMPILER_ID "GNU")
-
-# Preprocessor definitions for this target.
-SET(CMAKE_TARGET_DEFINITIONS
-  "HAVE_UNISTD_H"
-  "HAVE_INTTYPES_H"
-  "HAVE_STDINT_H"
-  "HAVE_ALLOCA_H"
-  "ENABLE_BINRELOC"
-  )
-
-# Targets to which this target links.
-SET(CMAKE_TARGET_LINKED_INFO_FILES
-  )
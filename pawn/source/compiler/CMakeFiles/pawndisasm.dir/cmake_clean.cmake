@@ -1,10 +0,0 @@
-FILE(REMOVE_RECURSE
-  "CMakeFiles/pawndisasm.dir/pawndisasm.o"
-  "pawndisasm.pdb"
-  "pawndisasm"
-)
-
-# Per-language clean rules from dependency scanning.
-FOREACH(lang C)
-  INCLUDE(CMakeFiles/pawndisasm.dir/cmake_clean_${lang}.cmake OPTIONAL)
-ENDFOREACH(lang)
@@ -0,0 +1,703 @@
+/*  Pawn compile server
+ *
+ *  A "glue file" like libpawnc.c, for a compiler that stays resident and
+ *  takes jobs over a local (Unix domain) socket. The server reads the
+ *  include files once and keeps them in memory; every job runs
+ *  pc_compile() in a child forked from the server, so each compilation
+ *  starts from the pristine global state (including the static variables
+ *  that initglobals() does not reset) and a crash cannot take the server
+ *  down. A changed include file is read again before the next job.
+ *
+ *    pawnccd -s socket [-p dir]... [-t seconds]
+ *        serve; the files in each "dir" (and below) are kept in memory
+ *    pawnccd -c socket [pawncc options] source
+ *        compile through the server, or in this process if none is running
+ *
+ *  A job is the client's working directory followed by its pawncc
+ *  arguments, each terminated with a '\0', and an empty string to end the
+ *  list. The reply is the compiler output, then a '\0' and the exit code
+ *  in decimal, ending with '\n'.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ *  use this file except in compliance with the License. You may obtain a copy
+ *  of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+#include <assert.h>
+#include <dirent.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "sc.h"
+
+#define MAX_ARGS      100
+#define MAX_REQUEST   16384
+#define MAX_DIRDEPTH  8
+
+typedef struct tagCACHEDFILE {
+  struct tagCACHEDFILE *next;
+  char *name;           /* absolute path */
+  char *text;           /* NULL if the file has gone */
+  long size;
+  time_t mtime;
+  ino_t ino;
+} CACHEDFILE;
+
+typedef struct tagSRCFILE {
+  FILE *fp;             /* file on disk, or NULL for a cached file */
+  const char *text;
+  long size;
+  long pos;
+  int eof;              /* as feof(): set by a read that ran into the end */
+} SRCFILE;
+
+static CACHEDFILE *cachedfiles=NULL;
+static char jobcwd[_MAX_PATH];  /* relative names are looked up from here */
+static char *serverpath;        /* argv[0], for setconfig() */
+
+
+/* normalizepath()
+ * Makes "path" absolute (relative to "cwd") and removes "//", "/./" and
+ * "dir/../" lexically. Returns FALSE if it does not fit.
+ */
+static int normalizepath(char *target,int size,const char *cwd,const char *path)
+{
+  char temp[_MAX_PATH];
+  char *src,*dest;
+
+  if (*path=='/')
+    cwd="";
+  if (strlen(cwd)+strlen(path)+2>sizeof temp)
+    return FALSE;
+  sprintf(temp,"%s/%s",cwd,path);
+
+  dest=target;
+  for (src=temp; *src!='\0'; ) {
+    if (*src=='/') {
+      while (*src=='/')
+        src++;
+      if (*src=='.' && (src[1]=='/' || src[1]=='\0')) {
+        src++;
+        continue;
+      } /* if */
+      if (*src=='.' && src[1]=='.' && (src[2]=='/' || src[2]=='\0')) {
+        src+=2;
+        while (dest>target && *--dest!='/')
+          /* nothing */;
+        continue;
+      } /* if */
+      if (dest-target>=size-1)
+        return FALSE;
+      *dest++='/';
+    } else {
+      if (dest-target>=size-1)
+        return FALSE;
+      *dest++=*src++;
+    } /* if */
+  } /* for */
+  if (dest==target)
+    *dest++='/';
+  *dest='\0';
+  return TRUE;
+}
+
+/* loadfile()
+ * (Re-)reads a cached file if it is new or changed since it was read.
+ */
+static void loadfile(CACHEDFILE *file)
+{
+  struct stat st;
+  FILE *fp;
+  char *text;
+
+  if (stat(file->name,&st)!=0 || !S_ISREG(st.st_mode)) {
+    free(file->text);
+    file->text=NULL;
+    return;
+  } /* if */
+  if (file->text!=NULL && file->size==(long)st.st_size && file->mtime==st.st_mtime && file->ino==st.st_ino)
+    return;
+  free(file->text);
+  file->text=NULL;
+  if ((fp=fopen(file->name,"rb"))==NULL)
+    return;
+  if ((text=(char*)malloc(st.st_size+1))!=NULL && fread(text,1,st.st_size,fp)==(size_t)st.st_size) {
+    file->text=text;
+    file->size=(long)st.st_size;
+    file->mtime=st.st_mtime;
+    file->ino=st.st_ino;
+  } else {
+    free(text);
+  } /* if */
+  fclose(fp);
+}
+
+/* preloaddir()
+ * Adds the ".inc" files in a directory, and in the directories below it,
+ * to the cache.
+ */
+static void preloaddir(const char *path,int depth)
+{
+  DIR *dir;
+  struct dirent *entry;
+  struct stat st;
+  char name[_MAX_PATH];
+  int len;
+
+  if (depth>MAX_DIRDEPTH || (dir=opendir(path))==NULL)
+    return;
+  while ((entry=readdir(dir))!=NULL) {
+    if (entry->d_name[0]=='.')
+      continue;
+    len=snprintf(name,sizeof name,"%s/%s",path,entry->d_name);
+    if (len<0 || len>=(int)sizeof name || stat(name,&st)!=0)
+      continue;             /* path too long (or gone) */
+    if (S_ISDIR(st.st_mode)) {
+      preloaddir(name,depth+1);
+    } else if ((len=strlen(name))>4 && stricmp(name+len-4,".inc")==0) {
+      CACHEDFILE *file=(CACHEDFILE*)malloc(sizeof(CACHEDFILE));
+      if (file==NULL || (file->name=strdup(name))==NULL) {
+        free(file);
+        break;
+      } /* if */
+      file->text=NULL;
+      loadfile(file);
+      file->next=cachedfiles;
+      cachedfiles=file;
+    } /* if */
+  } /* while */
+  closedir(dir);
+}
+
+static CACHEDFILE *findfile(const char *name)
+{
+  CACHEDFILE *file;
+
+  for (file=cachedfiles; file!=NULL; file=file->next)
+    if (file->text!=NULL && strcmp(file->name,name)==0)
+      return file;
+  return NULL;
+}
+
+
+/* pc_printf()
+ * Called for general purpose "console" output. This function prints general
+ * purpose messages; errors go through pc_error(). The function is modelled
+ * after printf().
+ */
+int pc_printf(const char *message,...)
+{
+  int ret;
+  va_list argptr;
+
+  va_start(argptr,message);
+  ret=vprintf(message,argptr);
+  va_end(argptr);
+
+  return ret;
+}
+
+/* pc_error()
+ * Called for producing error output (see libpawnc.c).
+ */
+int pc_error(int number,char *message,char *filename,int firstline,int lastline,va_list argptr)
+{
+static char *prefix[3]={ "error", "fatal error", "warning" };
+
+  if (number!=0) {
+    char *pre;
+
+    pre=prefix[number/100];
+    if (firstline>=0)
+      fprintf(stderr,"%s(%d -- %d) : %s %03d: ",filename,firstline,lastline,pre,number);
+    else
+      fprintf(stderr,"%s(%d) : %s %03d: ",filename,lastline,pre,number);
+  } /* if */
+  vfprintf(stderr,message,argptr);
+  fflush(stderr);
+  return 0;
+}
+
+/* pc_opensrc()
+ * Opens a source file (or include file) for reading: from the cache if the
+ * server holds it, else from disk.
+ */
+void *pc_opensrc(char *filename)
+{
+  SRCFILE *src;
+  CACHEDFILE *file=NULL;
+  char name[_MAX_PATH];
+  FILE *fp=NULL;
+
+  if (normalizepath(name,sizeof name,jobcwd,filename))
+    file=findfile(name);
+  if (file==NULL && (fp=fopen(filename,"rt"))==NULL)
+    return NULL;
+  if ((src=(SRCFILE*)malloc(sizeof(SRCFILE)))==NULL) {
+    if (fp!=NULL)
+      fclose(fp);
+    return NULL;
+  } /* if */
+  src->fp=fp;
+  src->text=(file!=NULL) ? file->text : NULL;
+  src->size=(file!=NULL) ? file->size : 0;
+  src->pos=0;
+  src->eof=FALSE;
+  return src;
+}
+
+/* pc_createsrc()
+ * Creates/overwrites a source file for writing (always on disk).
+ */
+void *pc_createsrc(char *filename)
+{
+  SRCFILE *src;
+  FILE *fp;
+
+  if ((fp=fopen(filename,"wt"))==NULL)
+    return NULL;
+  if ((src=(SRCFILE*)malloc(sizeof(SRCFILE)))==NULL) {
+    fclose(fp);
+    return NULL;
+  } /* if */
+  memset(src,0,sizeof(SRCFILE));
+  src->fp=fp;
+  return src;
+}
+
+void pc_closesrc(void *handle)
+{
+  SRCFILE *src=(SRCFILE*)handle;
+
+  assert(src!=NULL);
+  if (src->fp!=NULL)
+    fclose(src->fp);
+  free(src);
+}
+
+/* pc_readsrc()
+ * Reads a single line (or up to maxchars-1 characters), as fgets() does.
+ */
+char *pc_readsrc(void *handle,unsigned char *target,int maxchars)
+{
+  SRCFILE *src=(SRCFILE*)handle;
+  int len;
+
+  if (src->fp!=NULL)
+    return fgets((char*)target,maxchars,src->fp);
+  for (len=0; len<maxchars-1 && src->pos<src->size; ) {
+    target[len++]=src->text[src->pos++];
+    if (target[len-1]=='\n')
+      break;
+  } /* for */
+  if (len<maxchars-1 && (len==0 || target[len-1]!='\n'))
+    src->eof=TRUE;
+  if (len==0)
+    return NULL;
+  target[len]='\0';
+  return (char*)target;
+}
+
+int pc_writesrc(void *handle,const unsigned char *source)
+{
+  SRCFILE *src=(SRCFILE*)handle;
+
+  assert(src->fp!=NULL);
+  return fputs((char*)source,src->fp) >= 0;
+}
+
+#define MAXPOSITIONS  4
+typedef struct tagSRCPOS {
+  fpos_t fpos;
+  long pos;
+} SRCPOS;
+static SRCPOS srcpositions[MAXPOSITIONS];
+static unsigned char srcposalloc[MAXPOSITIONS];
+
+void pc_clearpossrc(void)
+{
+  memset(srcpositions,0,sizeof srcpositions);
+  memset(srcposalloc,0,sizeof srcposalloc);
+}
+
+void *pc_getpossrc(void *handle,void *position)
+{
+  SRCFILE *src=(SRCFILE*)handle;
+
+  if (position==NULL) {
+    /* allocate a new slot */
+    int i;
+    for (i=0; i<MAXPOSITIONS && srcposalloc[i]!=0; i++)
+      /* nothing */;
+    assert(i<MAXPOSITIONS); /* if not, there is a queue overrun */
+    if (i>=MAXPOSITIONS)
+      return NULL;
+    position=&srcpositions[i];
+    srcposalloc[i]=1;
+  } /* if */
+  if (src->fp!=NULL)
+    fgetpos(src->fp,&((SRCPOS*)position)->fpos);
+  else
+    ((SRCPOS*)position)->pos=src->pos;
+  return position;
+}
+
+void pc_resetsrc(void *handle,void *position)
+{
+  SRCFILE *src=(SRCFILE*)handle;
+
+  assert(handle!=NULL);
+  assert(position!=NULL);
+  if (src->fp!=NULL)
+    fsetpos(src->fp,&((SRCPOS*)position)->fpos);
+  else
+    src->pos=((SRCPOS*)position)->pos;
+  src->eof=FALSE;
+}
+
+int pc_eofsrc(void *handle)
+{
+  SRCFILE *src=(SRCFILE*)handle;
+
+  return (src->fp!=NULL) ? feof(src->fp) : src->eof;
+}
+
+/* should return a pointer, which is used as a "magic cookie" to all I/O
+ * functions; return NULL for failure
+ */
+void *pc_openasm(char *filename)
+{
+  return mfcreate(filename);
+}
+
+void pc_closeasm(void *handle, int deletefile)
+{
+  if (handle!=NULL) {
+    if (!deletefile)
+      mfdump((MEMFILE*)handle);
+    mfclose((MEMFILE*)handle);
+  } /* if */
+}
+
+void pc_resetasm(void *handle)
+{
+  assert(handle!=NULL);
+  mfseek((MEMFILE*)handle,0,SEEK_SET);
+}
+
+int pc_writeasm(void *handle,const char *string)
+{
+  return mfputs((MEMFILE*)handle,string);
+}
+
+char *pc_readasm(void *handle, char *string, int maxchars)
+{
+  return mfgets((MEMFILE*)handle,string,maxchars);
+}
+
+void *pc_openbin(char *filename)
+{
+  return fopen(filename,"wb");
+}
+
+void pc_closebin(void *handle,int deletefile)
+{
+  fclose((FILE*)handle);
+  if (deletefile)
+    remove(binfname);
+}
+
+void pc_resetbin(void *handle,long offset)
+{
+  fflush((FILE*)handle);
+  fseek((FILE*)handle,offset,SEEK_SET);
+}
+
+int pc_writebin(void *handle,const void *buffer,int size)
+{
+  return (int)fwrite(buffer,1,size,(FILE*)handle) == size;
+}
+
+long pc_lengthbin(void *handle)
+{
+  return ftell((FILE*)handle);
+}
+
+
+static int writeall(int fd,const char *buffer,int size)
+{
+  while (size>0) {
+    int len=(int)write(fd,buffer,size);
+    if (len<0 && errno==EINTR)
+      continue;
+    if (len<=0)
+      return FALSE;
+    buffer+=len;
+    size-=len;
+  } /* while */
+  return TRUE;
+}
+
+static int opensocket(const char *socketname,struct sockaddr_un *addr)
+{
+  if (strlen(socketname)>=sizeof addr->sun_path) {
+    fprintf(stderr,"pawnccd: socket name too long: %s\n",socketname);
+    return -1;
+  } /* if */
+  memset(addr,0,sizeof(struct sockaddr_un));
+  addr->sun_family=AF_UNIX;
+  strcpy(addr->sun_path,socketname);
+  return socket(AF_UNIX,SOCK_STREAM,0);
+}
+
+/* runjob()
+ * Runs in a child of the server: reads the job, compiles it with the
+ * compiler output going to the client, and sends the exit code.
+ */
+static void runjob(int fd)
+{
+  static char request[MAX_REQUEST];
+  char *argv[MAX_ARGS+1];
+  int argc,len,size,retcode;
+  char *ptr,*end;
+  char trailer[16];
+
+  /* read up to the empty string that ends the list */
+  for (size=0; size<2 || request[size-1]!='\0' || request[size-2]!='\0'; size+=len) {
+    if (size==sizeof request) {
+      static const char reply[]="pawnccd: job too long\n\0" "2\n";
+      writeall(fd,reply,sizeof reply-1);
+      return;
+    } /* if */
+    len=(int)read(fd,request+size,sizeof request-size);
+    if (len<0 && errno==EINTR)
+      len=0;
+    else if (len<=0)
+      return;           /* client went away */
+  } /* for */
+
+  argc=0;
+  argv[argc++]=serverpath;
+  end=request+size-1;
+  ptr=request+strlen(request)+1;  /* arguments follow the working directory */
+  while (ptr<end && argc<MAX_ARGS) {
+    argv[argc++]=ptr;
+    ptr+=strlen(ptr)+1;
+  } /* while */
+  argv[argc]=NULL;
+
+  dup2(fd,STDOUT_FILENO);
+  dup2(fd,STDERR_FILENO);
+  setvbuf(stdout,NULL,_IOLBF,0);
+  if (chdir(request)!=0 || getcwd(jobcwd,sizeof jobcwd)==NULL) {
+    printf("pawnccd: cannot change to directory %s\n",request);
+    retcode=2;
+  } else {
+    retcode=pc_compile(argc,argv);
+  } /* if */
+  fflush(stdout);
+  fflush(stderr);
+  len=sprintf(trailer,"%c%d\n",'\0',retcode);
+  writeall(fd,trailer,len);
+}
+
+static volatile sig_atomic_t serverstop=FALSE;
+
+static void stopserver(int sig)
+{
+  (void)sig;
+  serverstop=TRUE;
+}
+
+static int server(const char *socketname,int timeout)
+{
+  struct sockaddr_un addr;
+  struct sigaction action;
+  CACHEDFILE *file;
+  int fd,count;
+
+  if ((fd=opensocket(socketname,&addr))<0)
+    return 1;
+  unlink(socketname);
+  if (bind(fd,(struct sockaddr*)&addr,sizeof addr)!=0 || listen(fd,64)!=0) {
+    fprintf(stderr,"pawnccd: cannot listen on %s: %s\n",socketname,strerror(errno));
+    close(fd);
+    return 1;
+  } /* if */
+  for (count=0,file=cachedfiles; file!=NULL; file=file->next)
+    if (file->text!=NULL)
+      count++;
+  printf("pawnccd: serving on %s, %d include files in memory\n",socketname,count);
+  fflush(stdout);
+
+  memset(&action,0,sizeof action);
+  action.sa_handler=stopserver;     /* no SA_RESTART, so select() returns */
+  sigaction(SIGTERM,&action,NULL);
+  sigaction(SIGINT,&action,NULL);
+  signal(SIGCHLD,SIG_IGN);          /* jobs are reaped automatically */
+  signal(SIGPIPE,SIG_IGN);
+
+  while (!serverstop) {
+    struct timeval tv;
+    fd_set readset;
+    int conn,ready;
+    pid_t pid;
+
+    FD_ZERO(&readset);
+    FD_SET(fd,&readset);
+    tv.tv_sec=timeout;
+    tv.tv_usec=0;
+    ready=select(fd+1,&readset,NULL,NULL,(timeout>0) ? &tv : NULL);
+    if (ready==0)
+      break;            /* idle for too long */
+    if (ready<0 || (conn=accept(fd,NULL,NULL))<0)
+      continue;
+    /* bring the cache up to date, then hand the job to a fresh compiler */
+    for (file=cachedfiles; file!=NULL; file=file->next)
+      loadfile(file);
+    fflush(stdout);
+    pid=fork();
+    if (pid==0) {
+      close(fd);
+      signal(SIGCHLD,SIG_DFL);
+      signal(SIGPIPE,SIG_DFL);
+      runjob(conn);
+      _exit(0);
+    } /* if */
+    if (pid<0) {
+      static const char reply[]="pawnccd: cannot start job\n\0" "2\n";
+      writeall(conn,reply,sizeof reply-1);
+    } /* if */
+    close(conn);
+  } /* while */
+  close(fd);
+  unlink(socketname);
+  return 0;
+}
+
+/* client()
+ * Sends a compile job to the server and copies back its output. Compiles
+ * in this process if there is no server.
+ */
+static int client(const char *socketname,int argc,char *argv[])
+{
+  struct sockaddr_un addr;
+  char buffer[4096];
+  char cwd[_MAX_PATH];
+  int fd,i,len,retcode,trailer;
+
+  fd=opensocket(socketname,&addr);
+  if (fd<0 || connect(fd,(struct sockaddr*)&addr,sizeof addr)!=0 || getcwd(cwd,sizeof cwd)==NULL) {
+    if (fd>=0)
+      close(fd);
+    if (getcwd(jobcwd,sizeof jobcwd)==NULL)
+      jobcwd[0]='\0';
+    return pc_compile(argc,argv);
+  } /* if */
+
+  signal(SIGPIPE,SIG_IGN);
+  len=1;
+  if (!writeall(fd,cwd,strlen(cwd)+1))
+    len=0;
+  for (i=1; i<argc && len>0; i++)
+    if (!writeall(fd,argv[i],strlen(argv[i])+1))
+      len=0;
+  if (len==0 || !writeall(fd,"",1)) {
+    fprintf(stderr,"pawnccd: cannot send job to %s\n",socketname);
+    close(fd);
+    return 2;
+  } /* if */
+
+  /* output up to the '\0', then the exit code */
+  retcode=-1;
+  trailer=-1;
+  while ((len=(int)read(fd,buffer,sizeof buffer-1))!=0) {
+    if (len<0) {
+      if (errno==EINTR)
+        continue;
+      break;
+    } /* if */
+    for (i=0; trailer<0 && i<len && buffer[i]!='\0'; i++)
+      /* nothing */;
+    if (trailer<0) {
+      fwrite(buffer,1,i,stdout);
+      if (i<len) {
+        trailer=0;
+        memmove(buffer,buffer+i+1,len-i-1);
+        len-=i+1;
+      } else {
+        len=0;
+      } /* if */
+    } /* if */
+    if (trailer>=0 && trailer+len<(int)sizeof cwd-1) {
+      memcpy(cwd+trailer,buffer,len);
+      trailer+=len;
+    } /* if */
+  } /* while */
+  close(fd);
+  fflush(stdout);
+  if (trailer>0) {
+    cwd[trailer]='\0';
+    retcode=atoi(cwd);
+  } /* if */
+  if (retcode<0) {
+    fprintf(stderr,"pawnccd: job was lost (compiler crashed?)\n");
+    retcode=2;
+  } /* if */
+  return retcode;
+}
+
+static void usage(void)
+{
+  printf("Usage: pawnccd -s socket [-p dir]... [-t seconds]\n"
+         "           serve compile jobs, with the include files in each \"dir\" in memory,\n"
+         "           exiting when idle for \"seconds\"\n"
+         "       pawnccd -c socket [pawncc options] source\n"
+         "           compile through the server (in this process if none is running)\n");
+}
+
+int main(int argc,char *argv[])
+{
+  char path[_MAX_PATH];
+  int i,timeout;
+
+  serverpath=argv[0];
+  if (argc>=3 && strcmp(argv[1],"-c")==0) {
+    char *socketname=argv[2];
+    argv[2]=argv[0];    /* pawncc arguments follow, argv[0] is for setconfig() */
+    return client(socketname,argc-2,argv+2);
+  } /* if */
+  if (argc<3 || strcmp(argv[1],"-s")!=0) {
+    usage();
+    return 1;
+  } /* if */
+  timeout=0;
+  for (i=3; i<argc; i++) {
+    if (strcmp(argv[i],"-p")==0 && i+1<argc) {
+      if (realpath(argv[++i],path)!=NULL)
+        preloaddir(path,0);
+      else
+        fprintf(stderr,"pawnccd: cannot read %s\n",argv[i]);
+    } else if (strcmp(argv[i],"-t")==0 && i+1<argc) {
+      timeout=atoi(argv[++i]);
+    } else {
+      usage();
+      return 1;
+    } /* if */
+  } /* for */
+  return server(argv[2],timeout);
+}
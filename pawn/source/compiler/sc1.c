@@ -772,7 +772,7 @@ cleanup:
     assert(inpfname!=NULL && (int)inpfname!=-1);
     free(inpfname);
     assert(inpf!=NULL && (int)inpf!=-1);
-    fclose(inpf);
+    pc_closesrc(inpf);
   } /* if */
   lexinit(TRUE);                          /* reset and release buffers */
   phopt_cleanup();
@@ -1,9 +1,647 @@
 """ Give it a UPF and it'll build stuff
     No, seriously - it will!
+
+    Builds are incremental: every input (scripts and the files they
+    include, sounds, motions and the tools themselves) is content
+    hashed into a manifest in the build directory, and only outputs whose
+    inputs or command line changed are rebuilt.  Outputs are staged the way
+    urf_tool extracts an archive, and the URF is relinked from there in
+    UPF order, which sets the resource IDs.  The ID includes scripts use
+    (sounds.inc, motions.inc) are generated from that same order.
+
+    Stale targets build in parallel (-j), as a DAG of jobs ending in the
+    one link step, longest path first.
 """
 
 import config
 import parse_upf
 import sys
+import os
+import time
+import pipes
+import pickle
+import shlex
+import shutil
+import signal
+import socket
+import heapq
+import hashlib
+import threading
+import subprocess
+from optparse import OptionParser
+
+MANIFEST_FILE    = '.pleo_build'
+MANIFEST_VERSION = 1
+
+# csv2umf's cache of compiled motions, in the build directory
+UMF_CACHE_DIR = '.umf_cache'
+
+# Staged files for urf_tool c, in UPF order, in the build directory
+LINK_LIST_FILE = '.pleo_link'
+
+# Resource ID includes for scripts, in the build directory's include
+# directory: file, enum & prefix (as pleo_resource_type::write_index_file)
+INDEX_DIR = 'include'
+INDEX_INCLUDES = {'sound'  : ('sounds.inc','sound_name','snd',0x1000),
+                  'motion' : ('motions.inc','motion_name','mot',0x2000)}
+
+# Staging directory & extension per resource kind (as urf_tool 'c' packs them)
+STAGING = {'script' : ('scripts','AMX'),
+           'sound'  : ('sounds','UGSF'),
+           'motion' : ('motions','UGMF')}
+
+def hash_file(path):
+    """ SHA-1 of a file's contents
+    """
+    digest = hashlib.sha1()
+    f = open(path,'rb')
+    while True:
+       block = f.read(65536)
+       if not block: break
+       digest.update(block)
+    f.close()
+    return digest.hexdigest()
+
+class file_hashes:
+    """ Content hashes of files, cached against size & mtime so that
+        unchanged files aren't read again
+    """
+    def __init__(self,cache):
+        self.cache = cache # path -> [size,mtime,hash]
+        self.seen  = {}
+
+    def get(self,path):
+        """ Hash of a file, None if it doesn't exist
+        """
+        if path in self.seen: return self.seen[path]
+        try:
+           st = os.stat(path)
+        except OSError:
+           self.seen[path] = None
+           return None
+        entry = self.cache.get(path)
+        if entry is None or entry[0]!=st.st_size or entry[1]!=st.st_mtime:
+           entry = [st.st_size,st.st_mtime,hash_file(path)]
+           self.cache[path] = entry
+        self.seen[path] = entry[2]
+        return entry[2]
+
+    def changed(self,path):
+        """ Forget a file's hash once it has been written
+        """
+        self.seen.pop(path,None)
+
+    def used(self):
+        """ Cache entries for files looked at this build
+        """
+        return dict([(path,self.cache[path]) for path in self.seen if path in self.cache])
+
+def load_manifest(build_dir):
+    """ Load the build manifest (empty if missing or from another version)
+    """
+    manifest = {'version':MANIFEST_VERSION, 'files':{}, 'targets':{}, 'link':None}
+    try:
+       f = open(os.path.join(build_dir,MANIFEST_FILE),'rb')
+       loaded = pickle.load(f)
+       f.close()
+       if isinstance(loaded,dict) and loaded.get('version')==MANIFEST_VERSION: manifest = loaded
+    except (IOError,EOFError,ValueError,KeyError,IndexError,pickle.UnpicklingError):
+       pass
+    return manifest
+
+def save_manifest(build_dir,manifest):
+    """ Write the build manifest (replaced atomically)
+    """
+    filename = os.path.join(build_dir,MANIFEST_FILE)
+    f = open(filename+'.tmp','wb')
+    pickle.dump(manifest,f,pickle.HIGHEST_PROTOCOL)
+    f.close()
+    os.rename(filename+'.tmp',filename)
+
+def tool_path(cmd_line):
+    """ The program a command line format runs
+    """
+    return os.path.normpath(cmd_line.split()[0])
+
+def run(cmd,quiet=False):
+    """ Run a shell command, True if it succeeded
+    """
+    out = None
+    if quiet: out = open(os.devnull,'w')
+    result = subprocess.call(cmd,shell=True,stdout=out)
+    if out: out.close()
+    return result==0
+
+class pawn_server:
+    """ A pawnccd compile server for the length of a build.  Scripts are
+        compiled by sending it pawn_cmd_line's arguments on a socket, which
+        saves starting a pawncc process (and reading the includes) per compile
+    """
+    def __init__(self,build_dir):
+        self.socket_file = os.path.abspath(os.path.join(build_dir,'.pawnccd'))
+        self.process     = None
+        if not os.path.exists(tool_path(config.pawn_server_cmd_line)): return
+        if os.path.exists(self.socket_file): os.remove(self.socket_file)
+        args = shlex.split(config.pawn_server_cmd_line % (pipes.quote(self.socket_file),pipes.quote(config.include_path)))
+        null = open(os.devnull,'w')
+        try:
+           self.process = subprocess.Popen(args,stdout=null)
+        except OSError:
+           self.process = None
+        null.close()
+        for i in xrange(100):
+            if self.process is None or os.path.exists(self.socket_file): break
+            if self.process.poll() is not None: self.process = None
+            else: time.sleep(0.01)
+        if self.process and not os.path.exists(self.socket_file): self.stop()
+
+    def compile(self,cmd):
+        """ Compile with a pawn_cmd_line command on the server
+            Returns (ok,output), ok None if the server didn't run the job
+        """
+        if self.process is None: return (None,'')
+        request = os.getcwd()+'\0'+''.join([arg+'\0' for arg in shlex.split(cmd)[1:]])+'\0'
+        try:
+           s = socket.socket(socket.AF_UNIX,socket.SOCK_STREAM)
+           s.connect(self.socket_file)
+           s.sendall(request)
+           reply = []
+           while True:
+               block = s.recv(65536)
+               if not block: break
+               reply.append(block)
+           s.close()
+        except socket.error:
+           return (None,'')
+        output,sep,status = ''.join(reply).partition('\0')
+        if not sep: return (None,'')
+        return (status.strip()=='0',output)
+
+    def stop(self):
+        if self.process is None: return
+        os.kill(self.process.pid,signal.SIGTERM)
+        self.process.wait()
+        self.process = None
+        if os.path.exists(self.socket_file): os.remove(self.socket_file)
+
+server = None # pawn_server while a build is compiling scripts
+
+def run_pawn(cmd,quiet=False):
+    """ Run a pawn_cmd_line command, on the compile server if there is one,
+        True if it succeeded
+    """
+    if server:
+       ok,output = server.compile(cmd)
+       if ok is not None:
+          if output and not quiet: log(output.rstrip())
+          return ok
+    return run(cmd,quiet)
+
+def find_targets(upf_file,build_dir):
+    """ One target per <script>, <sound> and <motion> in the UPF
+        Returns (project name,targets)
+    """
+    parsed_upf = parse_upf.parse_upf_file(upf_file)
+    upf_dir    = os.path.dirname(upf_file)
+    targets    = []
+    names      = {}
+    for kind,resources in (('script','scripts'),('sound','sounds'),('motion','motions')):
+        for path in parsed_upf['resources'][resources]:
+            source   = os.path.normpath(os.path.join(upf_dir,path))
+            name,ext = os.path.splitext(os.path.basename(source))
+            ext      = ext.lower()
+            dirname,staging_ext = STAGING[kind]
+            target = {'kind':kind, 'name':name, 'source':source, 'tool':None,
+                      'output':os.path.join(build_dir,dirname,'%s.%s' % (name,staging_ext))}
+            if kind=='script':
+               target['action']  = 'pawn'
+               target['command'] = config.pawn_cmd_line % ('%s',config.include_path,os.path.join(build_dir,INDEX_DIR),'%s')
+               target['tool']    = tool_path(config.pawn_cmd_line)
+            elif kind=='sound' and ext=='.wav':
+               target['action']  = 'usf'
+               target['command'] = config.usf_batch_cmd_line
+               target['tool']    = tool_path(config.usf_batch_cmd_line)
+            elif kind=='motion' and ext=='.csv' and config.build_umf_motions:
+               target['action']  = 'umf'
+               target['command'] = config.csv2umf_cmd_line
+               target['tool']    = tool_path(config.csv2umf_cmd_line)
+            elif (kind=='sound' and ext=='.usf') or (kind=='motion' and ext in ('.umf','.ugmf')):
+               target['action']  = 'copy'
+               target['command'] = 'copy'
+            elif kind=='motion' and ext=='.csv':
+               target['action']  = None
+               target['warning'] = ' (set build_umf_motions in config.py to compile motion CSVs)'
+            else:
+               target['action']  = None
+            if (kind,name) in names:
+               raise Exception('%s: %s name %s already used by %s' % (source,kind,name,names[(kind,name)]))
+            names[(kind,name)] = source
+            targets.append(target)
+    return (parsed_upf['proj_name'],targets)
+
+def is_stale(target,record,hashes):
+    """ Does a target need building? (no record, new command line, or an
+        input or the output changed since it was recorded)
+    """
+    if record is None or record['command']!=target['command']: return True
+    if hashes.get(target['output'])!=record['output']: return True
+    for path,digest in record['inputs'].items():
+        if hashes.get(path)!=digest: return True
+    return False
+
+def pawn_include_dirs(index_dir):
+    """ Directories pawncc searches for includes, in its order: the include
+        directory beside (or above) the compiler, then each -i
+    """
+    bin_dir = os.path.dirname(tool_path(config.pawn_cmd_line))
+    default = os.path.join(bin_dir,'include')
+    if not os.path.isdir(default): default = os.path.join(os.path.dirname(bin_dir),'include')
+    return [default,config.include_path,index_dir]
+
+def find_pawn_file(name):
+    """ A file pawncc would open for name (as is, or with .inc, .p or .pawn
+        appended), None if there isn't one
+    """
+    for ext in ('','.inc','.p','.pawn'):
+        if os.path.isfile(name+ext): return os.path.normpath(name+ext)
+    return None
+
+def find_includes(source,index_dir):
+    """ Files a script includes, found the way pawncc looks for them:
+        "name" (or bare) beside the including file first, <name> only in
+        the include directories, and default.inc first of all.  #if is
+        ignored, so this may list more files than a compile reads - never
+        fewer
+    """
+    include_dirs = pawn_include_dirs(index_dir)
+    found   = []
+    pending = []
+    for path in include_dirs:
+        prefix = find_pawn_file(os.path.join(path,'default.inc'))
+        if prefix:
+           pending.append(prefix)
+           break
+    pending.append(source)
+    while pending:
+        filename = pending.pop()
+        if filename in found: continue
+        found.append(filename)
+        try:
+           f = open(filename,'r')
+           lines = f.readlines()
+           f.close()
+        except IOError:
+           continue
+        for line in lines:
+            line = line.strip()
+            if not line.startswith('#'): continue
+            directive = line[1:].lstrip()
+            for keyword in ('include','tryinclude'):
+                if directive.startswith(keyword) and directive[len(keyword):len(keyword)+1] in (' ','\t','<','"'): break
+            else:
+                continue
+            name = directive[len(keyword):].strip()
+            if name.startswith('<'): name,local = name[1:].split('>')[0].strip(),False
+            elif name.startswith('"'): name,local = name[1:].split('"')[0].strip(),True
+            else: local = True
+            candidates = []
+            if local: candidates.append(os.path.join(os.path.dirname(filename),name))
+            if not os.path.isabs(name): candidates += [os.path.join(path,name) for path in include_dirs]
+            for candidate in candidates:
+                included = find_pawn_file(candidate)
+                if included:
+                   pending.append(included)
+                   break
+    return found
+
+def build_script(target):
+    """ Compile a script.  Its includes are found by scanning the sources
+        rather than a second pawncc run
+        Returns (ok,inputs)
+    """
+    log('Compiling %s' % target['source'])
+    index_dir = os.path.join(os.path.dirname(os.path.dirname(target['output'])),INDEX_DIR)
+    args = tuple([pipes.quote(arg) for arg in (target['source'],config.include_path,index_dir,target['output'])])
+    if not run_pawn(config.pawn_cmd_line % args): return (False,None)
+    return (True,find_includes(target['source'],index_dir)+[target['tool']])
+
+def build_sound(target):
+    """ Convert a sound with usf_batch & stage it
+        Returns (ok,inputs)
+    """
+    log('Converting %s' % target['source'])
+    sound_dir  = os.path.dirname(target['output'])
+    sound_list = os.path.join(sound_dir,target['name']+'.lst')
+    usf_file   = os.path.join(sound_dir,target['name']+'.usf')
+    f = open(sound_list,'w')
+    f.write('%s\t%s\n' % (os.path.abspath(target['source']),target['name'])) # relative to the list
+    f.close()
+    if os.path.exists(usf_file): os.remove(usf_file)
+    run(config.usf_batch_cmd_line % (pipes.quote(sound_dir),pipes.quote(sound_list)),True)
+    os.remove(sound_list)
+    if not os.path.exists(usf_file): return (False,None)
+    os.rename(usf_file,target['output'])
+    return (True,[target['source'],target['tool']])
+
+def build_motion(target):
+    """ Compile a motion CSV with csv2umf & stage it.  csv2umf keeps what it
+        compiles in the build directory's .umf_cache, so a forced rebuild
+        doesn't compile unchanged motions again.  The cache entry used is
+        an input, so prune_umf_cache keeps it
+        Returns (ok,inputs)
+    """
+    log('Compiling %s' % target['source'])
+    cache_dir = os.path.join(os.path.dirname(os.path.dirname(target['output'])),UMF_CACHE_DIR)
+    args = tuple([pipes.quote(arg) for arg in (cache_dir,target['output'],target['source'],target['name'])])
+    process = subprocess.Popen(config.csv2umf_cmd_line % args,shell=True,stdout=subprocess.PIPE)
+    output = process.communicate()[0]
+    if process.returncode!=0: return (False,None)
+    inputs = [target['source'],target['tool']]
+    for line in output.splitlines():
+        if line.startswith('Cache entry '):
+           inputs.append(os.path.normpath(line[len('Cache entry '):]))
+    return (True,inputs)
+
+def build_copy(target):
+    """ Stage a resource that needs no conversion
+        Returns (ok,inputs)
+    """
+    shutil.copyfile(target['source'],target['output'])
+    return (True,[target['source']])
+
+BUILDERS = {'pawn':build_script, 'usf':build_sound, 'umf':build_motion, 'copy':build_copy}
+
+# Cost estimates (seconds) for targets never timed: per build, plus per source byte
+ESTIMATES = {'pawn':(0.5,0), 'usf':(0.01,1e-7), 'umf':(0.005,2e-8), 'copy':(0.001,1e-9), 'link':(0.1,0)}
+
+def estimate_cost(target,record):
+    """ Expected time to build a target: as long as it took last time, else a guess
+    """
+    if record and 'time' in record: return record['time']
+    fixed,per_byte = ESTIMATES[target['action']]
+    try:
+       return fixed+per_byte*os.path.getsize(target['source'])
+    except (OSError,KeyError):
+       return fixed
+
+log_lock = threading.Lock()
+
+def cpu_count():
+    """ Number of CPUs, 1 if it can't be found
+    """
+    try:
+       return max(int(os.sysconf('SC_NPROCESSORS_ONLN')),1)
+    except (AttributeError,ValueError,OSError):
+       return 1
+
+def log(message):
+    """ Print a line (whole, whichever job thread it comes from)
+    """
+    log_lock.acquire()
+    print message
+    sys.stdout.flush()
+    log_lock.release()
+
+class job_type:
+    """ A build step: func(arg) returns (ok,result), run once every job in
+        deps has succeeded
+    """
+    def __init__(self,func,arg,cost,deps=[]):
+        self.func       = func
+        self.arg        = arg
+        self.cost       = cost
+        self.deps       = deps
+        self.dependents = []
+        self.pending    = len(deps)
+        self.priority   = cost
+        self.ok         = False
+        self.result     = None
+        self.time       = 0.0
+        for dep in deps: dep.dependents.append(self)
+
+def run_jobs(jobs,thread_count):
+    """ Run a DAG of jobs (listed with dependencies first) on up to
+        thread_count threads.  Ready jobs are started longest remaining path
+        first, so the critical path starts as early as it can.  Jobs that
+        depend on a failed job are skipped
+    """
+    for job in reversed(jobs):
+        job.priority = job.cost+max([0]+[dependent.priority for dependent in job.dependents])
+    ready = [(-job.priority,index,job) for index,job in enumerate(jobs) if job.pending==0]
+    heapq.heapify(ready)
+    order = dict([(id(job),index) for index,job in enumerate(jobs)])
+    state = {'remaining':len(jobs)}
+    lock  = threading.Condition()
+
+    def worker():
+        lock.acquire()
+        while True:
+            while not ready and state['remaining']>0: lock.wait()
+            if state['remaining']==0: break
+            job = heapq.heappop(ready)[2]
+            lock.release()
+            if [dep for dep in job.deps if not dep.ok]==[]:
+               start_time = time.time()
+               try:
+                  job.ok,job.result = job.func(job.arg)
+               except Exception,e:
+                  log('Error: %s' % e)
+                  job.ok = False
+               job.time = time.time()-start_time
+            lock.acquire()
+            state['remaining'] -= 1
+            for dependent in job.dependents:
+                dependent.pending -= 1
+                if dependent.pending==0: heapq.heappush(ready,(-dependent.priority,order[id(dependent)],dependent))
+            lock.notifyAll()
+        lock.release()
+
+    threads = [threading.Thread(target=worker) for i in xrange(min(thread_count,len(jobs)))]
+    for thread in threads: thread.start()
+    for thread in threads: thread.join()
+
+def remove_stale_outputs(build_dir,targets):
+    """ Remove staged outputs of resources no longer in the project, so the
+        URF doesn't pick them up
+    """
+    outputs = set([target['output'] for target in targets])
+    for dirname,ext in STAGING.values():
+        path = os.path.join(build_dir,dirname)
+        for filename in os.listdir(path):
+            filename = os.path.join(path,filename)
+            if filename.lower().endswith('.'+ext.lower()) and filename not in outputs: os.remove(filename)
+
+def write_if_changed(filename,text):
+    """ Write a generated file, leaving it alone if it already holds text
+        (so what depends on it isn't rebuilt)
+    """
+    try:
+       f = open(filename,'r')
+       old = f.read()
+       f.close()
+    except IOError:
+       old = None
+    if old==text: return
+    f = open(filename,'w')
+    f.write(text)
+    f.close()
+
+def packed_targets(targets):
+    """ Targets that go into the URF, in UPF order - resource IDs follow it,
+        per type
+    """
+    return [target for target in targets if target['action'] is not None]
+
+def write_index_includes(index_dir,targets):
+    """ Resource ID enums for scripts to include (sounds.inc, motions.inc),
+        laid out as pleo_resource_type::write_index_file writes them
+    """
+    if not os.path.isdir(index_dir): os.makedirs(index_dir)
+    packed = packed_targets(targets)
+    for kind,(filename,enum_name,prefix,base) in INDEX_INCLUDES.items():
+        names  = [target['name'] for target in packed if target['kind']==kind]
+        line   = '  %s_%%-%ds = %%d,\n' % (prefix,max([0]+[len(name) for name in names]))
+        text   = '/* WARNING:  File auto-generated by pleo_build.py.  DO NOT EDIT. */\n\n'
+        text  += 'enum %s {\n' % enum_name
+        text  += line % ('none',base-1)
+        text  += line % ('min',base)
+        for i in xrange(len(names)):
+            text += line % (names[i],base+i)
+        text  += '  %s_max\n};\n' % prefix
+        write_if_changed(os.path.join(index_dir,filename),text)
+
+def write_link_list(build_dir,targets):
+    """ List the staged outputs for urf_tool c, in UPF order
+        Returns the list file name
+    """
+    list_file = os.path.join(build_dir,LINK_LIST_FILE)
+    lines = []
+    for target in packed_targets(targets):
+        dirname,ext = STAGING[target['kind']]
+        lines.append('%s/%s\n' % (dirname,os.path.basename(target['output'])))
+    write_if_changed(list_file,''.join(lines))
+    return list_file
+
+def prune_umf_cache(build_dir,records):
+    """ Remove csv2umf cache entries no built motion uses (sources since
+        changed or dropped from the project)
+    """
+    cache_dir = os.path.join(build_dir,UMF_CACHE_DIR)
+    if not os.path.isdir(cache_dir): return
+    used = set()
+    for record in records.values():
+        used.update(record['inputs'].keys())
+    for filename in os.listdir(cache_dir):
+        filename = os.path.join(cache_dir,filename)
+        if filename.endswith('.umf') and filename not in used: os.remove(filename)
+
+def link_archive(arg):
+    """ Pack the staged outputs into the URF in list order (urf_tool c, which
+        writes it with pleo_archive_type::write_archive_file)
+    """
+    urf_file,build_dir,list_file = arg
+    log('Linking %s' % urf_file)
+    args = tuple([pipes.quote(path) for path in (urf_file,build_dir,list_file)])
+    return (run(config.urf_tool_cmd_line % args),None)
+
+def build(upf_file,build_dir=None,force=False,thread_count=1):
+    """ Bring the URF for a UPF up to date, running up to thread_count build
+        steps at once
+        Returns the URF file name, None if the build failed
+    """
+    if build_dir is None: build_dir = os.path.join(os.path.dirname(upf_file),'build')
+    build_dir = os.path.normpath(build_dir)
+    for dirname,ext in STAGING.values():
+        path = os.path.join(build_dir,dirname)
+        if not os.path.isdir(path): os.makedirs(path)
+
+    proj_name,targets = find_targets(upf_file,build_dir)
+    write_index_includes(os.path.join(build_dir,INDEX_DIR),targets)
+    list_file = write_link_list(build_dir,targets)
+    manifest = load_manifest(build_dir)
+    hashes   = file_hashes(manifest['files'])
+    records  = manifest['targets']
+    if force: records = {}
+    remove_stale_outputs(build_dir,targets)
+
+    # Find what's stale...
+    stale   = []
+    current = {}
+    for target in targets:
+        if target['action'] is None:
+           print 'Warning: no converter for %s - left out of the URF%s' % (target['source'],target.get('warning',''))
+        elif is_stale(target,records.get(target['output']),hashes):
+           stale.append(target)
+        else:
+           current[target['output']] = records[target['output']]
+    up_to_date = len(current)
+
+    # One job per stale target, all ahead of one link job (old outputs go
+    # first, so a failed step can't leave one behind)...
+    jobs = []
+    for target in stale:
+        if os.path.exists(target['output']): os.remove(target['output'])
+        jobs.append(job_type(BUILDERS[target['action']],target,estimate_cost(target,records.get(target['output']))))
+    urf_file = os.path.join(build_dir,proj_name+'.urf')
+    link = {'command':config.urf_tool_cmd_line, 'output':urf_file, 'action':'link'}
+    link_job = None
+    if stale or is_stale(link,manifest['link'],hashes):
+       link_job = job_type(link_archive,(urf_file,build_dir,list_file),estimate_cost(link,manifest['link']),list(jobs))
+       jobs.append(link_job)
+
+    global server
+    if [target for target in stale if target['action']=='pawn']: server = pawn_server(build_dir)
+    try:
+       run_jobs(jobs,thread_count)
+
+       # Record what was built...
+       built  = 0
+       failed = 0
+       for job in jobs:
+           if job is link_job: continue
+           target = job.arg
+           if not job.ok: failed += 1
+           else: built += 1
+           if not job.ok or job.result is None: continue
+           hashes.changed(target['output'])
+           current[target['output']] = {'command' : target['command'],
+                                        'inputs'  : dict([(path,hashes.get(path)) for path in job.result]),
+                                        'output'  : hashes.get(target['output']),
+                                        'time'    : job.time}
+       if link_job and link_job.ok:
+          hashes.changed(urf_file)
+          inputs = [target['output'] for target in targets if target['output'] in current]
+          inputs += [list_file,tool_path(config.urf_tool_cmd_line)]
+          manifest['link'] = {'command' : config.urf_tool_cmd_line,
+                              'inputs'  : dict([(path,hashes.get(path)) for path in inputs]),
+                              'output'  : hashes.get(urf_file),
+                              'time'    : link_job.time}
+       elif link_job:
+          manifest['link'] = None
+          if failed==0: failed += 1
+    finally:
+       if server:
+          server.stop()
+          server = None
+       manifest['targets'] = current
+       manifest['files']   = hashes.used()
+       save_manifest(build_dir,manifest)
+       prune_umf_cache(build_dir,current)
+
+    print '%d up to date, %d rebuilt, %d failed%s' % (up_to_date,built,failed,(link_job and link_job.ok and ', relinked') or '')
+    if failed: return None
+    return urf_file
 
-parsed_upf = parse_upf.parse_upf_file(sys.argv[1])
+if __name__ == '__main__':
+   parser = OptionParser(usage='%prog [options] project.upf')
+   parser.add_option('-b','--build-dir',dest='build_dir',help='build directory (default: build next to the UPF)')
+   parser.add_option('-f','--force',action='store_true',dest='force',default=False,help='rebuild everything')
+   parser.add_option('-j','--jobs',type='int',dest='jobs',default=cpu_count(),help='build steps to run at once (default: one per CPU)')
+   options,args = parser.parse_args()
+   if len(args)!=1:
+      parser.print_help()
+      sys.exit(1)
+   start_time = time.time()
+   urf_file = build(args[0],options.build_dir,options.force,max(options.jobs,1))
+   print 'Build %s in %.3f s' % ((urf_file and 'done') or 'failed',time.time()-start_time)
+   if urf_file is None: sys.exit(1)
@@ -53,6 +53,13 @@
 
 #define MAX_RESOURCE_ENTRIES 0xFFF // maximum number of entries per resource type
 
+// Archive read/write control flags...
+#define PLEO_ARCHIVE_FLAG_NONE 0x00000000
+#define PLEO_ARCHIVE_FLAG_MMAP 0x00000001 // reference resources in place (mapped file / caller's image)
+#define PLEO_ARCHIVE_FLAG_DEDUP 0x00000002 // identical resources of a type share one payload when written
+#define PLEO_ARCHIVE_FLAG_VERIFY 0x00000004 // check ADLR trailer on read (-3 if mismatch)
+#define PLEO_ARCHIVE_FLAG_LAZY 0x00000008 // read TOC only; payloads fetched by get_element_dataptr
+
 
 //
 // Common Pleo Archive file (*.urf) header...
@@ -129,6 +136,54 @@ struct pleo_command_type : public pleo_command_header_type {
 
 
 
+//
+// Archive size breakdown (report_archive_budget).  Every byte of the archive
+// falls in exactly one field of the budget, its sections or its entries...
+//
+struct pleo_archive_budget_entrytype {
+  int resource_index;    // PLEO_TOC_xxx
+  int element_index;
+  int size;              // element data size
+  int payload;           // bytes stored (0 for fillers & shared duplicates)
+  int padding;           // alignment padding before element
+  int duplicate_of;      // earlier element of same type with identical data (-1=none)
+  int adpcm_savings;     // sound estimates, left 0 (see pleo_sound_type::estimate_usf_savings)
+  int silence_savings;
+};
+
+struct pleo_archive_budget_sectiontype {
+  int count;             // elements (fillers included)
+  int payload;           // element bytes stored
+  int element_padding;   // per element alignment padding
+  int section_padding;   // 512 byte alignment padding before section
+  int toc;               // TOC header & entries
+  int duplicate_bytes;   // data identical to an earlier element (not stored if deduplicated)
+};
+
+struct pleo_archive_budgettype {
+  int total;             // archive size (as compute_archive_filesize)
+  int header;            // archive header, TOC offsets & size record
+  int toc_padding;       // 512 byte alignment padding before TOCs
+  int crc;               // 8 byte alignment padding & ADLR record
+  int dedup_savings;     // bytes PLEO_ARCHIVE_FLAG_DEDUP saves (whether or not requested)
+  pleo_archive_budget_sectiontype sections[MAX_RESOURCE_TYPES];
+  pleo_archive_budget_entrytype *entries; // all elements in archive order (free() when done)
+  int entry_count;
+};
+
+
+
+//
+// Memory mapped archive image (kept until archive re-initialised)...
+//
+struct pleo_archive_mapping_type {
+  unsigned char *m_image;
+  int m_imagelen;
+  pleo_archive_mapping_type *m_next;
+};
+
+
+
 //
 // Archive storage class...
 //
@@ -147,17 +202,32 @@ public:
     int binofs;
   } m_toc_refinfo[MAX_RESOURCE_TYPES];
 
-  // Constructor...
+  // Images mapped by read_archive_file (PLEO_ARCHIVE_FLAG_MMAP)...
+  pleo_archive_mapping_type *m_mappings;
+
+  // File lazy resources are fetched from (PLEO_ARCHIVE_FLAG_LAZY, -1=none)...
+  int m_lazy_fd;
+
+  // Constructor/destructor...
   pleo_archive_type();
+  virtual ~pleo_archive_type();
 
   // Operations...
   void init_archive();
+  unsigned char *map_archive_file (const char *targetfile, int *binfilelen);
+  void unmap_archive_files();
   int get_resource_type (unsigned char *binfile);
   int read_archive_file (const char *targetfile, int flags=0);
+  int read_archive_toc (const char *targetfile, int flags=0);
   int read_archive_image (const char *targetfile, unsigned char *binfile, int binfilelen, int flags=0);
   int compute_archive_filesize (int flags=0);
+  int layout_archive (int flags=0, pleo_archive_budgettype *budget=NULL);
+  bool report_archive_budget (pleo_archive_budgettype *budget, int flags=0);
   unsigned char *write_archive_image (const char *targetfile, int *binfilelen, int flags=0);
   int write_archive_file (const char *targetfile, int flags=0);
+  int write_archive_stream (int fd, int flags=0);
+  int update_archive_file (const char *targetfile, int resource_index, const char *element_name, unsigned char *element_data, int element_datalen, int flags=0);
+  bool compact_pools();
   unsigned int adler32(unsigned int adler, unsigned char *buf, unsigned int len);
 };
 
@@ -29,6 +29,18 @@
 #include "resource_list.h"
 %}
 
+#define PLEO_ARCHIVE_FLAG_NONE 0x00000000
+#define PLEO_ARCHIVE_FLAG_MMAP 0x00000001
+#define PLEO_ARCHIVE_FLAG_DEDUP 0x00000002
+#define PLEO_ARCHIVE_FLAG_VERIFY 0x00000004
+#define PLEO_ARCHIVE_FLAG_LAZY 0x00000008
+
+#define PLEO_TOC_SOUND 0
+#define PLEO_TOC_MTN 1
+#define PLEO_TOC_COMMAND 2
+#define PLEO_TOC_SCRIPT 3
+#define PLEO_TOC_PROPERTY 4
+
 class pleo_archive_type
 {
 public:
@@ -39,6 +51,7 @@ public:
   pleo_resource_type m_properties;
 
   pleo_archive_type();
+  ~pleo_archive_type();
 
   void init_archive();
   %feature("autodoc","1");
@@ -46,14 +59,24 @@ public:
   %feature("autodoc","1");
   int read_archive_file (char *targetfile, int flags=0);
   %feature("autodoc","1");
+  int read_archive_toc (const char *targetfile, int flags=0);
+  %feature("autodoc","1");
   int read_archive_image (const char *targetfile, unsigned char *binfile, int binfilelen, int flags=0);
   %feature("autodoc","1");
   int compute_archive_filesize (int flags=0);
   %feature("autodoc","1");
+  int layout_archive (int flags=0);
+  %feature("autodoc","1");
   unsigned char *write_archive_image (const char *targetfile, int *binfilelen, int flags=0);
   %feature("autodoc","1");
   int write_archive_file (const char *targetfile, int flags=0);
   %feature("autodoc","1");
+  int write_archive_stream (int fd, int flags=0);
+  %feature("autodoc","1");
+  int update_archive_file (const char *targetfile, int resource_index, const char *element_name, unsigned char *element_data, int element_datalen, int flags=0);
+  %feature("autodoc","1");
+  bool compact_pools();
+  %feature("autodoc","1");
   unsigned int adler32(unsigned int adler, unsigned char *buf, unsigned int len);
 };
 
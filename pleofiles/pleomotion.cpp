@@ -0,0 +1,459 @@
+/*
+ * Copyright (c) 2010 John of dogsbodynet.com
+ *                    Gareth Nelson
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdio.h>
+#include <strings.h>
+#include "pleomotion.h"
+
+
+//
+// Motions come from CSV: one row per keyframe, the time (ms) then one
+// angle (degrees) per joint.  An optional header row names the joints
+// ("RIGHT_SHOULDER", "JOINT_NECK_VERTICAL" or the joint number), without
+// one the columns are joints 0, 1, 2...  An empty field holds the joint
+// where it was, '#' starts a comment line.
+//
+// Angles are kept in 0.1 degree units and quantised to angle_step when
+// written.  Each UGMF frame then stores only the joints that moved, as
+// varint deltas, so a typical frame is a handful of bytes.
+//
+
+// Joint column names, by joint number (include/pleo/joints.inc)...
+static const char *g_joint_names[PLEO_MOTION_MAX_JOINTS] = {
+  "RIGHT_SHOULDER", "RIGHT_ELBOW", "LEFT_SHOULDER", "LEFT_ELBOW",
+  "LEFT_HIP", "LEFT_KNEE", "RIGHT_HIP", "RIGHT_KNEE",
+  "TORSO", "TAIL_HORIZONTAL", "TAIL_VERTICAL", "NECK_HORIZONTAL",
+  "NECK_VERTICAL", "HEAD", "TRANSITION", "SOUND"};
+
+
+
+//
+// Constructor...
+//
+pleo_motion_type::pleo_motion_type()
+{
+  m_times = NULL;
+  m_angles = NULL;
+  m_max_frames = 0;
+  init_motion();
+}
+
+
+
+//
+// Destructor...
+//
+pleo_motion_type::~pleo_motion_type()
+{
+  init_motion();
+}
+
+
+
+//
+// Free frames...
+//
+void pleo_motion_type::init_motion()
+{
+  if (m_times) free (m_times);
+  if (m_angles) free (m_angles);
+  m_times = NULL;
+  m_angles = NULL;
+  m_max_frames = 0;
+  m_frame_count = 0;
+  m_joint_count = 0;
+  memset (m_joints, 0, sizeof(m_joints));
+  memset (m_motion_name, 0, sizeof(m_motion_name));
+  m_error[0] = 0;
+}
+
+
+
+void pleo_motion_type::set_motion_name (const char *name)
+{
+  memset (m_motion_name, 0, sizeof(m_motion_name));
+  if (name) strncpy (m_motion_name, name, UMF_NAME_MAXLEN);
+}
+
+
+
+//
+// Joint number for a column name (-1 if not a joint)...
+//
+int pleo_motion_type::find_joint (const char *name, int namelen)
+{
+  if ((namelen>6) && (strncasecmp(name, "JOINT_", 6)==0)) {
+    name += 6;
+    namelen -= 6;
+  }
+  if ((namelen>0) && (namelen<=2) && (name[0]>='0') && (name[0]<='9')) {
+    int joint = name[0]-'0';
+    if (namelen==2) joint = ((name[1]>='0') && (name[1]<='9')) ? 10*joint+name[1]-'0' : -1;
+    return (joint<PLEO_MOTION_MAX_JOINTS) ? joint : -1;
+  }
+  for (int joint=0; joint<PLEO_MOTION_MAX_JOINTS; joint++)
+    if (((int)strlen(g_joint_names[joint])==namelen) && (strncasecmp(g_joint_names[joint], name, namelen)==0))
+      return joint;
+  return -1;
+}
+
+
+
+//
+// Append a frame, joints held from the previous one...
+//
+bool pleo_motion_type::add_frame (unsigned int time)
+{
+  if (m_frame_count==m_max_frames) {
+    int max_frames = m_max_frames ? 2*m_max_frames : 256;
+    unsigned int *times = (unsigned int *)realloc(m_times, sizeof(unsigned int)*max_frames);
+    if (times==NULL) return false;
+    m_times = times;
+    short *angles = (short *)realloc(m_angles, sizeof(short)*PLEO_MOTION_MAX_JOINTS*max_frames);
+    if (angles==NULL) return false;
+    m_angles = angles;
+    m_max_frames = max_frames;
+  }
+  short *angles = &m_angles[m_frame_count*m_joint_count];
+  if (m_frame_count>0) memcpy (angles, angles-m_joint_count, sizeof(short)*m_joint_count);
+  else memset (angles, 0, sizeof(short)*m_joint_count);
+  m_times[m_frame_count++] = time;
+  return true;
+}
+
+
+
+// =========================================================================
+// CSV reading.
+
+//
+// Parse a decimal (no exponent) scaled by 10^decimals, rounded half away
+// from zero.  Returns 0 if field is empty, 1 if parsed, -1 if not a number
+// or out of range...
+//
+static int csv_read_fixed(const char *p, const char *end, int decimals, long long maxvalue, long long *value)
+{
+  while ((p<end) && ((*p==' ') || (*p=='\t') || (*p=='"'))) p++;
+  while ((end>p) && ((end[-1]==' ') || (end[-1]=='\t') || (end[-1]=='"'))) end--;
+  if (p==end) return 0;
+
+  bool negative = (*p=='-');
+  if ((*p=='-') || (*p=='+')) p++;
+  long long number = 0;
+  int digits = 0;
+  for (; (p<end) && (*p>='0') && (*p<='9'); p++, digits++)
+    if ((number = 10*number+(*p-'0')) > maxvalue) return -1;
+
+  // Fraction: keep decimals places, round on the next...
+  int places = 0;
+  bool round_up = false;
+  if ((p<end) && (*p=='.'))
+    for (p++; (p<end) && (*p>='0') && (*p<='9'); p++, digits++) {
+      if (places<decimals) number = 10*number+(*p-'0'), places++;
+      else if ((places++==decimals) && (*p>='5')) round_up = true;
+    }
+  for (; places<decimals; places++) number *= 10;
+  if (round_up) number++;
+
+  if ((digits==0) || (p!=end) || (number>maxvalue)) return -1;
+  *value = negative ? -number : number;
+  return 1;
+}
+
+
+
+//
+// Read motion from file...
+//
+int pleo_motion_type::read_motion_csv_file (const char *targetfile, int flags)
+{
+  FILE *fileid = fopen(targetfile, "rb");
+  if (fileid==NULL) {
+    snprintf (m_error, sizeof(m_error), "can't open %s", targetfile);
+    return PLEO_MOTION_ERROR_FILENOTFOUND;
+  }
+  fseek (fileid, 0, SEEK_END);
+  long len = ftell(fileid);
+  fseek (fileid, 0, SEEK_SET);
+  char *text = (len>=0) ? (char *)malloc(len ? len : 1) : NULL;
+  if ((text==NULL) || (fread(text, 1, len, fileid)!=(size_t)len)) {
+    fclose (fileid);
+    free (text);
+    snprintf (m_error, sizeof(m_error), "can't read %s", targetfile);
+    return PLEO_MOTION_ERROR_FILENOTFOUND;
+  }
+  fclose (fileid);
+
+  int result = read_motion_csv_image(text, len, flags);
+  free (text);
+  return result;
+}
+
+
+
+//
+// Read motion from CSV text.  Returns number of frames (<0 on error, see
+// m_error).  The motion name is left as it was...
+//
+int pleo_motion_type::read_motion_csv_image (const char *text, int textlen, int /*flags*/)
+{
+  char name[UMF_NAME_MAXLEN+1];
+  memcpy (name, m_motion_name, sizeof(name));
+  init_motion();
+  memcpy (m_motion_name, name, sizeof(name));
+  if ((text==NULL) || (textlen<0)) textlen = 0;
+
+  const char *end = text+textlen;
+  bool have_columns = false;
+  int line = 0;
+  for (const char *p=text; p<end; ) {
+    const char *row = p;
+    const char *eol = (const char *)memchr(p, '\n', end-p);
+    if (eol==NULL) eol = end;
+    p = (eol<end) ? eol+1 : end;
+    line++;
+    if ((eol>row) && (eol[-1]=='\r')) eol--;
+    while ((row<eol) && ((*row==' ') || (*row=='\t'))) row++;
+    if ((row==eol) || (*row=='#')) continue;
+
+    // Header row (first row not starting with a number) names the joints...
+    if (!have_columns) {
+      have_columns = true;
+      bool header = !(((*row>='0') && (*row<='9')) || (*row=='-') || (*row=='+') || (*row=='.'));
+      const char *field = (const char *)memchr(row, ',', eol-row);
+      for (int column=0; field!=NULL; column++) {
+        const char *start = field+1;
+        const char *stop = (const char *)memchr(start, ',', eol-start);
+        field = stop;
+        if (stop==NULL) stop = eol;
+        while ((start<stop) && ((*start==' ') || (*start=='\t') || (*start=='"'))) start++;
+        while ((stop>start) && ((stop[-1]==' ') || (stop[-1]=='\t') || (stop[-1]=='"'))) stop--;
+        if ((start==stop) && (field==NULL)) break; // trailing comma
+        if (m_joint_count==PLEO_MOTION_MAX_JOINTS) {
+          snprintf (m_error, sizeof(m_error), "more than %d joints (line %d)", PLEO_MOTION_MAX_JOINTS, line);
+          return PLEO_MOTION_ERROR_JOINT;
+        }
+        int joint = header ? find_joint(start, stop-start) : column;
+        for (int i=0; (joint>=0) && (i<m_joint_count); i++) if (m_joints[i]==joint) joint = -1;
+        if (joint<0) {
+          snprintf (m_error, sizeof(m_error), "unknown or repeated joint \"%.*s\" (line %d)", (int)(stop-start), start, line);
+          return PLEO_MOTION_ERROR_JOINT;
+        }
+        m_joints[m_joint_count++] = joint;
+      }
+      if (header) continue;
+    }
+
+    // Keyframe: time, then angles...
+    if (m_frame_count==PLEO_MOTION_MAX_FRAMES) {
+      snprintf (m_error, sizeof(m_error), "more than %d frames (line %d)", PLEO_MOTION_MAX_FRAMES, line);
+      return PLEO_MOTION_ERROR_TOOBIG;
+    }
+    const char *field = row;
+    for (int column=-1; field!=NULL; column++) {
+      const char *start = (column<0) ? field : field+1;
+      const char *stop = (const char *)memchr(start, ',', eol-start);
+      field = stop;
+      if (stop==NULL) stop = eol;
+
+      long long value;
+      int parsed = (column<0) ? csv_read_fixed(start, stop, 0, 0xFFFFFFFFLL, &value) : csv_read_fixed(start, stop, 1, 32767, &value);
+      if ((column>=m_joint_count) && (parsed==0)) continue; // trailing comma
+      if ((parsed<0) || (column>=m_joint_count) || ((column<0) && (parsed==0))) {
+        snprintf (m_error, sizeof(m_error), "bad %s \"%.*s\" (line %d)", (column<0) ? "time" : (column<m_joint_count) ? "or out of range angle" : "extra field", (int)(stop-start), start, line);
+        return PLEO_MOTION_ERROR_SYNTAX;
+      }
+      if (column<0) {
+        if ((value<0) || ((m_frame_count>0) && ((unsigned int)value<m_times[m_frame_count-1]))) {
+          snprintf (m_error, sizeof(m_error), "time goes backwards (line %d)", line);
+          return PLEO_MOTION_ERROR_SYNTAX;
+        }
+        if (!add_frame((unsigned int)value)) {
+          snprintf (m_error, sizeof(m_error), "out of memory");
+          return PLEO_MOTION_ERROR_NOMEM;
+        }
+      }
+      else if (parsed>0) m_angles[(m_frame_count-1)*m_joint_count+column] = (short)value;
+    }
+  }
+
+  if ((m_frame_count==0) || (m_joint_count==0)) {
+    snprintf (m_error, sizeof(m_error), "no keyframes");
+    return PLEO_MOTION_ERROR_NOFRAMES;
+  }
+  return m_frame_count;
+}
+
+
+
+// =========================================================================
+// UGMF images.
+
+static inline unsigned char *umf_put_varint(unsigned char *p, unsigned int value)
+{
+  while (value>=0x80) {
+    *p++ = (unsigned char)(value | 0x80);
+    value >>= 7;
+  }
+  *p++ = (unsigned char)value;
+  return p;
+}
+
+static inline const unsigned char *umf_get_varint(const unsigned char *p, const unsigned char *end, unsigned int *value)
+{
+  *value = 0;
+  for (int shift=0; (p<end) && (shift<35); shift+=7) {
+    *value |= (unsigned int)(*p & 0x7F) << shift;
+    if ((*p++ & 0x80)==0) return p;
+  }
+  return NULL;
+}
+
+// Round to nearest step, halves away from zero...
+static inline int umf_quantise(int angle, int angle_step)
+{
+  return (angle>=0) ? (angle+angle_step/2)/angle_step : -((-angle+angle_step/2)/angle_step);
+}
+
+
+
+//
+// Write UGMF image (malloc'd, NULL on error).  Angles are quantised to
+// angle_step (0.1 degree units)...
+//
+unsigned char *pleo_motion_type::write_pleo_umf_image (int *imagelen, int angle_step, int /*flags*/)
+{
+  if ((m_frame_count==0) || (m_joint_count==0) || (angle_step<1) || (angle_step>255)) return NULL;
+
+  // Worst case: 5 byte time, 3 byte mask, 3 bytes per joint...
+  int hdrlen = sizeof(pleo_umf_motion_hdrtype)+UMF_NAME_MAXLEN+sizeof(pleo_umf_motion_infotype)+m_joint_count;
+  unsigned char *imagedata = (unsigned char *)malloc(hdrlen+m_frame_count*(8+3*m_joint_count));
+  if (imagedata==NULL) return NULL;
+
+  memset (imagedata, 0, hdrlen);
+  pleo_umf_motion_hdrtype *hdr = (pleo_umf_motion_hdrtype*)imagedata;
+  memcpy (hdr->signature, "UGMF", 4);
+  hdr->version = PLEO_UMF_VERSION;
+  memcpy (&imagedata[sizeof(pleo_umf_motion_hdrtype)], m_motion_name, UMF_NAME_MAXLEN);
+  pleo_umf_motion_infotype *info = (pleo_umf_motion_infotype*)(&imagedata[sizeof(pleo_umf_motion_hdrtype)+UMF_NAME_MAXLEN]);
+  info->joint_count = (unsigned char)m_joint_count;
+  info->angle_step = (unsigned char)angle_step;
+  info->frame_count = (unsigned short)m_frame_count;
+  info->duration = m_times[m_frame_count-1];
+  memcpy (&imagedata[hdrlen-m_joint_count], m_joints, m_joint_count);
+
+  // Frames, as changes from the previous one...
+  int previous[PLEO_MOTION_MAX_JOINTS];
+  memset (previous, 0, sizeof(previous));
+  unsigned int previous_time = 0;
+  unsigned char *p = &imagedata[hdrlen];
+  for (int frame=0; frame<m_frame_count; frame++) {
+    const short *angles = &m_angles[frame*m_joint_count];
+    int delta[PLEO_MOTION_MAX_JOINTS];
+    unsigned int mask = 0;
+    for (int joint=0; joint<m_joint_count; joint++) {
+      int angle = umf_quantise(angles[joint], angle_step);
+      delta[joint] = angle-previous[joint];
+      previous[joint] = angle;
+      if (delta[joint]) mask |= 1<<joint;
+    }
+    p = umf_put_varint(p, m_times[frame]-previous_time);
+    p = umf_put_varint(p, mask);
+    for (int joint=0; joint<m_joint_count; joint++)
+      if (mask & (1<<joint)) p = umf_put_varint(p, ((unsigned int)delta[joint]<<1) ^ (unsigned int)(delta[joint]>>31)); // zigzag
+    previous_time = m_times[frame];
+  }
+
+  info->frame_datalen = p-&imagedata[hdrlen];
+  *imagelen = p-imagedata;
+  return imagedata;
+}
+
+
+
+bool pleo_motion_type::write_pleo_umf_file (const char *targetfile, int angle_step, int flags)
+{
+  int imagelen;
+  unsigned char *imagedata = write_pleo_umf_image(&imagelen, angle_step, flags);
+  if (imagedata==NULL) return false;
+
+  FILE *fileid = fopen (targetfile, "wb");
+  if (fileid==NULL) {
+    free (imagedata);
+    return false;
+  }
+  int writelen = fwrite (imagedata, 1, imagelen, fileid);
+  free (imagedata);
+  bool ok = (ferror(fileid)==0) && (writelen==imagelen);
+  return (fclose(fileid)==0) && ok;
+}
+
+
+
+//
+// Read UGMF image back into frames (angles as quantised).  Returns number
+// of frames...
+//
+int pleo_motion_type::read_pleo_umf_image (const unsigned char *imagedata, int imagelen, int /*flags*/)
+{
+  init_motion();
+  int hdrlen = sizeof(pleo_umf_motion_hdrtype)+UMF_NAME_MAXLEN+sizeof(pleo_umf_motion_infotype);
+  const pleo_umf_motion_hdrtype *hdr = (const pleo_umf_motion_hdrtype*)imagedata;
+  if ((imagedata==NULL) || (imagelen<hdrlen) || (memcmp(hdr->signature, "UGMF", 4)!=0) || (hdr->version!=PLEO_UMF_VERSION)) {
+    snprintf (m_error, sizeof(m_error), "not a version %d UGMF image", PLEO_UMF_VERSION);
+    return PLEO_MOTION_ERROR_FORMAT;
+  }
+  const pleo_umf_motion_infotype *info = (const pleo_umf_motion_infotype*)(&imagedata[sizeof(pleo_umf_motion_hdrtype)+UMF_NAME_MAXLEN]);
+  if ((info->joint_count==0) || (info->joint_count>PLEO_MOTION_MAX_JOINTS) || (info->angle_step==0) ||
+      (imagelen<hdrlen+info->joint_count) || (info->frame_datalen>(unsigned int)(imagelen-hdrlen-info->joint_count))) {
+    snprintf (m_error, sizeof(m_error), "bad UGMF info block");
+    return PLEO_MOTION_ERROR_FORMAT;
+  }
+  memcpy (m_motion_name, &imagedata[sizeof(pleo_umf_motion_hdrtype)], UMF_NAME_MAXLEN);
+  m_joint_count = info->joint_count;
+  memcpy (m_joints, &imagedata[hdrlen], m_joint_count);
+
+  const unsigned char *p = &imagedata[hdrlen+m_joint_count];
+  const unsigned char *end = p+info->frame_datalen;
+  int angle[PLEO_MOTION_MAX_JOINTS];
+  memset (angle, 0, sizeof(angle));
+  unsigned int time = 0;
+  for (int frame=0; frame<info->frame_count; frame++) {
+    unsigned int delta, mask;
+    if (((p = umf_get_varint(p, end, &delta))==NULL) || ((p = umf_get_varint(p, end, &mask))==NULL) || (mask>>m_joint_count)) break;
+    if (!add_frame(time += delta)) {
+      snprintf (m_error, sizeof(m_error), "out of memory");
+      return PLEO_MOTION_ERROR_NOMEM;
+    }
+    for (int joint=0; (p!=NULL) && (joint<m_joint_count); joint++) {
+      if ((mask & (1<<joint)) && ((p = umf_get_varint(p, end, &delta))!=NULL))
+        angle[joint] += (int)(delta>>1) ^ -(int)(delta & 1);
+      m_angles[frame*m_joint_count+joint] = (short)(angle[joint]*info->angle_step);
+    }
+    if (p==NULL) break;
+  }
+  if ((m_frame_count!=info->frame_count) || (p!=end)) {
+    snprintf (m_error, sizeof(m_error), "truncated UGMF frame data");
+    return PLEO_MOTION_ERROR_FORMAT;
+  }
+  return m_frame_count;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2010 John of dogsbodynet.com
+ *                    Gareth Nelson
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _PLEOMOTION_H_
+#define _PLEOMOTION_H_
+
+#include <stdlib.h>
+#include <string.h>
+
+#define UMF_NAME_MAXLEN 32 // name field is 32 bytes
+#define PLEO_UMF_VERSION 1 // delta keyframes (see pleo_umf_motion_infotype)
+#define PLEO_MOTION_MAX_JOINTS 16    // JOINT_RIGHT_SHOULDER..JOINT_SOUND (include/pleo/joints.inc)
+#define PLEO_MOTION_MAX_FRAMES 0xFFFF
+#define PLEO_MOTION_ANGLE_STEP 5     // default quantisation (0.1 degree units, so 0.5 degree)
+
+// read_motion_xxx / read_pleo_umf_image results (>=0 is the number of frames)...
+#define PLEO_MOTION_ERROR_FILENOTFOUND -1
+#define PLEO_MOTION_ERROR_SYNTAX -2   // bad number or row (m_error says where)
+#define PLEO_MOTION_ERROR_JOINT -3    // unknown or repeated joint column
+#define PLEO_MOTION_ERROR_NOFRAMES -4
+#define PLEO_MOTION_ERROR_TOOBIG -5   // too many frames, or a value out of range
+#define PLEO_MOTION_ERROR_FORMAT -6   // not a UGMF image this reads
+#define PLEO_MOTION_ERROR_NOMEM -7
+
+
+#pragma pack (push,1)
+  struct pleo_umf_motion_hdrtype {
+    char signature[4];      // "UGMF"
+    unsigned char version;  // PLEO_UMF_VERSION, 32-byte name field follows
+  };
+
+  //
+  // Follows the name.  Then joint_count joint numbers (1 byte each), then
+  // frame_count frames, each:
+  //   varint  time since previous frame (ms)
+  //   varint  mask of joints that moved (bit n = nth joint of the table)
+  //   zigzag varint per moved joint: change in angle/angle_step
+  // The frame before the first is time 0 with every joint at 0...
+  //
+  struct pleo_umf_motion_infotype {
+    unsigned char joint_count;
+    unsigned char angle_step;     // 0.1 degree units per stored step
+    unsigned short frame_count;
+    unsigned int duration;        // ms (time of last frame)
+    unsigned int frame_datalen;   // bytes of frame data after the joint table
+  };
+#pragma pack (pop)
+
+
+
+//
+// Keyframed joint motion...
+//
+class pleo_motion_type
+{
+public:
+  char m_motion_name[UMF_NAME_MAXLEN+1];
+  int m_joint_count;
+  unsigned char m_joints[PLEO_MOTION_MAX_JOINTS]; // joint number of each column
+  int m_frame_count;
+  int m_max_frames;
+  unsigned int *m_times;  // ms, per frame
+  short *m_angles;        // 0.1 degrees, m_joint_count per frame
+
+  char m_error[256]; // why the last read failed
+
+  // Constructor/destructor...
+  pleo_motion_type();
+  virtual ~pleo_motion_type();
+
+  // Operations...
+  void init_motion();
+  int read_motion_csv_file (const char *targetfile, int flags=0);
+  int read_motion_csv_image (const char *text, int textlen, int flags=0);
+  int read_pleo_umf_image (const unsigned char *imagedata, int imagelen, int flags=0);
+  unsigned char *write_pleo_umf_image (int *imagelen, int angle_step=PLEO_MOTION_ANGLE_STEP, int flags=0);
+  bool write_pleo_umf_file (const char *targetfile, int angle_step=PLEO_MOTION_ANGLE_STEP, int flags=0);
+  void set_motion_name (const char *name);
+  int find_joint (const char *name, int namelen);
+
+  // Internals...
+  bool add_frame (unsigned int time);
+};
+
+#endif // _PLEOMOTION_H_
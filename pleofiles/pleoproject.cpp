@@ -0,0 +1,689 @@
+/*
+ * Copyright (c) 2010 John of dogsbodynet.com
+ *                    Gareth Nelson
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdio.h>
+#include "pleoproject.h"
+
+
+//
+// UPF project files are read in one pass over the image: tags are
+// tokenised as they come (no tree is built) and <set>/<set-default>
+// variables, <resources> paths and <options> values are collected on the
+// way.  ${VAR} references are then resolved, each variable being expanded
+// once on first use, so a reference may come before its <set>.  A
+// <set-default> only applies if the name has no <set>.
+//
+
+
+//
+// Constructor...
+//
+pleo_project_type::pleo_project_type()
+{
+  m_project_name = NULL;
+  memset (m_lists, 0, sizeof(m_lists));
+  m_variable_hash = NULL;
+  m_variable_hash_size = 0;
+  m_error[0] = 0;
+}
+
+
+
+//
+// Destructor...
+//
+pleo_project_type::~pleo_project_type()
+{
+  init_project();
+}
+
+
+
+//
+// Free everything read...
+//
+void pleo_project_type::init_project()
+{
+  for (int kind=0; kind<PLEO_PROJECT_KINDS; kind++) {
+    pleo_project_listtype *list = &m_lists[kind];
+    for (int i=0; i<list->m_count; i++) {
+      free (list->m_entries[i].m_name);
+      free (list->m_entries[i].m_value);
+      free (list->m_entries[i].m_expanded);
+    }
+    if (list->m_entries) free (list->m_entries);
+    list->m_entries = NULL;
+    list->m_count = list->m_max_count = 0;
+  }
+  if (m_project_name) free (m_project_name);
+  m_project_name = NULL;
+  if (m_variable_hash) free (m_variable_hash);
+  m_variable_hash = NULL;
+  m_variable_hash_size = 0;
+  m_error[0] = 0;
+}
+
+
+
+//
+// Variable name hashing (FNV-1a)...
+//
+static unsigned int hash_variable_name(const char *name)
+{
+  unsigned int hash = 2166136261u;
+  for (; *name; name++) {
+    hash ^= (unsigned char)*name;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+
+
+//
+// Rebuild variable table, sized for at most 50% load...
+//
+bool pleo_project_type::rebuild_variable_hash()
+{
+  pleo_project_listtype *list = &m_lists[PLEO_PROJECT_VARIABLE];
+  int new_size = 64;
+  while (new_size < 2*list->m_count) new_size <<= 1;
+
+  if (new_size != m_variable_hash_size) {
+    int *new_hash = (int *)malloc(sizeof(int)*new_size);
+    if (new_hash==NULL) return false;
+    if (m_variable_hash) free (m_variable_hash);
+    m_variable_hash = new_hash;
+    m_variable_hash_size = new_size;
+  }
+  memset (m_variable_hash, 0, sizeof(int)*m_variable_hash_size);
+
+  int mask = m_variable_hash_size-1;
+  for (int i=0; i<list->m_count; i++) {
+    int slot = hash_variable_name(list->m_entries[i].m_name) & mask;
+    while (m_variable_hash[slot]) slot = (slot+1) & mask;
+    m_variable_hash[slot] = i+1;
+  }
+  return true;
+}
+
+
+
+//
+// Find variable by name (-1 if not set)...
+//
+int pleo_project_type::find_variable(const char *name)
+{
+  if ((name==NULL) || (m_variable_hash==NULL)) return -1;
+  pleo_project_listtype *list = &m_lists[PLEO_PROJECT_VARIABLE];
+  int mask = m_variable_hash_size-1;
+  for (int slot = hash_variable_name(name) & mask; m_variable_hash[slot]; slot = (slot+1) & mask)
+    if (strcmp(list->m_entries[m_variable_hash[slot]-1].m_name, name)==0)
+      return m_variable_hash[slot]-1;
+  return -1;
+}
+
+
+
+//
+// Append entry (value is malloc'd & taken over, even on failure)...
+//
+pleo_project_entrytype *pleo_project_type::add_entry(int kind, const char *name, char *value, int line)
+{
+  pleo_project_listtype *list = &m_lists[kind];
+  if (list->m_count==list->m_max_count) {
+    int max_count = list->m_max_count ? 2*list->m_max_count : 64;
+    pleo_project_entrytype *entries = (pleo_project_entrytype *)realloc(list->m_entries, sizeof(pleo_project_entrytype)*max_count);
+    if (entries==NULL) {
+      free (value);
+      return NULL;
+    }
+    list->m_entries = entries;
+    list->m_max_count = max_count;
+  }
+
+  pleo_project_entrytype *entry = &list->m_entries[list->m_count];
+  memset (entry, 0, sizeof(*entry));
+  entry->m_name = strdup(name);
+  entry->m_value = value;
+  entry->m_line = line;
+  if ((entry->m_name==NULL) || (value==NULL)) {
+    free (entry->m_name);
+    free (value);
+    return NULL;
+  }
+  list->m_count++;
+
+  if ((kind==PLEO_PROJECT_VARIABLE) && (m_variable_hash_size < 2*list->m_count) && !rebuild_variable_hash()) {
+    list->m_count--;
+    free (entry->m_name);
+    free (value);
+    return NULL;
+  }
+  else if (kind==PLEO_PROJECT_VARIABLE) {
+    int mask = m_variable_hash_size-1;
+    int slot = hash_variable_name(name) & mask;
+    while (m_variable_hash[slot]) slot = (slot+1) & mask;
+    m_variable_hash[slot] = list->m_count;
+  }
+  return entry;
+}
+
+
+
+// =========================================================================
+// Tokeniser.
+
+struct upf_cursortype {
+  const char *p;
+  const char *end;
+  int line;
+};
+
+struct upf_tagtype {
+  char name[64];
+  bool closing;  // </name>
+  bool empty;    // <name/>
+  char *attr_name;
+  char *attr_value;
+  char *attr_path;
+};
+
+static inline bool upf_space(char c) {return (c==' ') || (c=='\t') || (c=='\r') || (c=='\n');}
+
+static inline bool upf_namechar(char c)
+  {return ((c>='a') && (c<='z')) || ((c>='A') && (c<='Z')) || ((c>='0') && (c<='9')) || (c=='_') || (c=='-') || (c==':') || (c=='.');}
+
+static inline void upf_advance(upf_cursortype *c, const char *to)
+{
+  for (; c->p<to; c->p++) if (*c->p=='\n') c->line++;
+}
+
+//
+// Move past marker, false if not found...
+//
+static bool upf_skip_past(upf_cursortype *c, const char *marker)
+{
+  int len = strlen(marker);
+  for (const char *p=c->p; p+len<=c->end; p++)
+    if ((*p==*marker) && (memcmp(p, marker, len)==0)) {
+      upf_advance(c, p+len);
+      return true;
+    }
+  return false;
+}
+
+static inline bool upf_at(const upf_cursortype *c, const char *marker)
+{
+  int len = strlen(marker);
+  return (c->end-c->p >= len) && (memcmp(c->p, marker, len)==0);
+}
+
+//
+// Copy attribute value decoding character & entity references.  Unknown
+// entities are kept as written...
+//
+static char *upf_decode_value(const char *src, int len)
+{
+  char *value = (char *)malloc(len+1);
+  if (value==NULL) return NULL;
+  int out = 0;
+  for (int i=0; i<len; i++) {
+    const char *semi = (src[i]=='&') ? (const char *)memchr(&src[i], ';', len-i) : NULL;
+    int code = -1;
+    if (semi!=NULL) {
+      int entlen = semi-&src[i]+1;
+      if ((entlen==4) && (memcmp(&src[i], "&lt;", 4)==0)) code = '<';
+      else if ((entlen==4) && (memcmp(&src[i], "&gt;", 4)==0)) code = '>';
+      else if ((entlen==5) && (memcmp(&src[i], "&amp;", 5)==0)) code = '&';
+      else if ((entlen==6) && (memcmp(&src[i], "&quot;", 6)==0)) code = '"';
+      else if ((entlen==6) && (memcmp(&src[i], "&apos;", 6)==0)) code = '\'';
+      else if ((entlen>3) && (src[i+1]=='#')) {
+        char digits[16];
+        snprintf (digits, sizeof(digits), "%.*s", entlen-3, &src[i+2]);
+        char *stop;
+        long number = (digits[0]=='x') ? strtol(&digits[1], &stop, 16) : strtol(digits, &stop, 10);
+        if ((*stop==0) && (number>0) && (number<128)) code = (int)number;
+      }
+      if (code>=0) i += entlen-1;
+    }
+    value[out++] = (code>=0) ? (char)code : src[i];
+  }
+  value[out] = 0;
+  return value;
+}
+
+//
+// Parse tag at cursor ('<' of a start or end tag).  Keeps the name, value
+// & path attributes...
+//
+static bool upf_read_tag(upf_cursortype *c, upf_tagtype *tag, char *error, int errorlen)
+{
+  memset (tag, 0, sizeof(*tag));
+  int line = c->line;
+  c->p++;
+  if ((c->p<c->end) && (*c->p=='/')) {
+    tag->closing = true;
+    c->p++;
+  }
+
+  const char *name = c->p;
+  while ((c->p<c->end) && upf_namechar(*c->p)) c->p++;
+  int namelen = c->p-name;
+  if ((namelen==0) || (namelen>=(int)sizeof(tag->name))) {
+    snprintf (error, errorlen, "bad tag name (line %d)", line);
+    return false;
+  }
+  memcpy (tag->name, name, namelen);
+  tag->name[namelen] = 0;
+
+  for (;;) {
+    while ((c->p<c->end) && upf_space(*c->p)) upf_advance(c, c->p+1);
+    if (c->p>=c->end) break;
+    if (*c->p=='>') {
+      c->p++;
+      return true;
+    }
+    if (!tag->closing && upf_at(c, "/>")) {
+      c->p += 2;
+      tag->empty = true;
+      return true;
+    }
+
+    // name="value" or name='value'...
+    const char *attr = c->p;
+    while ((c->p<c->end) && upf_namechar(*c->p)) c->p++;
+    int attrlen = c->p-attr;
+    while ((c->p<c->end) && upf_space(*c->p)) upf_advance(c, c->p+1);
+    if (tag->closing || (attrlen==0) || (c->p>=c->end) || (*c->p!='=')) break;
+    c->p++;
+    while ((c->p<c->end) && upf_space(*c->p)) upf_advance(c, c->p+1);
+    if ((c->p>=c->end) || ((*c->p!='"') && (*c->p!='\''))) break;
+    const char *value = c->p+1;
+    const char *stop = (const char *)memchr(value, *c->p, c->end-value);
+    if (stop==NULL) break;
+    upf_advance(c, stop+1);
+
+    char **target = NULL;
+    if ((attrlen==4) && (memcmp(attr, "name", 4)==0)) target = &tag->attr_name;
+    else if ((attrlen==5) && (memcmp(attr, "value", 5)==0)) target = &tag->attr_value;
+    else if ((attrlen==4) && (memcmp(attr, "path", 4)==0)) target = &tag->attr_path;
+    if (target!=NULL) {
+      free (*target);
+      *target = upf_decode_value(value, stop-value);
+    }
+  }
+  snprintf (error, errorlen, "malformed <%s%s> tag (line %d)", tag->closing ? "/" : "", tag->name, line);
+  return false;
+}
+
+static void upf_free_tag(upf_tagtype *tag)
+{
+  free (tag->attr_name);
+  free (tag->attr_value);
+  free (tag->attr_path);
+}
+
+
+
+//
+// Read project from file...
+//
+int pleo_project_type::read_project_file (const char *targetfile, int flags)
+{
+  init_project();
+  FILE *fileid = fopen(targetfile, "rb");
+  if (fileid==NULL) {
+    snprintf (m_error, sizeof(m_error), "can't open %s", targetfile);
+    return PLEO_PROJECT_ERROR_FILENOTFOUND;
+  }
+  fseek (fileid, 0, SEEK_END);
+  long len = ftell(fileid);
+  fseek (fileid, 0, SEEK_SET);
+  char *image = (len>=0) ? (char *)malloc(len ? len : 1) : NULL;
+  if ((image==NULL) || (fread(image, 1, len, fileid)!=(size_t)len)) {
+    fclose (fileid);
+    free (image);
+    snprintf (m_error, sizeof(m_error), "can't read %s", targetfile);
+    return PLEO_PROJECT_ERROR_FILENOTFOUND;
+  }
+  fclose (fileid);
+
+  int result = read_project_image(image, len, flags);
+  free (image);
+  return result;
+}
+
+
+
+//
+// Read project from memory image.  Returns number of resources (<0 on
+// error, see m_error)...
+//
+int pleo_project_type::read_project_image (const char *image, int imagelen, int /*flags*/)
+{
+  init_project();
+  if ((image==NULL) || (imagelen<0)) return PLEO_PROJECT_ERROR_NOPROJECT;
+
+  upf_cursortype c = {image, image+imagelen, 1};
+  char stack[PLEO_PROJECT_MAX_DEPTH][64];
+  int depth = 0;
+  int resources_depth = -1; // stack position of <resources>, if inside
+  int options_depth = -1;   // stack position of <options>, if inside
+  int result = 0;
+
+  while ((result==0) && (c.p<c.end)) {
+    const char *open = (const char *)memchr(c.p, '<', c.end-c.p);
+    if (open==NULL) break;
+    upf_advance(&c, open);
+    int line = c.line;
+
+    // Comments, declarations & CDATA are skipped...
+    const char *skip_to = NULL;
+    if (upf_at(&c, "<!--")) skip_to = "-->";
+    else if (upf_at(&c, "<![CDATA[")) skip_to = "]]>";
+    else if (upf_at(&c, "<?")) skip_to = "?>";
+    else if (upf_at(&c, "<!")) skip_to = ">";
+    if (skip_to!=NULL) {
+      if (!upf_skip_past(&c, skip_to)) {
+        snprintf (m_error, sizeof(m_error), "unterminated comment or declaration (line %d)", line);
+        result = PLEO_PROJECT_ERROR_SYNTAX;
+      }
+      continue;
+    }
+
+    upf_tagtype tag;
+    if (!upf_read_tag(&c, &tag, m_error, sizeof(m_error))) {
+      upf_free_tag(&tag);
+      result = PLEO_PROJECT_ERROR_SYNTAX;
+      break;
+    }
+
+    // End tag closes the innermost element...
+    if (tag.closing) {
+      if ((depth==0) || (strcmp(stack[depth-1], tag.name)!=0)) {
+        snprintf (m_error, sizeof(m_error), "</%s> doesn't close <%s> (line %d)", tag.name, depth ? stack[depth-1] : "", line);
+        result = PLEO_PROJECT_ERROR_SYNTAX;
+      }
+      else {
+        depth--;
+        if (depth==resources_depth) resources_depth = -1;
+        if (depth==options_depth) options_depth = -1;
+      }
+      upf_free_tag(&tag);
+      continue;
+    }
+
+    // Start tag...
+    if (depth==0) {
+      if ((m_project_name!=NULL) || (strcmp(tag.name, "ugobe_project")!=0)) {
+        snprintf (m_error, sizeof(m_error), "<%s> where <ugobe_project> expected (line %d)", tag.name, line);
+        result = PLEO_PROJECT_ERROR_NOPROJECT;
+      }
+      else if ((m_project_name = strdup(tag.attr_name ? tag.attr_name : ""))==NULL) result = PLEO_PROJECT_ERROR_NOMEM;
+    }
+    else if ((strcmp(tag.name, "set")==0) || (strcmp(tag.name, "set-default")==0)) {
+      bool is_default = (tag.name[3]=='-');
+      char *value = tag.attr_value ? tag.attr_value : strdup("");
+      tag.attr_value = NULL;
+      int index = find_variable(tag.attr_name);
+      if (tag.attr_name==NULL) free (value);
+      else if (index<0) {
+        pleo_project_entrytype *entry = add_entry(PLEO_PROJECT_VARIABLE, tag.attr_name, value, line);
+        if (entry==NULL) result = PLEO_PROJECT_ERROR_NOMEM;
+        else entry->m_default = is_default;
+      }
+      else {
+        // <set> replaces anything, <set-default> only another default...
+        pleo_project_entrytype *entry = &m_lists[PLEO_PROJECT_VARIABLE].m_entries[index];
+        if (!is_default || entry->m_default) {
+          free (entry->m_value);
+          entry->m_value = value;
+          entry->m_line = line;
+          entry->m_default = is_default;
+        }
+        else free (value);
+      }
+    }
+    else if ((resources_depth>=0) && (tag.attr_path!=NULL)) {
+      if (add_entry(PLEO_PROJECT_RESOURCE, tag.name, tag.attr_path, line)==NULL) result = PLEO_PROJECT_ERROR_NOMEM;
+      tag.attr_path = NULL;
+    }
+    else if ((options_depth>=0) && (tag.attr_value!=NULL)) {
+      char name[PLEO_PROJECT_MAX_DEPTH*64] = "";
+      for (int i=options_depth+1; i<depth; i++) {
+        strcat (name, stack[i]);
+        strcat (name, "/");
+      }
+      strcat (name, tag.name);
+      if (add_entry(PLEO_PROJECT_OPTION, name, tag.attr_value, line)==NULL) result = PLEO_PROJECT_ERROR_NOMEM;
+      tag.attr_value = NULL;
+    }
+
+    if (!tag.empty && (result==0)) {
+      if (depth==PLEO_PROJECT_MAX_DEPTH) {
+        snprintf (m_error, sizeof(m_error), "elements nested too deeply (line %d)", line);
+        result = PLEO_PROJECT_ERROR_SYNTAX;
+      }
+      else {
+        if ((resources_depth<0) && (strcmp(tag.name, "resources")==0)) resources_depth = depth;
+        if ((options_depth<0) && (strcmp(tag.name, "options")==0)) options_depth = depth;
+        strcpy (stack[depth++], tag.name);
+      }
+    }
+    upf_free_tag(&tag);
+  }
+
+  if ((result==0) && (depth>0)) {
+    snprintf (m_error, sizeof(m_error), "<%s> not closed", stack[depth-1]);
+    result = PLEO_PROJECT_ERROR_SYNTAX;
+  }
+  if ((result==0) && (m_project_name==NULL)) {
+    snprintf (m_error, sizeof(m_error), "no <ugobe_project>");
+    result = PLEO_PROJECT_ERROR_NOPROJECT;
+  }
+  if (result==0) result = resolve_project();
+  if (result==PLEO_PROJECT_ERROR_NOMEM) snprintf (m_error, sizeof(m_error), "out of memory");
+  return result;
+}
+
+
+
+// =========================================================================
+// ${VAR} resolution.
+
+//
+// Expand variable (once; later uses take the result)...
+//
+int pleo_project_type::resolve_variable (int index)
+{
+  pleo_project_entrytype *entry = &m_lists[PLEO_PROJECT_VARIABLE].m_entries[index];
+  if (entry->m_resolving==2) return 0;
+  if (entry->m_resolving==1) {
+    snprintf (m_error, sizeof(m_error), "${%s} refers back to itself (line %d)", entry->m_name, entry->m_line);
+    return PLEO_PROJECT_ERROR_CYCLE;
+  }
+  entry->m_resolving = 1;
+  char *expanded;
+  int result = expand_text(entry->m_value, &expanded);
+  if (result<0) return result;
+  entry = &m_lists[PLEO_PROJECT_VARIABLE].m_entries[index];
+  entry->m_expanded = expanded;
+  entry->m_resolving = 2;
+  return 0;
+}
+
+
+
+//
+// Copy text with ${VAR} references replaced (malloc'd).  Unknown
+// variables are left as written...
+//
+int pleo_project_type::expand_text (const char *text, char **expanded)
+{
+  *expanded = NULL;
+  int len = strlen(text);
+  int maxlen = len+1;
+  int outlen = 0;
+  char *out = (char *)malloc(maxlen);
+  if (out==NULL) return PLEO_PROJECT_ERROR_NOMEM;
+
+  for (int i=0; i<len; ) {
+    const char *insert = &text[i];
+    int insertlen = 1;
+    const char *close = ((text[i]=='$') && (text[i+1]=='{')) ? strchr(&text[i+2], '}') : NULL;
+    if ((close!=NULL) && (close-&text[i+2] < 256)) {
+      char name[256];
+      snprintf (name, sizeof(name), "%.*s", (int)(close-&text[i+2]), &text[i+2]);
+      int index = find_variable(name);
+      insertlen = close-&text[i]+1;
+      if (index>=0) {
+        int result = resolve_variable(index);
+        if (result<0) {
+          free (out);
+          return result;
+        }
+        insert = m_lists[PLEO_PROJECT_VARIABLE].m_entries[index].m_expanded;
+        i += insertlen;
+        insertlen = strlen(insert);
+      }
+      else i += insertlen;
+    }
+    else i++;
+
+    if (outlen+insertlen+1 > maxlen) {
+      while (outlen+insertlen+1 > maxlen) maxlen *= 2;
+      char *newout = (char *)realloc(out, maxlen);
+      if (newout==NULL) {
+        free (out);
+        return PLEO_PROJECT_ERROR_NOMEM;
+      }
+      out = newout;
+    }
+    memcpy (&out[outlen], insert, insertlen);
+    outlen += insertlen;
+  }
+  out[outlen] = 0;
+  *expanded = out;
+  return 0;
+}
+
+
+
+//
+// Resolve every variable, resource & option, then split <include>
+// directories.  Returns number of resources...
+//
+int pleo_project_type::resolve_project ()
+{
+  for (int i=0; i<m_lists[PLEO_PROJECT_VARIABLE].m_count; i++) {
+    int result = resolve_variable(i);
+    if (result<0) return result;
+  }
+  for (int kind=PLEO_PROJECT_RESOURCE; kind<=PLEO_PROJECT_OPTION; kind++)
+    for (int i=0; i<m_lists[kind].m_count; i++) {
+      int result = expand_text(m_lists[kind].m_entries[i].m_value, &m_lists[kind].m_entries[i].m_expanded);
+      if (result<0) return result;
+    }
+
+  for (int i=0; i<m_lists[PLEO_PROJECT_OPTION].m_count; i++) {
+    if (strcmp(m_lists[PLEO_PROJECT_OPTION].m_entries[i].m_name, "include")!=0) continue;
+    int line = m_lists[PLEO_PROJECT_OPTION].m_entries[i].m_line;
+    const char *dirs = m_lists[PLEO_PROJECT_OPTION].m_entries[i].m_expanded;
+    while (*dirs) {
+      int len = strcspn(dirs, ":");
+      if (len>0) {
+        char *dir = (char *)malloc(len+1);
+        if (dir!=NULL) snprintf (dir, len+1, "%.*s", len, dirs);
+        pleo_project_entrytype *entry = add_entry(PLEO_PROJECT_INCLUDE, "include", dir, line);
+        if ((entry==NULL) || ((entry->m_expanded = strdup(dir))==NULL)) return PLEO_PROJECT_ERROR_NOMEM;
+      }
+      dirs += len;
+      if (*dirs) dirs++;
+    }
+  }
+  return m_lists[PLEO_PROJECT_RESOURCE].m_count;
+}
+
+
+
+// =========================================================================
+// Lookups.
+
+int pleo_project_type::get_entry_count (int kind)
+{
+  if ((kind<0) || (kind>=PLEO_PROJECT_KINDS)) return 0;
+  return m_lists[kind].m_count;
+}
+
+const char *pleo_project_type::get_entry_name (int kind, int index)
+{
+  if ((index<0) || (index>=get_entry_count(kind))) return NULL;
+  return m_lists[kind].m_entries[index].m_name;
+}
+
+//
+// Value of entry, ${VAR} resolved...
+//
+const char *pleo_project_type::get_entry_value (int kind, int index)
+{
+  if ((index<0) || (index>=get_entry_count(kind))) return NULL;
+  return m_lists[kind].m_entries[index].m_expanded;
+}
+
+const char *pleo_project_type::get_variable (const char *name)
+{
+  int index = find_variable(name);
+  return (index<0) ? NULL : m_lists[PLEO_PROJECT_VARIABLE].m_entries[index].m_expanded;
+}
+
+//
+// Option by path below <options> ("umf", "tools/pawn", "directories/build").
+// Last one wins...
+//
+const char *pleo_project_type::get_option (const char *name)
+{
+  if (name==NULL) return NULL;
+  for (int i=m_lists[PLEO_PROJECT_OPTION].m_count-1; i>=0; i--)
+    if (strcmp(m_lists[PLEO_PROJECT_OPTION].m_entries[i].m_name, name)==0)
+      return m_lists[PLEO_PROJECT_OPTION].m_entries[i].m_expanded;
+  return NULL;
+}
+
+int pleo_project_type::get_resource_count (const char *tag)
+{
+  int count = 0;
+  for (int i=0; i<m_lists[PLEO_PROJECT_RESOURCE].m_count; i++)
+    if ((tag==NULL) || (strcmp(m_lists[PLEO_PROJECT_RESOURCE].m_entries[i].m_name, tag)==0)) count++;
+  return count;
+}
+
+//
+// Path of the index'th resource of a kind ("script", "sound", "motion"...)...
+//
+const char *pleo_project_type::get_resource_path (const char *tag, int index)
+{
+  for (int i=0; i<m_lists[PLEO_PROJECT_RESOURCE].m_count; i++)
+    if ((tag==NULL) || (strcmp(m_lists[PLEO_PROJECT_RESOURCE].m_entries[i].m_name, tag)==0))
+      if (index-- == 0) return m_lists[PLEO_PROJECT_RESOURCE].m_entries[i].m_expanded;
+  return NULL;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2010 John of dogsbodynet.com
+ *                    Gareth Nelson
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _PLEOPROJECT_H_
+#define _PLEOPROJECT_H_
+
+#include <stdlib.h>
+#include <string.h>
+
+// read_project_xxx results (>=0 is the number of resources)...
+#define PLEO_PROJECT_ERROR_FILENOTFOUND -1
+#define PLEO_PROJECT_ERROR_SYNTAX -2    // malformed XML (m_error says where)
+#define PLEO_PROJECT_ERROR_NOPROJECT -3 // top element isn't <ugobe_project>
+#define PLEO_PROJECT_ERROR_CYCLE -4     // ${VAR} references loop back
+#define PLEO_PROJECT_ERROR_NOMEM -5
+
+// Entry kinds...
+#define PLEO_PROJECT_VARIABLE 0 // <set>/<set-default>: name, value
+#define PLEO_PROJECT_RESOURCE 1 // element with a path under <resources>: tag, path
+#define PLEO_PROJECT_OPTION 2   // element with a value under <options>: path below <options> ("umf", "tools/pawn"), value
+#define PLEO_PROJECT_INCLUDE 3  // one directory of <options><include> (':' separated)
+#define PLEO_PROJECT_KINDS 4
+
+#define PLEO_PROJECT_MAX_DEPTH 32 // element nesting limit
+
+
+//
+// One variable, resource, option or include directory...
+//
+struct pleo_project_entrytype {
+  char *m_name;
+  char *m_value;    // as written (entities decoded)
+  char *m_expanded; // ${VAR} references resolved
+  int m_line;
+  bool m_default;   // variable came from <set-default>
+  int m_resolving;  // variables: 0=not yet, 1=in progress, 2=done
+};
+
+struct pleo_project_listtype {
+  pleo_project_entrytype *m_entries;
+  int m_count;
+  int m_max_count;
+};
+
+
+
+//
+// UPF project file reader...
+//
+class pleo_project_type
+{
+public:
+  char *m_project_name;
+  pleo_project_listtype m_lists[PLEO_PROJECT_KINDS]; // indexed by PLEO_PROJECT_xxx, in file order
+
+  // Open-addressing variable name->index table (slot holds index+1, 0=empty)...
+  int *m_variable_hash;
+  int m_variable_hash_size; // power of 2
+
+  char m_error[256]; // why the last read failed
+
+  // Constructor/destructor...
+  pleo_project_type();
+  virtual ~pleo_project_type();
+
+  // Operations...
+  void init_project();
+  int read_project_file (const char *targetfile, int flags=0);
+  int read_project_image (const char *image, int imagelen, int flags=0);
+  int get_entry_count (int kind);
+  const char *get_entry_name (int kind, int index);
+  const char *get_entry_value (int kind, int index);
+  const char *get_variable (const char *name);
+  const char *get_option (const char *name);
+  int get_resource_count (const char *tag);
+  const char *get_resource_path (const char *tag, int index);
+
+  // Internals...
+  pleo_project_entrytype *add_entry (int kind, const char *name, char *value, int line);
+  int find_variable (const char *name);
+  bool rebuild_variable_hash ();
+  int resolve_variable (int index);
+  int expand_text (const char *text, char **expanded);
+  int resolve_project ();
+};
+
+
+
+#endif // _PLEOPROJECT_H_
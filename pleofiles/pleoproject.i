@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2010 John of dogsbodynet.com
+ *                    Gareth Nelson
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+%module pleoproject
+
+
+%{
+#include "pleoproject.h"
+%}
+
+#define PLEO_PROJECT_ERROR_FILENOTFOUND -1
+#define PLEO_PROJECT_ERROR_SYNTAX -2
+#define PLEO_PROJECT_ERROR_NOPROJECT -3
+#define PLEO_PROJECT_ERROR_CYCLE -4
+#define PLEO_PROJECT_ERROR_NOMEM -5
+
+#define PLEO_PROJECT_VARIABLE 0
+#define PLEO_PROJECT_RESOURCE 1
+#define PLEO_PROJECT_OPTION 2
+#define PLEO_PROJECT_INCLUDE 3
+
+class pleo_project_type
+{
+public:
+  char *m_project_name;
+  char m_error[256];
+
+  pleo_project_type();
+  ~pleo_project_type();
+
+  void init_project();
+  %feature("autodoc","1");
+  int read_project_file (const char *targetfile, int flags=0);
+  %feature("autodoc","1");
+  int read_project_image (const char *image, int imagelen, int flags=0);
+  %feature("autodoc","1");
+  int get_entry_count (int kind);
+  %feature("autodoc","1");
+  const char *get_entry_name (int kind, int index);
+  %feature("autodoc","1");
+  const char *get_entry_value (int kind, int index);
+  %feature("autodoc","1");
+  const char *get_variable (const char *name);
+  %feature("autodoc","1");
+  const char *get_option (const char *name);
+  %feature("autodoc","1");
+  int get_resource_count (const char *tag);
+  %feature("autodoc","1");
+  const char *get_resource_path (const char *tag, int index);
+};
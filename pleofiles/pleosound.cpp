@@ -22,6 +22,9 @@
  */
 #include <stdlib.h>
 #include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "pleosound.h"
 
 
@@ -44,94 +47,111 @@ static int g_adpcm_stepsize_table[MAX_STEPSIZE+1] = {
 
 
 
+// ADPCM predictor state (carried from sample to sample)...
+struct adpcm_statetype {
+  int value;
+  int index;
+};
+
+
+//
+// Encode one sample & update predictor state.  Returns nibble...
+//
+static inline int adpcm_encode_sample(int value, adpcm_statetype *state)
+{
+  int stepsize = g_adpcm_stepsize_table[state->index];
+  int diff, sign;
+  int delta, vpdiff;
+
+  // Get difference & sign...
+  diff = value-state->value;
+  if (diff<0) {sign=8; diff=-diff;} else sign=0;
+
+  // Compute: 
+  //   delta = diff*4/stepsize;
+  //   vpdiff = (delta+0.5)*stepsize/4;
+  delta = 0;
+  vpdiff = (stepsize >> 3);
+  if ( diff >= stepsize ) {
+    delta = 4;
+    diff -= stepsize;
+    vpdiff += stepsize;
+  }
+  stepsize >>= 1;
+  if ( diff >= stepsize  ) {
+    delta |= 2;
+    diff -= stepsize;
+    vpdiff += stepsize;
+  }
+  stepsize >>= 1;
+  if ( diff >= stepsize ) {
+    delta |= 1;
+    vpdiff += stepsize;
+  }
+
+  // Update & clamp previous value...
+  if (sign) state->value -= vpdiff; else state->value += vpdiff;
+  if (state->value > 32767) state->value = 32767; else if (state->value <-32768) state->value = -32768;
+
+  // Update step index...
+  delta = (delta|sign)&0xF;
+  state->index += g_adpcm_index_table[delta];
+  if (state->index < 0) state->index = 0;
+  if (state->index > MAX_STEPSIZE) state->index = MAX_STEPSIZE;
+  return delta;
+}
+
+
+//
+// Read one PCM sample as signed 16-bit range...
+//
+static inline int adpcm_read_sample(const unsigned char *srcdata, int src_samplesize)
+{
+  switch (src_samplesize) {
+    case 1 : return srcdata[0] - 128;
+    case 2 : return *(const short *)srcdata;
+    default : return *(const int *)srcdata >> 16;
+  }
+}
+
+
+
+static void adpcm_search_encode(const unsigned char *srcdata, int sample_count, int src_samplesize, adpcm_statetype state, unsigned char *destdata);
+
+
 //
 // Convert PCM input to ADPCM...
 //   8 bit input assumed unsigned.
 //   16 & 32-bit input assumed signed.
+//   SOUNDBASE_PLEO_ADPCM_SEARCH selects the (slower) search encoder.
 //
 int pleo_sound_type::pleo_sound_convert_pcm2adpcm(
   unsigned char *srcdata, int srclen, int src_samplesize,
   unsigned char **destdata, int *destlen,
   int flags)
 {
-  int state = 0; // None
+  if ((src_samplesize!=1) && (src_samplesize!=2) && (src_samplesize!=4)) return -1; // invalid sample size...
 
-  unsigned char *src_charptr = (unsigned char *)srcdata;
-  short *src_shortptr = (short *)srcdata;
-  int *src_intptr = (int *)srcdata;
-
-  int value;
-  int last_value = 0;  
-  int diff, sign;
-  int delta, vpdiff;
+  adpcm_statetype state = {0, 0};
   int last_delta=0;
 
-  int stepsize_index = 0;
-  int stepsize = g_adpcm_stepsize_table[stepsize_index];
-
   int newbuf_maxsize = srclen;
-  unsigned char *newbuf = (unsigned char *)malloc(newbuf_maxsize);
+  unsigned char *newbuf = (unsigned char *)malloc(newbuf_maxsize ? newbuf_maxsize : 1);
   if (newbuf==NULL) return -1;
   int newbuf_datalen = 0;
   bool newbuf_increment = false;
 
-  for (int i=0; i<srclen; i += src_samplesize) {
-    switch (src_samplesize) {
-      case 1 : value = *(src_charptr++) - 128; break;
-      case 2 : value = *(src_shortptr++); break;
-      case 4 : value = *(src_intptr++) >> 16; break;
-      default : return -1; // invalid sample size...
-    }
-
-    // Get difference & sign...
-    diff = value-last_value;
-    if (diff<0) {sign=8; diff=-diff;} else sign=0;
-
-    // Compute: 
-    //   delta = diff*4/stepsize;
-    //   vpdiff = (delta+0.5)*stepsize/4;
-    delta = 0;
-    vpdiff = (stepsize >> 3);
-    if ( diff >= stepsize ) {
-      delta = 4;
-      diff -= stepsize;
-      vpdiff += stepsize;
-    }
-    stepsize >>= 1;
-    if ( diff >= stepsize  ) {
-      delta |= 2;
-      diff -= stepsize;
-      vpdiff += stepsize;
-    }
-    stepsize >>= 1;
-    if ( diff >= stepsize ) {
-      delta |= 1;
-      vpdiff += stepsize;
-    }
+  if (flags & SOUNDBASE_PLEO_ADPCM_SEARCH) {
+    newbuf_datalen = (srclen/src_samplesize)/2;
+    adpcm_search_encode(srcdata, 2*newbuf_datalen, src_samplesize, state, newbuf);
+  }
+  else for (int i=0; i<srclen; i += src_samplesize) {
+    int delta = adpcm_encode_sample(adpcm_read_sample(&srcdata[i], src_samplesize), &state);
 
-    // Update & clamp previous value...
-    if (sign) last_value -= vpdiff; else last_value += vpdiff;
-    if (last_value > 32767) last_value = 32767; else if (last_value <-32768) last_value = -32768;
-
-    // Update output...
-    delta = (delta|sign)&0xF;
-    if (newbuf_increment) {
-      if (newbuf_datalen >= newbuf_maxsize) {
-        newbuf_maxsize += 2*(srclen-i);
-        unsigned char *tempbuf = (unsigned char *)xrealloc(newbuf,newbuf_maxsize);
-        if (tempbuf==NULL) {free(newbuf); return -1;}
-        newbuf = tempbuf;
-      }
-      newbuf[newbuf_datalen++] = delta | (last_delta<<4);
-    }
+    // Update output (two samples per byte, first in high nibble)...
+    if (newbuf_increment) newbuf[newbuf_datalen++] = delta | (last_delta<<4);
     last_delta = delta;
     newbuf_increment = !newbuf_increment;
-
-    // Update step index & value...
-    stepsize_index += g_adpcm_index_table[delta];
-    if (stepsize_index < 0) stepsize_index = 0;
-    if (stepsize_index > MAX_STEPSIZE) stepsize_index = MAX_STEPSIZE;
-    stepsize = g_adpcm_stepsize_table[stepsize_index];
   }
 
   // Return results...
@@ -142,91 +162,1020 @@ int pleo_sound_type::pleo_sound_convert_pcm2adpcm(
 
 
 
+// =========================================================================
+// ADPCM decoder.
 //
-// Convert ADPCM to signed PCM...
+// Decoding is serial (each sample depends on the last), so the per-sample
+// work is cut to one lookup in a combined step table: for every step index
+// & nibble it holds the signed difference and the next step index.  Samples
+// are decoded to 16-bit in blocks, then widened/narrowed to the requested
+// sample size with SSE2 where available.
+
+struct adpcm_decode_entrytype {
+  int diff;       // signed vpdiff
+  int next_index; // clamped step index for next sample
+};
+
+static adpcm_decode_entrytype g_adpcm_decode_table[MAX_STEPSIZE+1][16];
+
+static bool init_adpcm_decode_table()
+{
+  for (int index=0; index<=MAX_STEPSIZE; index++)
+    for (int nibble=0; nibble<16; nibble++) {
+      int stepsize = g_adpcm_stepsize_table[index];
+      int delta = nibble & 7;
+
+      // vpdiff = (delta+0.5)*step/4;
+      int vpdiff = stepsize >> 3;
+      if ( delta & 4 ) vpdiff += stepsize;
+      if ( delta & 2 ) vpdiff += stepsize>>1;
+      if ( delta & 1 ) vpdiff += stepsize>>2;
+
+      int next_index = index + g_adpcm_index_table[delta];
+      if (next_index < 0) next_index = 0;
+      if (next_index > MAX_STEPSIZE) next_index = MAX_STEPSIZE;
+
+      g_adpcm_decode_table[index][nibble].diff = (nibble & 8) ? -vpdiff : vpdiff;
+      g_adpcm_decode_table[index][nibble].next_index = next_index;
+    }
+  return true;
+}
+
+static bool g_adpcm_decode_table_ready = init_adpcm_decode_table();
+
+
+#define ADPCM_DECODE_BLOCK 1024 // source bytes decoded per widening pass
+
+//
+// Decode srclen bytes (high nibble first) to 2*srclen 16-bit samples...
+//
+static void adpcm_decode_samples(const unsigned char *srcdata, int srclen, short *destdata, adpcm_statetype *state)
+{
+  int value = state->value;
+  int index = state->index;
+  for (int i=0; i<srclen; i++) {
+    const adpcm_decode_entrytype *entry = &g_adpcm_decode_table[index][srcdata[i]>>4];
+    value += entry->diff;
+    if (value > 32767) value = 32767; else if (value < -32768) value = -32768;
+    destdata[2*i] = (short)value;
+    index = entry->next_index;
+
+    entry = &g_adpcm_decode_table[index][srcdata[i]&0xF];
+    value += entry->diff;
+    if (value > 32767) value = 32767; else if (value < -32768) value = -32768;
+    destdata[2*i+1] = (short)value;
+    index = entry->next_index;
+  }
+  state->value = value;
+  state->index = index;
+}
+
+
+//
+// 16-bit samples to unsigned 8-bit (value+128, clamped) & to 32-bit (value<<16)...
+//
+static void adpcm_narrow8_scalar(const short *srcdata, int count, unsigned char *destdata)
+{
+  for (int i=0; i<count; i++) {
+    int temp = srcdata[i]+128;
+    if (temp<0) temp=0;
+    if (temp>255) temp=255;
+    destdata[i] = temp;
+  }
+}
+
+static void adpcm_widen32_scalar(const short *srcdata, int count, unsigned char *destdata)
+{
+  for (int i=0; i<count; i++) {
+    int temp = (int)((unsigned int)(int)srcdata[i] << 16);
+    memcpy (&destdata[4*i], &temp, sizeof(temp));
+  }
+}
+
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ADPCM_SIMD
+#include <emmintrin.h>
+
+__attribute__((target("sse2")))
+static void adpcm_narrow8_sse2(const short *srcdata, int count, unsigned char *destdata)
+{
+  const __m128i bias = _mm_set1_epi16(128);
+  int i = 0;
+  for (; i+16<=count; i+=16) {
+    __m128i lo = _mm_adds_epi16(_mm_loadu_si128((const __m128i *)&srcdata[i]), bias);
+    __m128i hi = _mm_adds_epi16(_mm_loadu_si128((const __m128i *)&srcdata[i+8]), bias);
+    _mm_storeu_si128((__m128i *)&destdata[i], _mm_packus_epi16(lo, hi));
+  }
+  adpcm_narrow8_scalar(&srcdata[i], count-i, &destdata[i]);
+}
+
+__attribute__((target("sse2")))
+static void adpcm_widen32_sse2(const short *srcdata, int count, unsigned char *destdata)
+{
+  const __m128i zero = _mm_setzero_si128();
+  int i = 0;
+  for (; i+8<=count; i+=8) {
+    __m128i v = _mm_loadu_si128((const __m128i *)&srcdata[i]);
+    _mm_storeu_si128((__m128i *)&destdata[4*i], _mm_unpacklo_epi16(zero, v));
+    _mm_storeu_si128((__m128i *)&destdata[4*i+16], _mm_unpackhi_epi16(zero, v));
+  }
+  adpcm_widen32_scalar(&srcdata[i], count-i, &destdata[4*i]);
+}
+#endif
+
+
+typedef void (*adpcm_convert_func_type)(const short *srcdata, int count, unsigned char *destdata);
+
+struct adpcm_convert_functype {
+  adpcm_convert_func_type narrow8;
+  adpcm_convert_func_type widen32;
+};
+
+static adpcm_convert_functype select_adpcm_convert()
+{
+  adpcm_convert_functype funcs = {adpcm_narrow8_scalar, adpcm_widen32_scalar};
+#ifdef ADPCM_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2")) {
+    funcs.narrow8 = adpcm_narrow8_sse2;
+    funcs.widen32 = adpcm_widen32_sse2;
+  }
+#endif
+  return funcs;
+}
+
+static adpcm_convert_functype g_adpcm_convert = select_adpcm_convert();
+
+
+//
+// Decode whole buffer to dest_samplesize byte samples.  16-bit samples are
+// decoded in place; others go through a 16-bit block first...
+//
+template <int dest_samplesize>
+static void adpcm_decode(const unsigned char *srcdata, int srclen, unsigned char *destdata)
+{
+  adpcm_statetype state = {0, 0};
+  short block[2*ADPCM_DECODE_BLOCK];
+
+  for (int ofs=0; ofs<srclen; ofs+=ADPCM_DECODE_BLOCK) {
+    int len = (srclen-ofs < ADPCM_DECODE_BLOCK) ? srclen-ofs : ADPCM_DECODE_BLOCK;
+    unsigned char *blockdest = &destdata[2*ofs*dest_samplesize];
+    if (dest_samplesize==2)
+      adpcm_decode_samples(&srcdata[ofs], len, (short *)blockdest, &state);
+    else {
+      adpcm_decode_samples(&srcdata[ofs], len, block, &state);
+      if (dest_samplesize==1) g_adpcm_convert.narrow8(block, 2*len, blockdest);
+      else g_adpcm_convert.widen32(block, 2*len, blockdest);
+    }
+  }
+}
+
+
+
+//
+// Convert ADPCM to signed PCM (unsigned if 8 bit).  Output is exactly two
+// samples per source byte...
 //
 int pleo_sound_type::pleo_sound_convert_adpcm2pcm(
   unsigned char *srcdata, int srclen,
   unsigned char **destdata, int *destlen, int dest_samplesize,
-  int flags)
+  int /*flags*/)
 {
-  int output_value=0;
-
-  int stepsize_index = 0;
-  int stepsize = g_adpcm_stepsize_table[stepsize_index];
-  bool srcbuf_increment = true;
+  if ((srcdata==NULL) || (srclen<0)) return -1;
+  if ((dest_samplesize!=1) && (dest_samplesize!=2) && (dest_samplesize!=4)) return -1; // invalid sample size...
 
-  int newbuf_maxsize = (srclen*dest_samplesize*2)+4096;
-  unsigned char *newbuf = (unsigned char *)malloc(newbuf_maxsize);
+  int newbuf_datalen = srclen*2*dest_samplesize;
+  unsigned char *newbuf = (unsigned char *)malloc(newbuf_datalen ? newbuf_datalen : 1);
   if (newbuf==NULL) return -1;
-  int newbuf_datalen = 0;
 
-  int value,vpdiff,delta,sign;
-  for (int i=0; i<srclen*dest_samplesize*2; i += dest_samplesize) {
-    if (srcbuf_increment) {
-      value = *(srcdata++);
-      delta = value>>4;
-    }
-    else delta = value;
-    srcbuf_increment = !srcbuf_increment;
-
-    // Get difference & sign...
-    sign = delta & 8;
-    delta &= 7;
-
-    // Compute: vpdiff = (delta+0.5)*step/4;
-    vpdiff = stepsize >> 3;
-    if ( delta & 4 ) vpdiff += stepsize;
-    if ( delta & 2 ) vpdiff += stepsize>>1;
-    if ( delta & 1 ) vpdiff += stepsize>>2;
-
-    // Update & clamp previous value...
-    if (sign) output_value -= vpdiff; else output_value += vpdiff;
-    if (output_value > 32767) output_value = 32767; else if (output_value <-32768) output_value = -32768;
-
-    // Update step index & value...
-    stepsize_index += g_adpcm_index_table[delta];
-    if (stepsize_index < 0) stepsize_index = 0;
-    if (stepsize_index > MAX_STEPSIZE) stepsize_index = MAX_STEPSIZE;
-    stepsize = g_adpcm_stepsize_table[stepsize_index];
-
-    // Output value...
-    if ((newbuf_datalen+dest_samplesize) >= newbuf_maxsize) {
-      newbuf_maxsize *= 2;
-      unsigned char *tempbuf = (unsigned char *)xrealloc(newbuf,newbuf_maxsize);
-      if (tempbuf==NULL) {free(newbuf); return -1;}
-      newbuf = tempbuf;
+  switch (dest_samplesize) {
+    case 1 : adpcm_decode<1>(srcdata, srclen, newbuf); break;
+    case 2 : adpcm_decode<2>(srcdata, srclen, newbuf); break;
+    case 4 : adpcm_decode<4>(srcdata, srclen, newbuf); break;
+  }
+
+  // Return results...
+  if (destdata) *destdata = newbuf;
+  if (destlen) *destlen = newbuf_datalen;
+  return newbuf_datalen;
+}
+
+
+
+// =========================================================================
+// ADPCM search encoder (SOUNDBASE_PLEO_ADPCM_SEARCH).
+//
+// The greedy encoder picks each nibble for the current sample alone, which
+// often costs more error later (a step index driven too high or too low).
+// The search keeps the ADPCM_SEARCH_PATHS lowest-error nibble sequences,
+// extending each by all 16 nibbles per sample; paths reaching the same
+// decoder state are merged (their futures are identical).  Nibbles are
+// committed ADPCM_SEARCH_DEPTH samples late from the best path, pruning
+// paths that disagree.  Output decodes with the standard decoder, so the
+// USF format is unchanged.
+
+#define ADPCM_SEARCH_PATHS 8  // surviving paths per sample
+#define ADPCM_SEARCH_DEPTH 16 // samples of lookahead before a nibble is committed (<=16)
+
+// Per step index & nibble: signed difference & next index (decode table,
+// laid out for 4-wide loads)...
+static int g_adpcm_search_diff[MAX_STEPSIZE+1][16] __attribute__((aligned(16)));
+static unsigned char g_adpcm_search_index[MAX_STEPSIZE+1][16];
+
+static bool init_adpcm_search_table()
+{
+  for (int index=0; index<=MAX_STEPSIZE; index++)
+    for (int nibble=0; nibble<16; nibble++) {
+      g_adpcm_search_diff[index][nibble] = g_adpcm_decode_table[index][nibble].diff;
+      g_adpcm_search_index[index][nibble] = g_adpcm_decode_table[index][nibble].next_index;
     }
+  return true;
+}
 
-    switch (dest_samplesize) {
-      case 1 : {
-        int temp = output_value+128;
-        if (temp<0) temp=0;
-        if (temp>255) temp=255;
-        newbuf[newbuf_datalen++] = temp;
-        break;
+static bool g_adpcm_search_table_ready = init_adpcm_search_table();
+
+
+//
+// Decoded value & squared error (difference clamped to 16 bits) of all 16
+// nibbles from state, against target...
+//
+static void adpcm_search_candidates_scalar(const adpcm_statetype *state, int target, short *values, int *errors)
+{
+  const int *diff = g_adpcm_search_diff[state->index];
+  for (int nibble=0; nibble<16; nibble++) {
+    int value = state->value + diff[nibble];
+    if (value > 32767) value = 32767; else if (value < -32768) value = -32768;
+    int error = value - target;
+    if (error > 32767) error = 32767; else if (error < -32768) error = -32768;
+    values[nibble] = (short)value;
+    errors[nibble] = error*error;
+  }
+}
+
+#ifdef ADPCM_SIMD
+__attribute__((target("sse2")))
+static void adpcm_search_candidates_sse2(const adpcm_statetype *state, int target, short *values, int *errors)
+{
+  const __m128i *diff = (const __m128i *)g_adpcm_search_diff[state->index];
+  const __m128i base = _mm_set1_epi32(state->value);
+  const __m128i goal = _mm_set1_epi16((short)target);
+  const __m128i zero = _mm_setzero_si128();
+  for (int i=0; i<2; i++) {
+    // Saturating pack is the decoder's clamp...
+    __m128i value = _mm_packs_epi32(_mm_add_epi32(base, _mm_load_si128(&diff[2*i])), _mm_add_epi32(base, _mm_load_si128(&diff[2*i+1])));
+    __m128i error = _mm_subs_epi16(value, goal);
+    __m128i lo = _mm_unpacklo_epi16(error, zero);
+    __m128i hi = _mm_unpackhi_epi16(error, zero);
+    _mm_storeu_si128((__m128i *)&values[8*i], value);
+    _mm_storeu_si128((__m128i *)&errors[8*i], _mm_madd_epi16(lo, lo));
+    _mm_storeu_si128((__m128i *)&errors[8*i+4], _mm_madd_epi16(hi, hi));
+  }
+}
+#endif
+
+typedef void (*adpcm_search_func_type)(const adpcm_statetype *state, int target, short *values, int *errors);
+
+static adpcm_search_func_type select_adpcm_search()
+{
+#ifdef ADPCM_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2")) return adpcm_search_candidates_sse2;
+#endif
+  return adpcm_search_candidates_scalar;
+}
+
+static adpcm_search_func_type g_adpcm_search_candidates = select_adpcm_search();
+
+
+// One search path: error so far, last ADPCM_SEARCH_DEPTH nibbles (newest
+// lowest) & decoder state after them...
+struct adpcm_search_pathtype {
+  unsigned long long cost;
+  unsigned long long history;
+  adpcm_statetype state;
+};
+
+
+static inline void adpcm_search_put(unsigned char *destdata, int pos, int nibble)
+{
+  if (pos & 1) destdata[pos>>1] |= nibble; else destdata[pos>>1] = nibble<<4;
+}
+
+
+//
+// Encode sample_count samples (even) from state to sample_count/2 bytes
+// (high nibble first)...
+//
+static void adpcm_search_encode(const unsigned char *srcdata, int sample_count, int src_samplesize, adpcm_statetype state, unsigned char *destdata)
+{
+  adpcm_search_pathtype paths[ADPCM_SEARCH_PATHS], next[ADPCM_SEARCH_PATHS];
+  short values[16];
+  int errors[16];
+  paths[0].cost = 0;
+  paths[0].history = 0;
+  paths[0].state = state;
+  int path_count = 1;
+
+  for (int i=0; i<sample_count; i++) {
+    int target = adpcm_read_sample(&srcdata[i*src_samplesize], src_samplesize);
+
+    // Extend paths (best first, so the list fills with good candidates)...
+    int next_count = 0;
+    for (int p=0; p<path_count; p++) {
+      const adpcm_search_pathtype *path = &paths[p];
+      g_adpcm_search_candidates(&path->state, target, values, errors);
+      const unsigned char *next_index = g_adpcm_search_index[path->state.index];
+      for (int nibble=0; nibble<16; nibble++) {
+        unsigned long long cost = path->cost + errors[nibble];
+        if ((next_count==ADPCM_SEARCH_PATHS) && (cost>=next[next_count-1].cost)) continue;
+
+        // Merge with a path already in this state...
+        int pos = 0;
+        while ((pos<next_count) && ((next[pos].state.value!=values[nibble]) || (next[pos].state.index!=next_index[nibble]))) pos++;
+        if (pos<next_count) {
+          if (cost>=next[pos].cost) continue;
+          next_count--;
+          memmove (&next[pos], &next[pos+1], (next_count-pos)*sizeof(next[0]));
+        }
+        else if (next_count==ADPCM_SEARCH_PATHS) next_count--;
+
+        // Insert sorted by cost...
+        pos = next_count;
+        while ((pos>0) && (next[pos-1].cost>cost)) {next[pos] = next[pos-1]; pos--;}
+        next[pos].cost = cost;
+        next[pos].history = (path->history<<4) | nibble;
+        next[pos].state.value = values[nibble];
+        next[pos].state.index = next_index[nibble];
+        next_count++;
       }
+    }
+    memcpy (paths, next, next_count*sizeof(paths[0]));
+    path_count = next_count;
+
+    // Commit the best path's nibble for sample i-DEPTH+1 & drop paths that differ...
+    if (i>=ADPCM_SEARCH_DEPTH-1) {
+      int shift = 4*(ADPCM_SEARCH_DEPTH-1);
+      int nibble = (int)(paths[0].history>>shift) & 0xF;
+      adpcm_search_put(destdata, i-(ADPCM_SEARCH_DEPTH-1), nibble);
+      int kept = 1;
+      for (int p=1; p<path_count; p++)
+        if ((int)((paths[p].history>>shift) & 0xF)==nibble) paths[kept++] = paths[p];
+      path_count = kept;
+    }
+  }
+
+  // Flush the best path's uncommitted nibbles...
+  int first = (sample_count>ADPCM_SEARCH_DEPTH-1) ? sample_count-(ADPCM_SEARCH_DEPTH-1) : 0;
+  for (int i=first; i<sample_count; i++)
+    adpcm_search_put(destdata, i, (int)(paths[0].history>>(4*(sample_count-1-i))) & 0xF);
+}
+
 
-      case 2 :
-        *((short*)(&newbuf[newbuf_datalen])) = output_value;
-        newbuf_datalen += 2;
-        break;
 
-      case 4 :
-        *((int*)(&newbuf[newbuf_datalen])) = output_value<<16;
-        newbuf_datalen += 4;
-        break;
+// =========================================================================
+// Blocked ADPCM (USF adpcm==2).
+//
+// The clip is split into blocks of samples_per_block samples.  Each block
+// starts with a pleo_adpcm_blockhdrtype holding the predictor state it was
+// encoded from, so blocks are encoded independently (on all cores) and can
+// be decoded starting at any block.
+
+#define ADPCM_BLOCK_MIN_PARALLEL 64 // fewer blocks aren't worth starting threads
+
+static int adpcm_block_len(int samples_per_block)
+  {return sizeof(pleo_adpcm_blockhdrtype) + samples_per_block/2;}
+
+
+//
+// Starting step index for a block, from the average difference between its
+// first few samples (a reset to 0 takes several samples to ramp up)...
+//
+static int adpcm_block_start_index(const unsigned char *srcdata, int sample_count, int src_samplesize)
+{
+  int count = (sample_count<16) ? sample_count : 16;
+  int total = 0;
+  for (int i=1; i<count; i++) {
+    int diff = adpcm_read_sample(&srcdata[i*src_samplesize], src_samplesize) - adpcm_read_sample(&srcdata[(i-1)*src_samplesize], src_samplesize);
+    total += (diff<0) ? -diff : diff;
+  }
+  int average = (count>1) ? total/(count-1) : 0;
+
+  int index = 0;
+  while ((index<MAX_STEPSIZE) && (g_adpcm_stepsize_table[index] < average)) index++;
+  return index;
+}
+
+
+//
+// Encode block of sample_count samples (even) to header + sample_count/2 bytes...
+//
+static void adpcm_encode_block(const unsigned char *srcdata, int sample_count, int src_samplesize, unsigned char *destdata, bool search)
+{
+  adpcm_statetype state;
+  state.value = (sample_count>0) ? adpcm_read_sample(srcdata, src_samplesize) : 0;
+  state.index = adpcm_block_start_index(srcdata, sample_count, src_samplesize);
+
+  pleo_adpcm_blockhdrtype *hdr = (pleo_adpcm_blockhdrtype *)destdata;
+  hdr->predictor = (short)state.value;
+  hdr->step_index = (unsigned char)state.index;
+  hdr->reserved = 0;
+  destdata += sizeof(pleo_adpcm_blockhdrtype);
+
+  if (search) {
+    adpcm_search_encode(srcdata, sample_count, src_samplesize, state, destdata);
+    return;
+  }
+  for (int i=0; i+1<sample_count; i+=2) {
+    int high = adpcm_encode_sample(adpcm_read_sample(&srcdata[i*src_samplesize], src_samplesize), &state);
+    int low = adpcm_encode_sample(adpcm_read_sample(&srcdata[(i+1)*src_samplesize], src_samplesize), &state);
+    *(destdata++) = low | (high<<4);
+  }
+}
+
+
+// Blocked encoding job, shared by encoder threads...
+struct adpcm_block_jobtype {
+  const unsigned char *srcdata;
+  int sample_count;
+  int src_samplesize;
+  int samples_per_block;
+  int block_count;
+  unsigned char *destdata;
+  bool search;
+  int next_block; // claimed atomically
+};
+
+static void *adpcm_encode_worker(void *arg)
+{
+  adpcm_block_jobtype *job = (adpcm_block_jobtype *)arg;
+  int block;
+  while ((block = __sync_fetch_and_add(&job->next_block,1)) < job->block_count) {
+    int first = block*job->samples_per_block;
+    int count = job->sample_count-first;
+    if (count>job->samples_per_block) count = job->samples_per_block;
+    adpcm_encode_block(&job->srcdata[first*job->src_samplesize], count & ~1, job->src_samplesize,
+                       &job->destdata[block*adpcm_block_len(job->samples_per_block)], job->search);
+  }
+  return NULL;
+}
+
+
+
+//
+// Convert PCM input to blocked ADPCM.  An odd final sample is dropped, as
+// with pleo_sound_convert_pcm2adpcm...
+//
+int pleo_sound_type::pleo_sound_convert_pcm2adpcm_blocked(
+  unsigned char *srcdata, int srclen, int src_samplesize,
+  unsigned char **destdata, int *destlen,
+  int samples_per_block, int flags)
+{
+  if ((src_samplesize!=1) && (src_samplesize!=2) && (src_samplesize!=4)) return -1; // invalid sample size...
+  if ((samples_per_block<2) || (samples_per_block>PLEO_ADPCM_MAX_BLOCK_SAMPLES) || (samples_per_block & 1)) return -1;
+  if ((srcdata==NULL) || (srclen<0)) return -1;
+
+  adpcm_block_jobtype job;
+  job.srcdata = srcdata;
+  job.sample_count = (srclen/src_samplesize) & ~1;
+  job.src_samplesize = src_samplesize;
+  job.samples_per_block = samples_per_block;
+  job.search = (flags & SOUNDBASE_PLEO_ADPCM_SEARCH)!=0;
+  job.block_count = (job.sample_count+samples_per_block-1)/samples_per_block;
+  job.next_block = 0;
+
+  // Full blocks, plus shorter final block...
+  int last_count = job.sample_count - (job.block_count-1)*samples_per_block;
+  int newbuf_datalen = (job.block_count>0) ? (job.block_count-1)*adpcm_block_len(samples_per_block) + adpcm_block_len(last_count) : 0;
+  job.destdata = (unsigned char *)malloc(newbuf_datalen ? newbuf_datalen : 1);
+  if (job.destdata==NULL) return -1;
+
+  int thread_count = (job.block_count>=ADPCM_BLOCK_MIN_PARALLEL) ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+  if (thread_count>job.block_count) thread_count = job.block_count;
+  pthread_t threads[64];
+  if (thread_count>64) thread_count = 64;
+  int started = 0;
+  for (int i=1; i<thread_count; i++) // this thread is a worker too
+    if (pthread_create(&threads[started],NULL,adpcm_encode_worker,&job)==0) started++;
+  adpcm_encode_worker(&job);
+  for (int i=0; i<started; i++) pthread_join(threads[i],NULL);
+
+  // Return results...
+  if (destdata) *destdata = job.destdata; else free(job.destdata);
+  if (destlen) *destlen = newbuf_datalen;
+  return newbuf_datalen;
+}
+
+
+
+//
+// Convert blocked ADPCM to PCM, from start_sample for sample_count samples
+// (-1 = to end).  Only the blocks covering that range are decoded...
+//
+int pleo_sound_type::pleo_sound_convert_adpcm2pcm_blocked(
+  unsigned char *srcdata, int srclen, int samples_per_block,
+  int start_sample, int sample_count,
+  unsigned char **destdata, int *destlen, int dest_samplesize,
+  int /*flags*/)
+{
+  if ((dest_samplesize!=1) && (dest_samplesize!=2) && (dest_samplesize!=4)) return -1; // invalid sample size...
+  if ((samples_per_block<2) || (samples_per_block>PLEO_ADPCM_MAX_BLOCK_SAMPLES) || (samples_per_block & 1)) return -1;
+  if ((srcdata==NULL) || (srclen<0) || (start_sample<0)) return -1;
+
+  // Count samples held (final block may be short)...
+  int block_len = adpcm_block_len(samples_per_block);
+  int full_blocks = srclen/block_len;
+  int total_samples = full_blocks*samples_per_block;
+  int tail_len = srclen - full_blocks*block_len;
+  if (tail_len>(int)sizeof(pleo_adpcm_blockhdrtype)) total_samples += 2*(tail_len-sizeof(pleo_adpcm_blockhdrtype));
+
+  if (start_sample>total_samples) return -1;
+  if ((sample_count<0) || (sample_count>total_samples-start_sample)) sample_count = total_samples-start_sample;
+
+  int newbuf_datalen = sample_count*dest_samplesize;
+  unsigned char *newbuf = (unsigned char *)malloc(newbuf_datalen ? newbuf_datalen : 1);
+  short *block = (short *)malloc(sizeof(short)*samples_per_block);
+  if ((newbuf==NULL) || (block==NULL)) {
+    if (newbuf) free(newbuf);
+    if (block) free(block);
+    return -1;
+  }
+
+  int wrofs = 0;
+  for (int sample = start_sample; sample < start_sample+sample_count; ) {
+    int blockno = sample/samples_per_block;
+    unsigned char *blockdata = &srcdata[blockno*block_len];
+    int count = (blockno<full_blocks) ? samples_per_block : 2*(tail_len-sizeof(pleo_adpcm_blockhdrtype));
+
+    pleo_adpcm_blockhdrtype *hdr = (pleo_adpcm_blockhdrtype *)blockdata;
+    adpcm_statetype state;
+    state.value = hdr->predictor;
+    state.index = (hdr->step_index>MAX_STEPSIZE) ? MAX_STEPSIZE : hdr->step_index;
+    adpcm_decode_samples(&blockdata[sizeof(pleo_adpcm_blockhdrtype)], count/2, block, &state);
+
+    // Copy wanted part of block...
+    int skip = sample - blockno*samples_per_block;
+    int len = count-skip;
+    if (len > start_sample+sample_count-sample) len = start_sample+sample_count-sample;
+    switch (dest_samplesize) {
+      case 1 : g_adpcm_convert.narrow8(&block[skip], len, &newbuf[wrofs]); break;
+      case 2 : memcpy (&newbuf[wrofs], &block[skip], 2*len); break;
+      case 4 : g_adpcm_convert.widen32(&block[skip], len, &newbuf[wrofs]); break;
     }
+    wrofs += len*dest_samplesize;
+    sample += len;
   }
+  free (block);
 
   // Return results...
-  if (destdata) *destdata = newbuf;
+  if (destdata) *destdata = newbuf; else free(newbuf);
   if (destlen) *destlen = newbuf_datalen;
   return newbuf_datalen;
 }
 
 
 
+///////////////////////////////////////////////////////////////////////////////////
+//
+// ADPCM sub-clips.  A clip is cut from ADPCM data without decoding it: the
+// predictor is run forward to the start point (state only) & the nibbles
+// from there are copied as they are.  Blocked clips get the source state
+// in each block header.  Where the clip decoder can't simply be given the
+// source state (plain ADPCM always starts from zero; blocked sources reset
+// at block starts inside a clip block), the decoded source is re-encoded
+// from the clip decoder's state until a re-encoded path lands exactly on
+// the source state, after which copying resumes.  In a blocked clip this
+// is at most up to the end of the clip block, whose header takes the
+// source state again.
+
+#define ADPCM_CLIP_SEARCH 64 // samples searched per re-encode step
+#define ADPCM_CLIP_COMMIT 32 // of which committed (the rest is lookahead)
+#define ADPCM_CLIP_OFFSET 8  // value offsets from source tracked separately (either way)
+#define ADPCM_CLIP_BEAM 128  // paths costing more than the best by this (squared 8-bit error) are dropped
+
+// Position in source ADPCM data & decoder state before that sample...
+struct adpcm_clip_sourcetype {
+  const unsigned char *data;
+  int samples_per_block;   // 0 = plain ADPCM
+  int block_len;
+  int sample;
+  adpcm_statetype state;
+};
+
+
+static inline void adpcm_decode_step(adpcm_statetype *state, int nibble)
+{
+  const adpcm_decode_entrytype *entry = &g_adpcm_decode_table[state->index][nibble];
+  state->value += entry->diff;
+  if (state->value > 32767) state->value = 32767; else if (state->value < -32768) state->value = -32768;
+  state->index = entry->next_index;
+}
+
+
+//
+// Nibble pos of packed data (high nibble first)...
+//
+static inline int adpcm_get_nibble(const unsigned char *data, int pos)
+  {return (pos & 1) ? (data[pos>>1] & 0xF) : (data[pos>>1] >> 4);}
+
+static inline void adpcm_put_nibble(unsigned char *data, int pos, int nibble)
+{
+  if (pos & 1) data[pos>>1] = (data[pos>>1] & 0xF0) | nibble;
+  else data[pos>>1] = (data[pos>>1] & 0x0F) | (nibble<<4);
+}
+
+
+//
+// Source data for sample (blocked data skips block headers)...
+//
+static inline const unsigned char *adpcm_clip_blockdata(const adpcm_clip_sourcetype *src, int sample, int *pos)
+{
+  if (src->samples_per_block==0) {
+    *pos = sample;
+    return src->data;
+  }
+  int block = sample/src->samples_per_block;
+  *pos = sample - block*src->samples_per_block;
+  return &src->data[block*src->block_len + sizeof(pleo_adpcm_blockhdrtype)];
+}
+
+
+//
+// Run predictor state over count nibbles of packed data from pos...
+//
+static void adpcm_walk_state(const unsigned char *data, int pos, int count, adpcm_statetype *state)
+{
+  if ((pos & 1) && (count>0)) {
+    adpcm_decode_step(state, adpcm_get_nibble(data, pos++));
+    count--;
+  }
+  const unsigned char *srcdata = &data[pos>>1];
+  for (; count>=2; count-=2, srcdata++) {
+    adpcm_decode_step(state, *srcdata >> 4);
+    adpcm_decode_step(state, *srcdata & 0xF);
+  }
+  if (count) adpcm_decode_step(state, *srcdata >> 4);
+}
+
+
+//
+// Load block header state if source is at the start of a block...
+//
+static inline void adpcm_clip_reset(adpcm_clip_sourcetype *src)
+{
+  if ((src->samples_per_block==0) || (src->sample % src->samples_per_block)) return;
+  const pleo_adpcm_blockhdrtype *hdr = (const pleo_adpcm_blockhdrtype *)&src->data[(src->sample/src->samples_per_block)*src->block_len];
+  src->state.value = hdr->predictor;
+  src->state.index = (hdr->step_index>MAX_STEPSIZE) ? MAX_STEPSIZE : hdr->step_index;
+}
+
+
+//
+// Position source at sample, running the predictor forward (state only)
+// from the start of data, or of the block holding sample...
+//
+static void adpcm_clip_seek(adpcm_clip_sourcetype *src, int sample)
+{
+  src->state.value = 0;
+  src->state.index = 0;
+  src->sample = src->samples_per_block ? sample - sample%src->samples_per_block : 0;
+  adpcm_clip_reset(src);
+
+  int pos;
+  const unsigned char *data = adpcm_clip_blockdata(src, src->sample, &pos);
+  adpcm_walk_state(data, pos, sample-src->sample, &src->state);
+  src->sample = sample;
+}
+
+
+//
+// Re-encode search.  A Viterbi search by squared error against the decoded
+// source, keeping the best path into each decoder step index & value
+// offset from the source state (offsets beyond ADPCM_CLIP_OFFSET share one
+// slot per index).  Keeping the near offsets apart is what lets a path
+// land exactly on the source state: the best path into an index alone is
+// almost never the one that also matches the source value.
+//
+#define ADPCM_CLIP_SLOTS (2*ADPCM_CLIP_OFFSET+2)
+#define ADPCM_CLIP_STATES ((MAX_STEPSIZE+1)*ADPCM_CLIP_SLOTS)
+
+struct adpcm_clip_searchtype {
+  struct survivortype {
+    long long cost;  // <0 = no path
+    int value;
+  } paths[ADPCM_CLIP_STATES], next[ADPCM_CLIP_STATES];
+  unsigned short live[2][ADPCM_CLIP_STATES]; // states with a path
+  unsigned short from[ADPCM_CLIP_SEARCH][ADPCM_CLIP_STATES];
+  unsigned char via[ADPCM_CLIP_SEARCH][ADPCM_CLIP_STATES];
+};
+
+
+//
+// Re-encode count (<=ADPCM_CLIP_SEARCH) target samples from *state,
+// where source[i] is the source decoder state after target[i] (block
+// reset applied).  Stops at the first sample where the best path lands on
+// the source state, committing up to there; otherwise commits the first
+// commit samples of the best path.  Leaves *state after the committed
+// nibbles & returns their count...
+//
+static int adpcm_encode_clip_span(adpcm_clip_searchtype *search, const short *target, const adpcm_statetype *source, int count, int commit, adpcm_statetype *state, unsigned char *nibbles)
+{
+  adpcm_clip_searchtype::survivortype *paths = search->paths;
+  adpcm_clip_searchtype::survivortype *next = search->next;
+  unsigned short *live = search->live[0];
+  unsigned short *next_live = search->live[1];
+  for (int k=0; k<ADPCM_CLIP_STATES; k++) paths[k].cost = next[k].cost = -1;
+  live[0] = state->index*ADPCM_CLIP_SLOTS + ADPCM_CLIP_SLOTS-1;
+  paths[live[0]].cost = 0;
+  paths[live[0]].value = state->value;
+  int live_count = 1;
+
+  int end = count;
+  int best = -1;
+  long long mincost = 0;
+  for (int i=0; i<count; i++) {
+    long long prev_mincost = mincost;
+    int next_count = 0;
+    mincost = -1;
+    for (int l=0; l<live_count; l++) {
+      int k = live[l];
+      if (paths[k].cost>prev_mincost+ADPCM_CLIP_BEAM) continue;
+      int index = k/ADPCM_CLIP_SLOTS;
+      for (int nibble=0; nibble<16; nibble++) {
+        const adpcm_decode_entrytype *entry = &g_adpcm_decode_table[index][nibble];
+        int value = paths[k].value + entry->diff;
+        if (value > 32767) value = 32767; else if (value < -32768) value = -32768;
+        long long error = value-target[i];
+        long long cost = paths[k].cost + error*error;
+        if ((mincost<0) || (cost<mincost)) mincost = cost;
+
+        int offset = value-source[i].value;
+        int slot = ((offset<-ADPCM_CLIP_OFFSET) || (offset>ADPCM_CLIP_OFFSET)) ? ADPCM_CLIP_SLOTS-1 : offset+ADPCM_CLIP_OFFSET;
+        int dest = entry->next_index*ADPCM_CLIP_SLOTS + slot;
+        if (next[dest].cost<0) next_live[next_count++] = (unsigned short)dest;
+        else if (cost>=next[dest].cost) continue;
+        next[dest].cost = cost;
+        next[dest].value = value;
+        search->from[i][dest] = (unsigned short)k;
+        search->via[i][dest] = (unsigned char)nibble;
+      }
+    }
+    for (int l=0; l<live_count; l++) paths[live[l]].cost = -1;
+    adpcm_clip_searchtype::survivortype *swap = paths;
+    paths = next;
+    next = swap;
+    unsigned short *swap_live = live;
+    live = next_live;
+    next_live = swap_live;
+    live_count = next_count;
+
+    // Landed (& no other path is better so far)?
+    int landed = source[i].index*ADPCM_CLIP_SLOTS + ADPCM_CLIP_OFFSET;
+    if ((paths[landed].cost>=0) && (paths[landed].cost<=mincost)) {
+      best = landed;
+      end = commit = i+1;
+      break;
+    }
+  }
+  if (best<0)
+    for (int l=0; l<live_count; l++)
+      if ((best<0) || (paths[live[l]].cost<paths[best].cost)) best = live[l];
+
+  unsigned char path[ADPCM_CLIP_SEARCH];
+  for (int i=end-1; i>=0; i--) {
+    path[i] = search->via[i][best];
+    best = search->from[i][best];
+  }
+  for (int i=0; i<commit; i++) {
+    nibbles[i] = path[i];
+    adpcm_decode_step(state, path[i]);
+  }
+  return commit;
+}
+
+
+//
+// Copy count nibbles, a byte at a time where source & dest line up...
+//
+static void adpcm_copy_nibbles(unsigned char *destdata, int destpos, const unsigned char *srcdata, int srcpos, int count)
+{
+  if (((destpos ^ srcpos) & 1)==0) {
+    if ((srcpos & 1) && (count>0)) {
+      adpcm_put_nibble(destdata, destpos++, adpcm_get_nibble(srcdata, srcpos++));
+      count--;
+    }
+    memcpy (&destdata[destpos>>1], &srcdata[srcpos>>1], count>>1);
+    destpos += count & ~1;
+    srcpos += count & ~1;
+    count &= 1;
+  }
+  for (; count>0; count--) adpcm_put_nibble(destdata, destpos++, adpcm_get_nibble(srcdata, srcpos++));
+}
+
+
+
+//
+// Cut samples starttime..stoptime (stoptime<=starttime = to end) from a USF
+// image into a new USF image, in the same format (PCM, ADPCM or blocked
+// ADPCM).  ADPCM data is copied, & only re-encoded where the clip decoder
+// is out of step with the source (see above).  An odd ADPCM sample count
+// is rounded to even.  sound_name NULL keeps the source name.  Returns NULL on error (result code in *error if given)...
+//
+unsigned char *pleo_sound_type::extract_usf_clip_image (const char *sound_name, unsigned char *imagedata, int imagelen, int starttime, int stoptime, int *cliplen, int /*flags*/, int *error)
+{
+  if (error) *error = SOUNDBASE_ERROR_BADIMAGE;
+  int rdofs = sizeof(pleo_usf_sound_hdrtype);
+  if ((imagedata==NULL) || (imagelen<rdofs) || (strncmp((char*)imagedata,"UGSF",4)!=0)) return NULL;
+
+  char name[USF_NAME_MAXLEN];
+  memset (name, 0, sizeof(name));
+  switch (((pleo_usf_sound_hdrtype *)imagedata)->version) {
+    case 1 :
+      if (imagelen<rdofs+USF_NAME_MAXLEN) return NULL;
+      memcpy (name, &imagedata[rdofs], USF_NAME_MAXLEN);
+      rdofs += USF_NAME_MAXLEN;
+      break;
+    case 0 : break;
+    default : return NULL;
+  }
+  if (sound_name) {
+    int namelen = strlen(sound_name);
+    memset (name, 0, sizeof(name));
+    memcpy (name, sound_name, (namelen<USF_NAME_MAXLEN) ? namelen : USF_NAME_MAXLEN);
+  }
+
+  if (imagelen<rdofs+(int)sizeof(pleo_usf_sound_infotype)) return NULL;
+  pleo_usf_sound_infotype info;
+  memcpy (&info, &imagedata[rdofs], sizeof(info));
+  rdofs += sizeof(info);
+
+  // Source data & sample count...
+  adpcm_clip_sourcetype src;
+  src.samples_per_block = 0;
+  src.block_len = 0;
+  int frame_size = (info.num_channels*info.bits_per_sample)/8;
+  int total_samples = 0;
+  switch (info.adpcm) {
+    case 0 :
+      if (frame_size<1) return NULL;
+      total_samples = (imagelen-rdofs)/frame_size;
+      break;
+    case 1 :
+      total_samples = 2*(imagelen-rdofs);
+      break;
+    case 2 : {
+      if (imagelen<rdofs+(int)sizeof(pleo_usf_adpcm_blockinfotype)) return NULL;
+      pleo_usf_adpcm_blockinfotype blockinfo;
+      memcpy (&blockinfo, &imagedata[rdofs], sizeof(blockinfo));
+      rdofs += sizeof(blockinfo);
+      src.samples_per_block = blockinfo.samples_per_block;
+      if ((src.samples_per_block<2) || (src.samples_per_block>PLEO_ADPCM_MAX_BLOCK_SAMPLES) || (src.samples_per_block & 1)) return NULL;
+      src.block_len = adpcm_block_len(src.samples_per_block);
+      int full_blocks = (imagelen-rdofs)/src.block_len;
+      int tail_len = (imagelen-rdofs) - full_blocks*src.block_len;
+      total_samples = full_blocks*src.samples_per_block;
+      if (tail_len>(int)sizeof(pleo_adpcm_blockhdrtype)) total_samples += 2*(tail_len-sizeof(pleo_adpcm_blockhdrtype));
+      break;
+    }
+    default : return NULL;
+  }
+  if ((info.num_samples!=0xFFFFFFFF) && (info.num_samples<(unsigned int)total_samples)) total_samples = info.num_samples;
+  src.data = &imagedata[rdofs];
+
+  // Clip range...
+  if (starttime<0) starttime = 0;
+  if ((stoptime<=starttime) || (stoptime>total_samples)) stoptime = total_samples;
+  int count = stoptime-starttime;
+  if (info.adpcm && (count & 1)) {
+    if (stoptime<total_samples) count++; else count--;
+  }
+  if (count<=0) {
+    if (error) *error = SOUNDBASE_ERROR_TOOSMALL;
+    return NULL;
+  }
+
+  // Output image...
+  int hdrlen = sizeof(pleo_usf_sound_hdrtype)+USF_NAME_MAXLEN+sizeof(pleo_usf_sound_infotype);
+  int datalen;
+  int spb = src.samples_per_block;
+  switch (info.adpcm) {
+    case 0 : datalen = count*frame_size; break;
+    case 1 : datalen = count/2; break;
+    default :
+      hdrlen += sizeof(pleo_usf_adpcm_blockinfotype);
+      datalen = ((count-1)/spb)*src.block_len + adpcm_block_len(count-((count-1)/spb)*spb);
+      break;
+  }
+  unsigned char *clipdata = (unsigned char *)malloc(hdrlen+datalen);
+  if (clipdata==NULL) {
+    if (error) *error = SOUNDBASE_ERROR_TOOBIG;
+    return NULL;
+  }
+  memset (clipdata, 0, hdrlen+datalen);
+
+  pleo_usf_sound_hdrtype *hdr = (pleo_usf_sound_hdrtype *)clipdata;
+  memcpy (hdr->signature,"UGSF",4);
+  hdr->version = 1;
+  memcpy (&clipdata[sizeof(pleo_usf_sound_hdrtype)], name, USF_NAME_MAXLEN);
+  info.num_samples = 0xFFFFFFFF;
+  memcpy (&clipdata[sizeof(pleo_usf_sound_hdrtype)+USF_NAME_MAXLEN], &info, sizeof(info));
+  if (info.adpcm==2) {
+    pleo_usf_adpcm_blockinfotype blockinfo;
+    blockinfo.samples_per_block = (unsigned short)spb;
+    memcpy (&clipdata[hdrlen-sizeof(blockinfo)], &blockinfo, sizeof(blockinfo));
+  }
+  unsigned char *destdata = &clipdata[hdrlen];
+
+  // PCM, or blocked clip starting on a source block: straight copy...
+  if (info.adpcm==0) memcpy (destdata, &src.data[starttime*frame_size], datalen);
+  else if ((info.adpcm==2) && ((starttime % spb)==0)) memcpy (destdata, &src.data[(starttime/spb)*src.block_len], datalen);
+  else {
+    adpcm_clip_seek(&src, starttime);
+    adpcm_statetype state = {0, 0};
+    adpcm_clip_searchtype *search = NULL;
+    for (int i=0; i<count; ) {
+      int pos = i;
+      unsigned char *blockdata = destdata;
+      if (spb) {
+        int block = i/spb;
+        pos = i - block*spb;
+        blockdata = &destdata[block*src.block_len];
+        if (pos==0) {
+          // Clip block header takes the source state...
+          pleo_adpcm_blockhdrtype *blockhdr = (pleo_adpcm_blockhdrtype *)blockdata;
+          blockhdr->predictor = (short)src.state.value;
+          blockhdr->step_index = (unsigned char)src.state.index;
+          state = src.state;
+        }
+        blockdata += sizeof(pleo_adpcm_blockhdrtype);
+      }
+
+      if ((state.index==src.state.index) && (state.value==src.state.value)) {
+        // In step: copy up to the next source block (plain ADPCM has no
+        // resets, so the rest)...
+        int len = count-i;
+        if (spb) {
+          if (len>spb-pos) len = spb-pos;
+          if (len>spb-src.sample%spb) len = spb-src.sample%spb;
+        }
+        int srcpos;
+        const unsigned char *data = adpcm_clip_blockdata(&src, src.sample, &srcpos);
+        adpcm_copy_nibbles(blockdata, pos, data, srcpos, len);
+        i += len;
+        if (spb==0) break;
+
+        // Run predictor up to the source reset...
+        adpcm_walk_state(data, srcpos, len, &src.state);
+        state = src.state;
+        src.sample += len;
+        adpcm_clip_reset(&src);
+        continue;
+      }
+
+      // Out of step: re-encode the decoded source (within clip block),
+      // searching ahead of the samples committed unless the search
+      // reaches the end of the clip block...
+      if ((search==NULL) && ((search = (adpcm_clip_searchtype *)malloc(sizeof(adpcm_clip_searchtype)))==NULL)) {
+        free(clipdata);
+        if (error) *error = SOUNDBASE_ERROR_TOOBIG;
+        return NULL;
+      }
+      int len = count-i;
+      if (spb && (len>spb-pos)) len = spb-pos;
+      int commit = len;
+      if (len>ADPCM_CLIP_SEARCH) {
+        len = ADPCM_CLIP_SEARCH;
+        commit = ADPCM_CLIP_COMMIT;
+      }
+      short target[ADPCM_CLIP_SEARCH];
+      adpcm_statetype source[ADPCM_CLIP_SEARCH];
+      unsigned char nibbles[ADPCM_CLIP_SEARCH];
+      adpcm_clip_sourcetype ahead = src;
+      for (int j=0; j<len; j++) {
+        int srcpos;
+        const unsigned char *data = adpcm_clip_blockdata(&ahead, ahead.sample, &srcpos);
+        adpcm_decode_step(&ahead.state, adpcm_get_nibble(data, srcpos));
+        target[j] = (short)ahead.state.value;
+        ahead.sample++;
+        adpcm_clip_reset(&ahead);
+        source[j] = ahead.state;
+      }
+      commit = adpcm_encode_clip_span(search, target, source, len, commit, &state, nibbles);
+      for (int j=0; j<commit; j++) adpcm_put_nibble(blockdata, pos+j, nibbles[j]);
+      src.sample += commit;
+      src.state = source[commit-1];
+      i += commit;
+    }
+    free(search);
+  }
+
+  if (error) *error = SOUNDBASE_FILE_OK;
+  if (cliplen) *cliplen = hdrlen+datalen;
+  return clipdata;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////////
 //
 // Read PLEO USF format WAVE memory image.  If result negative, error occured.
@@ -266,7 +1215,19 @@ int pleo_sound_type::read_pleo_usf_wave_image (const char *msg, unsigned char *i
     return SOUNDBASE_ERROR_BADIMAGE;
 
   // Convert ADPCM to standard PCM...
-  if (usfinfo->adpcm) {
+  if (usfinfo->adpcm==2) {
+    if (pcm_wavedata_len<(int)sizeof(pleo_usf_adpcm_blockinfotype))
+      return SOUNDBASE_ERROR_BADIMAGE;
+    int samples_per_block = ((pleo_usf_adpcm_blockinfotype*)pcm_wavedata)->samples_per_block;
+    unsigned char *newbuf=NULL;
+    int newbuf_len=0;
+    if (pleo_sound_convert_adpcm2pcm_blocked (&pcm_wavedata[sizeof(pleo_usf_adpcm_blockinfotype)], pcm_wavedata_len-sizeof(pleo_usf_adpcm_blockinfotype), samples_per_block, 0, -1, &newbuf, &newbuf_len, 1)<0)
+      return SOUNDBASE_ERROR_INCOMPATIBLE;
+    pcm_wavedata = newbuf;
+    pcm_wavedata_len = newbuf_len;
+    pcm_wavedata_dynamic = true;
+  }
+  else if (usfinfo->adpcm) {
     unsigned char *newbuf=NULL;
     int newbuf_len=0;
     if (pleo_sound_convert_adpcm2pcm (pcm_wavedata, pcm_wavedata_len, &newbuf, &newbuf_len, 1)<0)
@@ -285,9 +1246,11 @@ int pleo_sound_type::read_pleo_usf_wave_image (const char *msg, unsigned char *i
   m_wave_format.bits_per_sample = usfinfo->bits_per_sample;
 
   // Allocate memory...
-  if (usfinfo->num_samples == 0xFFFFFFFF)
-    m_wave_datalen = pcm_wavedata_len;
-  else m_wave_datalen = ((usfinfo->num_samples)*(usfinfo->bits_per_sample))/8;
+  release_wave_data();
+  long long datalen = pcm_wavedata_len;
+  if (usfinfo->num_samples != 0xFFFFFFFF)
+    datalen = (((long long)usfinfo->num_samples)*(usfinfo->bits_per_sample))/8;
+  m_wave_datalen = (datalen < pcm_wavedata_len) ? (int)datalen : pcm_wavedata_len; // never past data held
   m_wave_maxdatalen = m_wave_datalen+32768; // allocate a little extra room for user editing
 
   m_wave_data = (unsigned char*)malloc(m_wave_maxdatalen);
@@ -297,7 +1260,7 @@ int pleo_sound_type::read_pleo_usf_wave_image (const char *msg, unsigned char *i
   }
 
   // Copy wave data...
-  memcpy (m_wave_data, pcm_wavedata, pcm_wavedata_len);
+  memcpy (m_wave_data, pcm_wavedata, m_wave_datalen);
 
   // If not single channel 8-bit 11Khz wave data, prompt user & then convert it...
   bool converted = false;
@@ -414,11 +1377,28 @@ unsigned char *pleo_sound_type::write_pleo_usf_wave_image (int *imagelen, int fl
     remaining_time -= remaining_time;
   }
 
+  // Convert to blocked ADPCM (block info ahead of data)...
+  if ((flags & (SOUNDBASE_PLEO_FORCE_PCM|SOUNDBASE_PLEO_ADPCM_BLOCKED))==SOUNDBASE_PLEO_ADPCM_BLOCKED) {
+    unsigned char *adpcm_imagedata=NULL;
+    int adpcm_imagelen = 0;
+    if (pleo_sound_convert_pcm2adpcm_blocked(&imagedata[data_wrofs], wrofs-data_wrofs, m_wave_format.bits_per_sample/8, &adpcm_imagedata, &adpcm_imagelen, PLEO_ADPCM_BLOCK_SAMPLES, flags)>0) {
+      if ((adpcm_imagelen+(int)sizeof(pleo_usf_adpcm_blockinfotype))<(wrofs-data_wrofs)) {
+        pleo_usf_adpcm_blockinfotype blockinfo;
+        blockinfo.samples_per_block = PLEO_ADPCM_BLOCK_SAMPLES;
+        memcpy (&imagedata[data_wrofs], &blockinfo, sizeof(blockinfo));
+        memcpy (&imagedata[data_wrofs+sizeof(blockinfo)], adpcm_imagedata, adpcm_imagelen);
+        wrofs = data_wrofs + sizeof(blockinfo) + adpcm_imagelen;
+        info->adpcm = 2;
+      }
+      free (adpcm_imagedata);
+    }
+  }
+
   // Convert to ADPCM...
-  if ((flags & SOUNDBASE_PLEO_FORCE_PCM)==0) {
+  else if ((flags & SOUNDBASE_PLEO_FORCE_PCM)==0) {
     unsigned char *adpcm_imagedata=NULL;
     int adpcm_imagelen = 0;
-    if (pleo_sound_convert_pcm2adpcm(&imagedata[data_wrofs], wrofs-data_wrofs, m_wave_format.bits_per_sample/8, &adpcm_imagedata, &adpcm_imagelen)>0) {
+    if (pleo_sound_convert_pcm2adpcm(&imagedata[data_wrofs], wrofs-data_wrofs, m_wave_format.bits_per_sample/8, &adpcm_imagedata, &adpcm_imagelen, flags)>0) {
       if (adpcm_imagelen<(wrofs-data_wrofs)) {
         memcpy (&imagedata[data_wrofs], adpcm_imagedata, adpcm_imagelen);
         wrofs = data_wrofs + adpcm_imagelen;
@@ -434,6 +1414,309 @@ unsigned char *pleo_sound_type::write_pleo_usf_wave_image (int *imagelen, int fl
 
 
 
+///////////////////////////////////////////////////////////////////////////////////
+//
+// Convert WAVE memory image straight to PLEO USF image.  Source data is
+// streamed through sound_convert_type & the ADPCM encoder a chunk at a
+// time, so nothing but the USF image is allocated.  Blocked & search ADPCM
+// (SOUNDBASE_PLEO_ADPCM_BLOCKED/SEARCH) encode the converted 8-bit PCM once
+// it is all in the image, kept as PCM if no smaller (as
+// write_pleo_usf_wave_image).  Returns NULL on error (result code in *error
+// if given)...
+//
+unsigned char *pleo_sound_type::convert_wave_image_to_usf (const char *sound_name, unsigned char *imagedata, int imagelen, int *usflen, int flags, int *error)
+{
+  wave_format_type format;
+  unsigned char *wavedata;
+  int wavedatalen;
+  int result = find_wave_chunks(imagedata, imagelen, &format, &wavedata, &wavedatalen);
+  sound_convert_type converter(format);
+  if ((result>0) && !converter.is_valid()) result = SOUNDBASE_ERROR_INCOMPATIBLE;
+  if (error) *error = result;
+  if (result<=0) return NULL;
+
+  // Allocate USF image & conversion chunk...
+  int hdrlen = sizeof(pleo_usf_sound_hdrtype)+USF_NAME_MAXLEN+sizeof(pleo_usf_sound_infotype);
+  int maxlen = converter.get_output_maxlen(wavedatalen);
+  int chunklen = SOUND_CONVERT_CHUNK*converter.get_frame_size();
+  unsigned char *usfdata = (unsigned char *)malloc(hdrlen+maxlen);
+  short *chunkbuf = (short *)malloc(sizeof(short)*converter.get_output_maxlen(chunklen));
+  if ((usfdata==NULL) || (chunkbuf==NULL)) {
+    if (usfdata) free(usfdata);
+    if (chunkbuf) free(chunkbuf);
+    if (error) *error = SOUNDBASE_ERROR_TOOBIG;
+    return NULL;
+  }
+
+  // Header & name...
+  memset (usfdata, 0, hdrlen);
+  pleo_usf_sound_hdrtype *hdr = (pleo_usf_sound_hdrtype*)usfdata;
+  memcpy (hdr->signature,"UGSF",4);
+  hdr->version = 1; // 32 byte name field immediately after header
+  if (sound_name) strncpy ((char*)&usfdata[sizeof(pleo_usf_sound_hdrtype)], sound_name, USF_NAME_MAXLEN);
+
+  pleo_usf_sound_infotype *info = (pleo_usf_sound_infotype*)(&usfdata[sizeof(pleo_usf_sound_hdrtype)+USF_NAME_MAXLEN]);
+  bool stream_adpcm = ((flags & (SOUNDBASE_PLEO_FORCE_PCM|SOUNDBASE_PLEO_ADPCM_BLOCKED|SOUNDBASE_PLEO_ADPCM_SEARCH))==0);
+  info->adpcm = stream_adpcm;
+  info->bits_per_sample = 8;
+  info->loop_count = 1;
+  info->num_channels = 1;
+  info->num_samples = 0xFFFFFFFF;
+  info->samples_per_sec = PLEO_WAVE_SAMPLERATE;
+
+  // Convert & encode (first sample of each pair in high nibble)...
+  int wrofs = hdrlen;
+  adpcm_statetype state = {0, 0};
+  int pending_delta = -1;
+  for (int ofs=0; ofs<wavedatalen+chunklen; ofs+=chunklen) {
+    int count;
+    if (ofs<wavedatalen) {
+      int len = (wavedatalen-ofs < chunklen) ? wavedatalen-ofs : chunklen;
+      count = converter.convert(&wavedata[ofs], len, chunkbuf);
+    }
+    else count = converter.flush(chunkbuf); // resampler tail
+    if (stream_adpcm) {
+      for (int i=0; i<count; i++) {
+        int delta = adpcm_encode_sample(chunkbuf[i], &state);
+        if (pending_delta<0) pending_delta = delta;
+        else {
+          usfdata[wrofs++] = delta | (pending_delta<<4);
+          pending_delta = -1;
+        }
+      }
+    }
+    else for (int i=0; i<count; i++) usfdata[wrofs++] = (unsigned char)(chunkbuf[i]+128);
+  }
+  free (chunkbuf);
+
+  // Encode PCM to blocked ADPCM (block info ahead of data) or with the search encoder...
+  if (!stream_adpcm && ((flags & SOUNDBASE_PLEO_FORCE_PCM)==0)) {
+    bool blocked = (flags & SOUNDBASE_PLEO_ADPCM_BLOCKED)!=0;
+    int pcmlen = wrofs-hdrlen;
+    unsigned char *adpcm_data = NULL;
+    int adpcm_len = 0;
+    int encoded = blocked ? pleo_sound_convert_pcm2adpcm_blocked(&usfdata[hdrlen], pcmlen, 1, &adpcm_data, &adpcm_len, PLEO_ADPCM_BLOCK_SAMPLES, flags)
+                          : pleo_sound_convert_pcm2adpcm(&usfdata[hdrlen], pcmlen, 1, &adpcm_data, &adpcm_len, flags);
+    if (encoded<0) {
+      free (usfdata);
+      if (error) *error = SOUNDBASE_ERROR_TOOBIG;
+      return NULL;
+    }
+    int infolen = blocked ? sizeof(pleo_usf_adpcm_blockinfotype) : 0;
+    if ((encoded>0) && (infolen+adpcm_len < pcmlen)) {
+      if (blocked) {
+        pleo_usf_adpcm_blockinfotype blockinfo;
+        blockinfo.samples_per_block = PLEO_ADPCM_BLOCK_SAMPLES;
+        memcpy (&usfdata[hdrlen], &blockinfo, sizeof(blockinfo));
+      }
+      memcpy (&usfdata[hdrlen+infolen], adpcm_data, adpcm_len);
+      wrofs = hdrlen+infolen+adpcm_len;
+      info->adpcm = blocked ? 2 : 1;
+    }
+    free (adpcm_data);
+  }
+
+  if (usflen) *usflen = wrofs;
+  return usfdata;
+}
+
+
+
+// =========================================================================
+// Silence trimming & level normalisation.
+//
+// Wave data (8-bit mono) is analysed in windows of PLEO_SILENCE_WINDOW
+// samples.  One pass (SSE2 where available) gives each window's sum of
+// squares & peak; the audible span (first to last window with RMS above
+// the silence level), its RMS & its peak all follow from those.
+
+struct wave_windowtype {
+  int energy;  // sum of (sample-128)^2
+  int peak;    // max |sample-128|
+};
+
+static void wave_windows_scalar(const unsigned char *srcdata, int count, wave_windowtype *windows)
+{
+  for (int w=0; count>0; w++) {
+    int len = (count<PLEO_SILENCE_WINDOW) ? count : PLEO_SILENCE_WINDOW;
+    int energy=0, peak=0;
+    for (int i=0; i<len; i++) {
+      int value = abs(srcdata[i]-128);
+      energy += value*value;
+      if (value>peak) peak = value;
+    }
+    windows[w].energy = energy;
+    windows[w].peak = peak;
+    srcdata += len;
+    count -= len;
+  }
+}
+
+
+#ifdef ADPCM_SIMD
+__attribute__((target("sse2")))
+static void wave_windows_sse2(const unsigned char *srcdata, int count, wave_windowtype *windows)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i bias = _mm_set1_epi16(128);
+  int w = 0;
+  for (; count>=PLEO_SILENCE_WINDOW; w++, srcdata+=PLEO_SILENCE_WINDOW, count-=PLEO_SILENCE_WINDOW) {
+    __m128i energy = zero, peak = zero;
+    for (int i=0; i<PLEO_SILENCE_WINDOW; i+=16) {
+      __m128i v = _mm_loadu_si128((const __m128i *)&srcdata[i]);
+      __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(v, zero), bias);
+      __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(v, zero), bias);
+      energy = _mm_add_epi32(energy, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+      lo = _mm_max_epi16(lo, _mm_sub_epi16(zero, lo));
+      hi = _mm_max_epi16(hi, _mm_sub_epi16(zero, hi));
+      peak = _mm_max_epi16(peak, _mm_max_epi16(lo, hi));
+    }
+    energy = _mm_add_epi32(energy, _mm_shuffle_epi32(energy, 0x4E));
+    energy = _mm_add_epi32(energy, _mm_shuffle_epi32(energy, 0xB1));
+    peak = _mm_max_epi16(peak, _mm_shuffle_epi32(peak, 0x4E));
+    peak = _mm_max_epi16(peak, _mm_shuffle_epi32(peak, 0xB1));
+    peak = _mm_max_epi16(peak, _mm_shufflelo_epi16(peak, 0xB1));
+    windows[w].energy = _mm_cvtsi128_si32(energy);
+    windows[w].peak = _mm_extract_epi16(peak, 0);
+  }
+  wave_windows_scalar(srcdata, count, &windows[w]);
+}
+#endif
+
+
+typedef void (*wave_windows_functype)(const unsigned char *srcdata, int count, wave_windowtype *windows);
+
+static wave_windows_functype select_wave_windows()
+{
+#ifdef ADPCM_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2")) return wave_windows_sse2;
+#endif
+  return wave_windows_scalar;
+}
+
+static wave_windows_functype g_wave_windows = select_wave_windows();
+
+
+//
+// Find audible span of wave data (windows with RMS above silence_rms, plus
+// PLEO_SILENCE_MARGIN windows either side) & its level...
+//
+bool pleo_sound_type::analyse_wave_level (pleo_sound_leveltype *level, int silence_rms)
+{
+  memset (level, 0, sizeof(pleo_sound_leveltype));
+  if ((m_wave_data==NULL) || (m_wave_format.channels!=1) || (m_wave_format.bits_per_sample!=8)) return false;
+  if (m_wave_datalen<=0) return true;
+
+  int window_count = (m_wave_datalen+PLEO_SILENCE_WINDOW-1)/PLEO_SILENCE_WINDOW;
+  wave_windowtype *windows = (wave_windowtype *)malloc(sizeof(wave_windowtype)*window_count);
+  if (windows==NULL) return false;
+  g_wave_windows(m_wave_data, m_wave_datalen, windows);
+
+  // Window is audible if energy > silence_rms^2 * window length...
+  int first, last;
+  for (first=0; first<window_count; first++) {
+    int len = (first<window_count-1) ? PLEO_SILENCE_WINDOW : m_wave_datalen-first*PLEO_SILENCE_WINDOW;
+    if (windows[first].energy > silence_rms*silence_rms*len) break;
+  }
+  for (last=window_count-1; last>first; last--) {
+    int len = (last<window_count-1) ? PLEO_SILENCE_WINDOW : m_wave_datalen-last*PLEO_SILENCE_WINDOW;
+    if (windows[last].energy > silence_rms*silence_rms*len) break;
+  }
+
+  if (first<window_count) {
+    first = (first>PLEO_SILENCE_MARGIN) ? first-PLEO_SILENCE_MARGIN : 0;
+    last = (last+PLEO_SILENCE_MARGIN<window_count) ? last+PLEO_SILENCE_MARGIN : window_count-1;
+    long long energy = 0;
+    for (int w=first; w<=last; w++) {
+      energy += windows[w].energy;
+      if (windows[w].peak>level->peak) level->peak = windows[w].peak;
+    }
+    level->start = first*PLEO_SILENCE_WINDOW;
+    level->stop = ((last+1)*PLEO_SILENCE_WINDOW<m_wave_datalen) ? (last+1)*PLEO_SILENCE_WINDOW : m_wave_datalen;
+    level->rms = sqrt((double)energy/(level->stop-level->start));
+  }
+  free (windows);
+  return true;
+}
+
+
+//
+// Cut silence from both ends of wave data.  Returns samples removed (-1 on
+// error)...
+//
+int pleo_sound_type::trim_wave_silence (int silence_rms)
+{
+  pleo_sound_leveltype level;
+  if (!analyse_wave_level(&level, silence_rms) || !detach_wave()) return -1;
+  if (level.stop<=level.start) return 0; // all silent; keep as is
+
+  int removed = m_wave_datalen-(level.stop-level.start);
+  if (level.start>0) memmove (m_wave_data, &m_wave_data[level.start], level.stop-level.start);
+  m_wave_datalen = level.stop-level.start;
+  return removed;
+}
+
+
+//
+// Scale wave data so its peak (PLEO_LEVEL_PEAK) or RMS (PLEO_LEVEL_RMS)
+// within the audible span is level_db dBFS.  Gain is held down so the
+// peak never clips...
+//
+bool pleo_sound_type::normalise_wave_level (int mode, double level_db)
+{
+  pleo_sound_leveltype level;
+  if (!analyse_wave_level(&level) || !detach_wave()) return false;
+  if (level.peak==0) return true; // silent
+
+  double target = 128.0*pow(10.0, level_db/20.0);
+  double gain = (mode==PLEO_LEVEL_RMS) ? target/level.rms : target/level.peak;
+  if (gain*level.peak > 127.0) gain = 127.0/level.peak;
+
+  unsigned char table[256];
+  for (int i=0; i<256; i++) {
+    int value = 128 + (int)floor((i-128)*gain+0.5);
+    table[i] = (value<0) ? 0 : (value>255) ? 255 : value;
+  }
+  for (int i=0; i<m_wave_datalen; i++) m_wave_data[i] = table[m_wave_data[i]];
+  return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////////
+//
+// Estimate bytes a USF image would save if re-encoded as ADPCM (PCM images
+// only) & if leading/trailing silence were trimmed, for archive budget
+// reports.  Leaves the sound read into this object...
+//
+bool pleo_sound_type::estimate_usf_savings (unsigned char *imagedata, int imagelen, int *adpcm_savings, int *silence_savings)
+{
+  *adpcm_savings = 0;
+  *silence_savings = 0;
+  int result = read_pleo_usf_wave_image("", imagedata, imagelen);
+  if ((result!=SOUNDBASE_FILE_OK) && (result!=SOUNDBASE_FILE_CONVERTED)) return false;
+
+  int rdofs = sizeof(pleo_usf_sound_hdrtype);
+  if (((pleo_usf_sound_hdrtype *)imagedata)->version==1) rdofs += USF_NAME_MAXLEN;
+  pleo_usf_sound_infotype *usfinfo = (pleo_usf_sound_infotype *)&imagedata[rdofs];
+  rdofs += sizeof(pleo_usf_sound_infotype);
+  int datalen = imagelen-rdofs;
+  if ((datalen<=0) || (m_wave_datalen<=0)) return true;
+
+  // PCM is stored as ADPCM at half a byte per (converted) sample...
+  if ((usfinfo->adpcm==0) && (datalen > (m_wave_datalen+1)/2))
+    *adpcm_savings = datalen - (m_wave_datalen+1)/2;
+
+  // Silence trim_wave_silence would cut, as a share of stored data...
+  pleo_sound_leveltype level;
+  if (analyse_wave_level(&level))
+    *silence_savings = (int)(((long long)datalen*(m_wave_datalen-(level.stop-level.start)))/m_wave_datalen);
+  return true;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////////
 //
 // Write PLEO USF format sound file.  Return NULL if error occurs...
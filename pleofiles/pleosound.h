@@ -28,6 +28,18 @@
 #define USF_NAME_MAXLEN 32 // name field is 32 bytes (if present)
 #define SOUNDBASE_PLEO_USF_FORMAT 0x00000100
 #define SOUNDBASE_PLEO_FORCE_PCM  0x00000200
+#define SOUNDBASE_PLEO_ADPCM_BLOCKED 0x00000400 // seekable blocked ADPCM (adpcm==2)
+#define SOUNDBASE_PLEO_ADPCM_SEARCH  0x00000800 // lookahead search encoder (slower, lower error, same format)
+
+#define PLEO_ADPCM_BLOCK_SAMPLES 2048 // default samples per block (blocked ADPCM)
+#define PLEO_ADPCM_MAX_BLOCK_SAMPLES 0xFFFE
+
+// Silence detection & level normalisation (analyse_wave_level)...
+#define PLEO_SILENCE_WINDOW 128 // samples per RMS window (multiple of 16, ~12ms)
+#define PLEO_SILENCE_RMS 2      // window RMS (8-bit steps) at or below which is silence (~-36dBFS)
+#define PLEO_SILENCE_MARGIN 1   // windows of silence kept either side of audible span
+#define PLEO_LEVEL_PEAK 0       // normalise_wave_level modes
+#define PLEO_LEVEL_RMS 1
 
 
 #pragma pack (push,1)
@@ -50,10 +62,34 @@
     unsigned short int loop_count;
     unsigned int num_samples; // 0xFFFFFFFF = entire file
   };
+
+  // Follows info block when adpcm==2...
+  struct pleo_usf_adpcm_blockinfotype {
+    unsigned short samples_per_block; // even
+  };
+
+  // Starts each block of blocked ADPCM data (samples_per_block/2 bytes follow)...
+  struct pleo_adpcm_blockhdrtype {
+    short predictor;
+    unsigned char step_index;
+    unsigned char reserved;
+  };
 #pragma pack (pop)
 
 
 
+//
+// Level analysis of wave data...
+//
+struct pleo_sound_leveltype {
+  int start;    // audible span (samples start..stop-1), empty if all silent
+  int stop;
+  int peak;     // peak |sample-128| within span (128 = full scale)
+  double rms;   // RMS within span (8-bit steps)
+};
+
+
+
 class pleo_sound_type : public sound_base_type
 {
 public:
@@ -72,9 +108,26 @@ public:
     unsigned char **destdata, int *destlen, int dest_samplesize,
     int flags=0);
 
+  int pleo_sound_convert_pcm2adpcm_blocked(
+    unsigned char *srcdata, int srclen, int src_samplesize,
+    unsigned char **destdata, int *destlen,
+    int samples_per_block=PLEO_ADPCM_BLOCK_SAMPLES, int flags=0);
+
+  int pleo_sound_convert_adpcm2pcm_blocked(
+    unsigned char *srcdata, int srclen, int samples_per_block,
+    int start_sample, int sample_count,
+    unsigned char **destdata, int *destlen, int dest_samplesize,
+    int flags=0);
+
   virtual int read_pleo_usf_wave_image (const char *msg, unsigned char *imagedata, int imagelen, int flags=0);
   virtual unsigned char *write_pleo_usf_wave_image (int *imagelen, int flags=0, int starttime=-1, int stoptime=-1);
   virtual bool write_pleo_usf_wave_file (const char *targetfile, int flags=0);
+  unsigned char *convert_wave_image_to_usf (const char *sound_name, unsigned char *imagedata, int imagelen, int *usflen, int flags=0, int *error=NULL);
+  unsigned char *extract_usf_clip_image (const char *sound_name, unsigned char *imagedata, int imagelen, int starttime, int stoptime, int *cliplen, int flags=0, int *error=NULL);
+  bool analyse_wave_level (pleo_sound_leveltype *level, int silence_rms=PLEO_SILENCE_RMS);
+  int trim_wave_silence (int silence_rms=PLEO_SILENCE_RMS);
+  bool normalise_wave_level (int mode, double level_db);
+  bool estimate_usf_savings (unsigned char *imagedata, int imagelen, int *adpcm_savings, int *silence_savings);
 
   // Overrides...
   virtual int read_wave_image (const char *msg, unsigned char *imagedata, int imagelen, int flags=SOUNDBASE_FLAG_NONE);
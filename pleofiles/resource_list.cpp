@@ -22,6 +22,10 @@
  */
 #include <stdlib.h>
 #include <stdio.h>
+#ifndef _WIN32
+#include <errno.h>
+#include <unistd.h>
+#endif
 #include "resource_list.h"
 
 
@@ -31,6 +35,10 @@
 pleo_resource_type::pleo_resource_type()
 {
   m_resource_list = NULL;
+  m_name_hash = NULL;
+  m_content_hash = NULL;
+  m_pool = NULL;
+  m_lazy_fd = -1;
   init_resource();
 }
 
@@ -44,6 +52,25 @@ void pleo_resource_type::init_resource()
   m_resource_list = NULL;
   m_max_count = 0;
   m_count = 0;
+
+  if (m_name_hash) free (m_name_hash);
+  m_name_hash = NULL;
+  m_name_hash_size = 0;
+  m_name_hash_dirty = false;
+
+  if (m_content_hash) free (m_content_hash);
+  m_content_hash = NULL;
+  m_content_hash_size = 0;
+  m_content_hash_dirty = false;
+  m_lazy_fd = -1;
+
+  // Pooled element data goes in one go...
+  while (m_pool) {
+    resource_pool_blocktype *next = m_pool->m_next;
+    free (m_pool);
+    m_pool = next;
+  }
+  m_pool_stale = 0;
 }
 
 
@@ -59,31 +86,138 @@ pleo_resource_type::~pleo_resource_type()
 void pleo_resource_type::free_element(int index)
 {
   if (m_resource_list[index].m_element) {
-    free (m_resource_list[index].m_element); 
+    if ((m_resource_list[index].m_element_flags & (RESOURCE_ELEMENT_BORROWED|RESOURCE_ELEMENT_POOLED))==0)
+      free (m_resource_list[index].m_element); 
+    else if (m_resource_list[index].m_element_flags & RESOURCE_ELEMENT_POOLED)
+      m_pool_stale += (m_resource_list[index].m_element_size+7) & ~7; // until compact_pool
     m_resource_list[index].m_element=NULL;
   }
+  m_resource_list[index].m_element_flags = RESOURCE_ELEMENT_OWNED;
 }
 
 
-bool pleo_resource_type::set_element_count(int new_count)
+
+//
+// Make room for count elements, and datalen bytes of pooled element data,
+// without further allocation (e.g. when entry count known from TOC)...
+//
+bool pleo_resource_type::reserve_elements(int count, int datalen)
 {
-  if (new_count>=m_max_count) {
-    int new_max_count = new_count+64;
-    resource_type *new_resource_list = (resource_type*)malloc(sizeof(resource_type)*new_max_count);
+  if (count>m_max_count) {
+    resource_type *new_resource_list = (resource_type*)realloc(m_resource_list, sizeof(resource_type)*count);
     if (new_resource_list == NULL) return false;
-    memset (new_resource_list, 0, sizeof(resource_type)*new_max_count);
-    if (m_resource_list != NULL) {
-      memcpy (new_resource_list, m_resource_list, sizeof(resource_type)*m_count);
-      free (m_resource_list);
-    }
+    memset (&new_resource_list[m_max_count], 0, sizeof(resource_type)*(count-m_max_count));
     m_resource_list = new_resource_list;
-    m_max_count = new_max_count;
+    m_max_count = count;
+  }
+
+  // Pool needs a fresh block big enough for all of it (allowing for alignment)?
+  if (datalen>0) {
+    datalen += 8*count;
+    if ((m_pool==NULL) || ((m_pool->m_size - m_pool->m_used) < datalen)) {
+      resource_pool_blocktype *block = (resource_pool_blocktype*)malloc(sizeof(resource_pool_blocktype)+datalen);
+      if (block == NULL) return false;
+      block->m_size = datalen;
+      block->m_used = 0;
+      block->m_next = m_pool;
+      m_pool = block;
+    }
+  }
+  return true;
+}
+
+
+bool pleo_resource_type::set_element_count(int new_count)
+{
+  if (new_count>m_max_count) {
+    int new_max_count = (m_max_count<32) ? 64 : 2*m_max_count; // grow geometrically
+    if (new_max_count<new_count) new_max_count = new_count;
+    if (!reserve_elements(new_max_count)) return false;
   }
   m_count = new_count;
   return true;
 }
 
 
+
+//
+// Allocate element data from pool (8 byte aligned).  Large elements get a
+// block of their own behind the current one, so its free space isn't lost...
+//
+unsigned char *pleo_resource_type::pool_alloc(int datalen)
+{
+  if (datalen<1) return NULL;
+  int alloclen = (datalen+7) & ~7;
+
+  if ((m_pool==NULL) || ((m_pool->m_size - m_pool->m_used) < alloclen)) {
+    bool dedicated = (alloclen > RESOURCE_POOL_BLOCKSIZE/4);
+    int blocksize = dedicated ? alloclen : RESOURCE_POOL_BLOCKSIZE;
+    resource_pool_blocktype *block = (resource_pool_blocktype*)malloc(sizeof(resource_pool_blocktype)+blocksize);
+    if (block == NULL) return NULL;
+    block->m_size = blocksize;
+    block->m_used = 0;
+    if (dedicated && m_pool) {
+      block->m_next = m_pool->m_next;
+      m_pool->m_next = block;
+    }
+    else {
+      block->m_next = m_pool;
+      m_pool = block;
+    }
+    block->m_used = alloclen;
+    return (unsigned char *)(block+1);
+  }
+
+  unsigned char *dataptr = (unsigned char *)(m_pool+1) + m_pool->m_used;
+  m_pool->m_used += alloclen;
+  return dataptr;
+}
+
+
+//
+// Move pooled element data into one block sized to fit, dropping the space
+// replaced & removed elements left behind (the pool only grows otherwise).
+// Pointers to pooled data (get_element_dataptr) are invalid afterwards &
+// all of it is briefly held twice, so this is only done when asked...
+//
+bool pleo_resource_type::compact_pool()
+{
+  if (m_pool_stale==0) return true;
+
+  int i;
+  int datalen = 0;
+  for (i=0; i<m_count; i++)
+    if (m_resource_list[i].m_element && (m_resource_list[i].m_element_flags & RESOURCE_ELEMENT_POOLED))
+      datalen += (m_resource_list[i].m_element_size+7) & ~7;
+
+  resource_pool_blocktype *block = NULL;
+  if (datalen>0) {
+    block = (resource_pool_blocktype*)malloc(sizeof(resource_pool_blocktype)+datalen);
+    if (block == NULL) return false;
+    block->m_size = datalen;
+    block->m_used = 0;
+    block->m_next = NULL;
+    for (i=0; i<m_count; i++) {
+      resource_type *target = &m_resource_list[i];
+      if ((target->m_element==NULL) || ((target->m_element_flags & RESOURCE_ELEMENT_POOLED)==0)) continue;
+      unsigned char *dataptr = (unsigned char *)(block+1) + block->m_used;
+      memcpy (dataptr, target->m_element, target->m_element_size);
+      target->m_element = dataptr;
+      block->m_used += (target->m_element_size+7) & ~7;
+    }
+  }
+
+  while (m_pool) {
+    resource_pool_blocktype *next = m_pool->m_next;
+    free (m_pool);
+    m_pool = next;
+  }
+  m_pool = block;
+  m_pool_stale = 0;
+  return true;
+}
+
+
 //
 // Add element to resource list...
 //
@@ -95,6 +229,7 @@ int pleo_resource_type::add_new_element(const char *element_name, unsigned char
   int index = m_count;
   if (!set_element_count(m_count+1)) return -1;
   m_resource_list[index].m_element = NULL;
+  m_resource_list[index].m_element_name[0] = 0; // not yet hashed
 
   return update_element(element_name, index, element_data, element_datalen, assume_ownership);
 }
@@ -105,6 +240,42 @@ int pleo_resource_type::add_new_element(const char *element_name, resource_type
 
 
 
+//
+// Add element referencing data in place (caller keeps image alive).  The
+// data is only copied if the element is later replaced by update_element...
+//
+int pleo_resource_type::add_borrowed_element(const char *element_name, unsigned char *element_data, int element_datalen)
+{
+  int index = add_new_element(element_name, element_data, element_datalen, true);
+  if (index<0) return -1;
+  m_resource_list[index].m_element_flags = RESOURCE_ELEMENT_BORROWED;
+  return index;
+}
+
+
+
+//
+// Add element whose data is left in the archive file (m_lazy_fd) until
+// load_element.  Only name & size are known until then...
+//
+int pleo_resource_type::add_lazy_element(const char *element_name, unsigned int file_offset, int element_datalen)
+{
+  if (element_datalen<MIN_ELEMENT_DATALEN) return -1;
+
+  int index = m_count;
+  if (!set_element_count(m_count+1)) return -1;
+  resource_type *target = &m_resource_list[index];
+  memset (target, 0, sizeof(resource_type));
+  strncpy (target->m_element_name,element_name,MAX_RESOURCE_NAMELEN);
+  target->m_element_size = element_datalen;
+  target->m_element_flags = RESOURCE_ELEMENT_LAZY;
+  target->m_file_offset = file_offset;
+  insert_name_hash(index);
+  return index;
+}
+
+
+
 //
 // Add filler (for tracking unused element ID's on read archives)...
 //
@@ -126,23 +297,43 @@ int pleo_resource_type::update_element(const char *element_name, int index, unsi
 {
   if (index<0) return -1;
 
+  // Replacing content leaves a stale slot behind...
+  bool had_element = (m_resource_list[index].m_element != NULL);
+  if (had_element) m_content_hash_dirty = true;
+
+  // Copied data no larger than pooled data it replaces reuses its pool space...
+  unsigned char *reuse = NULL;
+  if (had_element && !assume_ownership && (m_resource_list[index].m_element_flags & RESOURCE_ELEMENT_POOLED) &&
+      (element_datalen <= (int)((m_resource_list[index].m_element_size+7) & ~7))) {
+    reuse = m_resource_list[index].m_element;
+    m_resource_list[index].m_element_flags = RESOURCE_ELEMENT_OWNED;
+    m_resource_list[index].m_element = NULL;
+  }
+
   free_element(index);
   resource_type *target = &m_resource_list[index];
 
+  // Renaming a hashed element leaves a stale slot behind...
+  bool renamed = (strncmp(target->m_element_name,element_name,sizeof(target->m_element_name)) != 0);
+  if (renamed && target->m_element_name[0]) m_name_hash_dirty = true;
+
   memcpy (target->m_signature, element_data, sizeof(target->m_signature));
   memset (target->m_element_name,0,sizeof(target->m_element_name));
   strncpy (target->m_element_name,element_name,sizeof(target->m_element_name));
+  if (renamed) insert_name_hash(index);
 
-  // Copy element data...
+  // Copy element data (may overlap the space reused)...
   if (assume_ownership)
     target->m_element = element_data;
   else {
-    target->m_element = (unsigned char *)malloc(element_datalen);
+    target->m_element = reuse ? reuse : pool_alloc(element_datalen);
     if (target->m_element == NULL) return -1;
-    memcpy (target->m_element, element_data, element_datalen);
+    memmove (target->m_element, element_data, element_datalen);
+    target->m_element_flags = RESOURCE_ELEMENT_POOLED;
   }
 
   target->m_element_size = element_datalen;
+  if (!had_element) insert_content_hash(index);
   return index;
 }
 
@@ -160,8 +351,10 @@ bool pleo_resource_type::remove_element(int index)
   if ((index<0) || (index>=m_count)) return false;
   free_element(index);    
   if (index<(m_count-1))
-    memcpy (&m_resource_list[index], &m_resource_list[index+1], (m_count-index-1)*sizeof(resource_type));
+    memmove (&m_resource_list[index], &m_resource_list[index+1], (m_count-index-1)*sizeof(resource_type));
   m_count--;
+  m_name_hash_dirty = true; // following indices shifted down
+  m_content_hash_dirty = true;
   return true;
 }
 
@@ -175,6 +368,50 @@ bool pleo_resource_type::remove_element(const char *element_name)
 
 
 
+//
+// Get element data, fetching it from the archive file first if lazy...
+//
+unsigned char *pleo_resource_type::load_element(int index)
+{
+  if ((index<0) || (index>=m_count)) return NULL;
+  resource_type *target = &m_resource_list[index];
+  if ((target->m_element_flags & RESOURCE_ELEMENT_LAZY)==0) return target->m_element;
+
+#ifdef _WIN32
+  return NULL;
+#else
+  if (m_lazy_fd<0) return NULL;
+  unsigned char *dataptr = pool_alloc(target->m_element_size);
+  if (dataptr==NULL) return NULL;
+
+  int len = target->m_element_size;
+  int ofs = target->m_file_offset;
+  for (unsigned char *ptr = dataptr; len>0; ) {
+    ssize_t result = pread(m_lazy_fd, ptr, len, ofs);
+    if ((result<0) && (errno==EINTR)) continue;
+    if (result<=0) return NULL; // pool space reclaimed by init_resource
+    ptr += result; ofs += result; len -= result;
+  }
+
+  memcpy (target->m_signature, dataptr, sizeof(target->m_signature));
+  target->m_element = dataptr;
+  target->m_element_flags = RESOURCE_ELEMENT_POOLED;
+  return dataptr;
+#endif
+}
+
+
+bool pleo_resource_type::load_all_elements()
+{
+  bool result = true;
+  for (int i=0; i<m_count; i++)
+    if (m_resource_list[i].m_element_flags & RESOURCE_ELEMENT_LAZY)
+      result &= (load_element(i) != NULL);
+  return result;
+}
+
+
+
 //
 // Find element by index...
 //
@@ -183,7 +420,76 @@ unsigned char *pleo_resource_type::get_element_dataptr(int index, char *element_
   if ((index<0) || (index>=m_count)) return NULL;
   if (element_name) memcpy (element_name, m_resource_list[index].m_element_name, MAX_RESOURCE_NAMELEN);
   if (element_datalen) *element_datalen = m_resource_list[index].m_element_size;
-  return m_resource_list[index].m_element;
+  return load_element(index);
+}
+
+
+
+//
+// Name hashing (FNV-1a)...
+//
+static unsigned int hash_element_name(const char *element_name)
+{
+  unsigned int hash = 2166136261u;
+  for (int i=0; element_name[i] && (i<MAX_RESOURCE_NAMELEN+4); i++) {
+    hash ^= (unsigned char)element_name[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+
+
+//
+// Rebuild name table from scratch, sized for at most 50% load...
+//
+bool pleo_resource_type::rebuild_name_hash()
+{
+  int new_size = 64;
+  while (new_size < 2*m_max_count) new_size <<= 1;
+
+  if (new_size != m_name_hash_size) {
+    int *new_hash = (int *)malloc(sizeof(int)*new_size);
+    if (new_hash==NULL) return false;
+    if (m_name_hash) free (m_name_hash);
+    m_name_hash = new_hash;
+    m_name_hash_size = new_size;
+  }
+  memset (m_name_hash, 0, sizeof(int)*m_name_hash_size);
+  m_name_hash_dirty = false;
+
+  for (int i=0; i<m_count; i++) insert_name_hash(i);
+  return true;
+}
+
+
+
+//
+// Add element to name table.  First index wins for duplicate names...
+//
+void pleo_resource_type::insert_name_hash(int index)
+{
+  if (m_name_hash_dirty) return; // whole table rebuilt on next lookup
+  if (m_name_hash_size < 2*m_count) {
+    m_name_hash_dirty = true;
+    return;
+  }
+
+  const char *element_name = m_resource_list[index].m_element_name;
+  if (element_name[0]==0) return; // fillers aren't named
+
+  int mask = m_name_hash_size-1;
+  for (int slot = hash_element_name(element_name) & mask; ; slot = (slot+1) & mask) {
+    int entry = m_name_hash[slot];
+    if (entry==0) {
+      m_name_hash[slot] = index+1;
+      return;
+    }
+    if (strcmp(m_resource_list[entry-1].m_element_name, element_name)==0) {
+      if (index < entry-1) m_name_hash[slot] = index+1;
+      return;
+    }
+  }
 }
 
 
@@ -196,16 +502,178 @@ int pleo_resource_type::get_element_index(const char *element_name)
   // Sanity...
   if (element_name==NULL) return -1;
   if (element_name[0]==0) return -1;
-  // Linear search (for now)...
-  for (int i=0; i<m_count; i++)
-    if (m_resource_list[i].m_element_name)
-      if (strcmp(m_resource_list[i].m_element_name, element_name)==0)
-        return i;
+  if (m_count<1) return -1;
+
+  if (m_name_hash_dirty || (m_name_hash==NULL))
+    if (!rebuild_name_hash()) return -1;
+
+  int mask = m_name_hash_size-1;
+  for (int slot = hash_element_name(element_name) & mask; m_name_hash[slot]; slot = (slot+1) & mask)
+    if (strcmp(m_resource_list[m_name_hash[slot]-1].m_element_name, element_name)==0)
+      return m_name_hash[slot]-1;
   return -1;
 }
 
 
 
+// =========================================================================
+// xxHash64 -- fast non-cryptographic content hash
+// Copyright (C) 2012-2016 Yann Collet (BSD 2-clause license)
+
+#define XXH_PRIME64_1 11400714785074694791ULL
+#define XXH_PRIME64_2 14029467366897019727ULL
+#define XXH_PRIME64_3  1609587929392839161ULL
+#define XXH_PRIME64_4  9650029242287828579ULL
+#define XXH_PRIME64_5  2870177450012600261ULL
+
+#define XXH_ROTL64(x,r) (((x) << (r)) | ((x) >> (64-(r))))
+
+static inline unsigned long long xxh_read64(const unsigned char *p)
+  {unsigned long long v; memcpy (&v, p, sizeof(v)); return v;}
+
+static inline unsigned int xxh_read32(const unsigned char *p)
+  {unsigned int v; memcpy (&v, p, sizeof(v)); return v;}
+
+static inline unsigned long long xxh_round(unsigned long long acc, unsigned long long input)
+{
+  acc += input * XXH_PRIME64_2;
+  acc = XXH_ROTL64(acc, 31);
+  return acc * XXH_PRIME64_1;
+}
+
+static inline unsigned long long xxh_merge_round(unsigned long long acc, unsigned long long val)
+{
+  acc ^= xxh_round(0, val);
+  return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+static unsigned long long xxhash64(const unsigned char *p, unsigned int len, unsigned long long seed)
+{
+  const unsigned char *end = p + len;
+  unsigned long long h64;
+
+  if (len >= 32) {
+    const unsigned char *limit = end - 32;
+    unsigned long long v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+    unsigned long long v2 = seed + XXH_PRIME64_2;
+    unsigned long long v3 = seed;
+    unsigned long long v4 = seed - XXH_PRIME64_1;
+    do {
+      v1 = xxh_round(v1, xxh_read64(p)); p += 8;
+      v2 = xxh_round(v2, xxh_read64(p)); p += 8;
+      v3 = xxh_round(v3, xxh_read64(p)); p += 8;
+      v4 = xxh_round(v4, xxh_read64(p)); p += 8;
+    } while (p <= limit);
+    h64 = XXH_ROTL64(v1,1) + XXH_ROTL64(v2,7) + XXH_ROTL64(v3,12) + XXH_ROTL64(v4,18);
+    h64 = xxh_merge_round(h64, v1);
+    h64 = xxh_merge_round(h64, v2);
+    h64 = xxh_merge_round(h64, v3);
+    h64 = xxh_merge_round(h64, v4);
+  }
+  else h64 = seed + XXH_PRIME64_5;
+
+  h64 += (unsigned long long)len;
+
+  while (p+8 <= end) {
+    h64 ^= xxh_round(0, xxh_read64(p));
+    h64 = XXH_ROTL64(h64,27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+    p += 8;
+  }
+  if (p+4 <= end) {
+    h64 ^= (unsigned long long)xxh_read32(p) * XXH_PRIME64_1;
+    h64 = XXH_ROTL64(h64,23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+    p += 4;
+  }
+  while (p < end) {
+    h64 ^= (*p) * XXH_PRIME64_5;
+    h64 = XXH_ROTL64(h64,11) * XXH_PRIME64_1;
+    p++;
+  }
+
+  h64 ^= h64 >> 33;
+  h64 *= XXH_PRIME64_2;
+  h64 ^= h64 >> 29;
+  h64 *= XXH_PRIME64_3;
+  h64 ^= h64 >> 32;
+  return h64;
+}
+
+
+
+//
+// Content hash of element (computed once, until element replaced)...
+//
+unsigned long long pleo_resource_type::get_element_hash(int index)
+{
+  resource_type *target = &m_resource_list[index];
+  if ((target->m_element_flags & RESOURCE_ELEMENT_HASHED)==0) {
+    if (load_element(index)==NULL) return 0;
+    target->m_content_hash = xxhash64(target->m_element, target->m_element_size, 0);
+    target->m_element_flags |= RESOURCE_ELEMENT_HASHED;
+  }
+  return target->m_content_hash;
+}
+
+
+
+//
+// Rebuild content table from scratch, sized for at most 50% load...
+//
+bool pleo_resource_type::rebuild_content_hash()
+{
+  int new_size = 64;
+  while (new_size < 2*m_max_count) new_size <<= 1;
+
+  if (new_size != m_content_hash_size) {
+    int *new_hash = (int *)malloc(sizeof(int)*new_size);
+    if (new_hash==NULL) return false;
+    if (m_content_hash) free (m_content_hash);
+    m_content_hash = new_hash;
+    m_content_hash_size = new_size;
+  }
+  memset (m_content_hash, 0, sizeof(int)*m_content_hash_size);
+  m_content_hash_dirty = false;
+
+  for (int i=0; i<m_count; i++) insert_content_hash(i);
+  return true;
+}
+
+
+
+//
+// Add element to content table.  First index wins for identical content...
+//
+void pleo_resource_type::insert_content_hash(int index)
+{
+  // Not built yet (or being rebuilt on next lookup)...
+  if ((m_content_hash==NULL) || m_content_hash_dirty) return;
+  if (m_content_hash_size < 2*m_count) {
+    m_content_hash_dirty = true;
+    return;
+  }
+
+  resource_type *target = &m_resource_list[index];
+  if (load_element(index)==NULL) return; // fillers have no content
+
+  unsigned long long hash = get_element_hash(index);
+  int mask = m_content_hash_size-1;
+  for (int slot = (int)hash & mask; ; slot = (slot+1) & mask) {
+    int entry = m_content_hash[slot];
+    if (entry==0) {
+      m_content_hash[slot] = index+1;
+      return;
+    }
+    resource_type *match = &m_resource_list[entry-1];
+    if ((match->m_content_hash == hash) && (match->m_element_size == target->m_element_size) &&
+        (memcmp(match->m_element, target->m_element, target->m_element_size)==0)) {
+      if (index < entry-1) m_content_hash[slot] = index+1;
+      return;
+    }
+  }
+}
+
+
+
 //
 // Find element by binary compare...
 //
@@ -213,11 +681,19 @@ int pleo_resource_type::find_element_index(unsigned char *element_data, int elem
 {
   if (element_data==NULL) return -1;
   if (element_datalen<MIN_ELEMENT_DATALEN) return -1;
-  // Linear search (for now)...
-  for (int i=0; i<m_count; i++)
-    if (m_resource_list[i].m_element)
-      if (memcmp(m_resource_list[i].m_element, element_data, element_datalen)==0)
-        return i;
+  if (m_count<1) return -1;
+
+  if (m_content_hash_dirty || (m_content_hash==NULL))
+    if (!rebuild_content_hash()) return -1;
+
+  unsigned long long hash = xxhash64(element_data, element_datalen, 0);
+  int mask = m_content_hash_size-1;
+  for (int slot = (int)hash & mask; m_content_hash[slot]; slot = (slot+1) & mask) {
+    resource_type *match = &m_resource_list[m_content_hash[slot]-1];
+    if ((match->m_content_hash == hash) && (match->m_element_size == (unsigned int)element_datalen) &&
+        (memcmp(match->m_element, element_data, element_datalen)==0))
+      return m_content_hash[slot]-1;
+  }
   return -1;
 }
 
@@ -284,9 +760,12 @@ bool pleo_resource_type::write_element_file(int index, char *pathname, char *fil
     sprintf (target_file,"%s\\%s.%s",pathname,m_resource_list[index].m_element_name,fileext);
   else sprintf (target_file,"%s\\zzz%d.%s",pathname,index,fileext);
 
+  unsigned char *dataptr = load_element(index);
+  if (dataptr==NULL) return false;
+
   FILE *fileid = fopen(target_file,"wb");
   if (fileid==NULL) return false;
-  int result = fwrite (m_resource_list[index].m_element, 1, m_resource_list[index].m_element_size, fileid);
+  int result = fwrite (dataptr, 1, m_resource_list[index].m_element_size, fileid);
   fclose (fileid);
   return (result == (int)m_resource_list[index].m_element_size);
 }
@@ -299,6 +778,8 @@ bool pleo_resource_type::write_element_file(int index, char *pathname, char *fil
 bool pleo_resource_type::write_all_element_files(char *pathname, char *fileext)
 {
   bool result = true;
-  for (int i=0; i<m_count; i++) result &= write_element_file(i, pathname, fileext);
+  for (int i=0; i<m_count; i++)
+    if (get_element_status(i)>0) // skip fillers
+      result &= write_element_file(i, pathname, fileext);
   return result;
 }
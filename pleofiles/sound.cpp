@@ -25,12 +25,23 @@
 //
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "sound.h"
 
+#define WAVE_DATA_MARGIN 32768 // extra room for user editing
+
 
 sound_base_type::sound_base_type()
 {
   m_wave_data = NULL;
+  m_wave_borrowed = false;
+  m_wave_mapping = NULL;
+  m_wave_mappinglen = 0;
   init_wave();
 }
 
@@ -38,6 +49,9 @@ sound_base_type::sound_base_type()
 sound_base_type::sound_base_type(sound_base_type &target, int starttime, int stoptime)
 {
   m_wave_data = NULL;
+  m_wave_borrowed = false;
+  m_wave_mapping = NULL;
+  m_wave_mappinglen = 0;
   init_wave();
 
   // Sanity...
@@ -73,10 +87,7 @@ void sound_base_type::init_wave()
 {
   memset (m_original_name,0,sizeof(m_original_name));
 
-  if (m_wave_data != NULL) free(m_wave_data);
-  m_wave_data = NULL;
-  m_wave_datalen = 0;
-  m_wave_maxdatalen = 0;
+  release_wave_data();
 
   m_wave_format.format_tag = 1;
   m_wave_format.channels = 1;
@@ -87,9 +98,49 @@ void sound_base_type::init_wave()
 }
 
 
+//
+// Free (or drop reference to) wave data...
+//
+void sound_base_type::release_wave_data()
+{
+  if (m_wave_mapping != NULL) munmap(m_wave_mapping, m_wave_mappinglen);
+  else if ((m_wave_data != NULL) && !m_wave_borrowed) xfree(m_wave_data);
+  m_wave_data = NULL;
+  m_wave_datalen = 0;
+  m_wave_maxdatalen = 0;
+  m_wave_borrowed = false;
+  m_wave_mapping = NULL;
+  m_wave_mappinglen = 0;
+}
+
+
+//
+// Take a private copy of borrowed wave data.  Needed before editing, or
+// before releasing an image read with SOUNDBASE_FLAG_BORROW...
+//
+bool sound_base_type::detach_wave()
+{
+  if (!m_wave_borrowed) return true;
+
+  int maxlen = m_wave_datalen+WAVE_DATA_MARGIN;
+  unsigned char *newbuf = (unsigned char*)xmalloc(maxlen);
+  if (newbuf==NULL) return false;
+  memcpy (newbuf, m_wave_data, m_wave_datalen);
+
+  int datalen = m_wave_datalen;
+  release_wave_data();
+  m_wave_data = newbuf;
+  m_wave_datalen = datalen;
+  m_wave_maxdatalen = maxlen;
+  return true;
+}
+
+
 void sound_base_type::set_wave_datamaxlen(int datalen)
 {
   if (datalen>m_wave_maxdatalen) {
+    if (!detach_wave()) return;
+    if (datalen<=m_wave_maxdatalen) return;
     m_wave_maxdatalen = datalen;
     unsigned char *new_wavedata = (unsigned char*)xrealloc(m_wave_data,m_wave_maxdatalen);
     if (new_wavedata != NULL) m_wave_data = new_wavedata;
@@ -97,9 +148,9 @@ void sound_base_type::set_wave_datamaxlen(int datalen)
 }
 
 
-#define WAVE_DATA_MARGIN 32768
 void sound_base_type::set_wave_datalen(int datalen)
 {
+  if (!detach_wave()) return;
   if (m_wave_data==NULL) m_wave_maxdatalen=0;
   if (datalen > m_wave_maxdatalen)
     set_wave_datamaxlen (datalen+WAVE_DATA_MARGIN);
@@ -110,53 +161,129 @@ void sound_base_type::set_wave_datalen(int datalen)
 
 ///////////////////////////////////////////////////////////////////////////////////
 //
-// Read WAVE format file.
+// Read WAVE format file.  RIFF files are parsed a chunk at a time from the
+// file descriptor & only the data chunk is read (or mapped with
+// SOUNDBASE_FLAG_MMAP); data needing conversion is streamed through the
+// converter, so only the converted result is held in memory.  Anything
+// else is loaded whole & handed to read_wave_image.
 // Return positive value on success.  Negative value on error...
 //
 int sound_base_type::read_wave_file (const char * targetfile, int flags)
 {
   init_wave();
 
-  FILE *fileid = fopen(targetfile,"rb");
-  if (fileid==NULL) 
+  int fd = open(targetfile, O_RDONLY);
+  if (fd<0)
     return SOUNDBASE_ERROR_FILENOTFOUND;
 
-  if (fseek(fileid,0,SEEK_END) != 0) {
-    fclose (fileid);
-    return SOUNDBASE_ERROR_FILENOTFOUND;
-  }
+  riff_header_type riff_header;
+  if ((pread(fd, &riff_header, sizeof(riff_header), 0) != sizeof(riff_header)) ||
+      (strncmp(riff_header.signature,"RIFF",4)!=0) || (strncmp(riff_header.rifftype,"WAVE",4)!=0))
+  {
+    struct stat filestat;
+    if ((fstat(fd, &filestat)!=0) || (filestat.st_size<(off_t)sizeof(int)) || (filestat.st_size>0x7FFFFFFF)) {
+      close (fd);
+      return SOUNDBASE_ERROR_FILENOTFOUND;
+    }
 
-  int datalen = ftell(fileid);
-  if (datalen<sizeof(int)) { // must be at least a signature...
-    fclose (fileid);
-    return SOUNDBASE_ERROR_FILENOTFOUND;
+    int datalen = (int)filestat.st_size;
+    unsigned char *dataptr = (unsigned char *)xmalloc(datalen);
+    if ((dataptr==NULL) || (pread(fd, dataptr, datalen, 0) != datalen)) {
+      if (dataptr) xfree(dataptr);
+      close (fd);
+      return SOUNDBASE_ERROR_FILENOTFOUND;
+    }
+    close (fd);
+
+    int result = read_wave_image(targetfile, dataptr, datalen, flags & ~SOUNDBASE_FLAG_BORROW);
+    xfree(dataptr);
+    return result;
   }
 
-  if (fseek(fileid,0,SEEK_SET) != 0) {
-    fclose (fileid);
-    return SOUNDBASE_ERROR_FILENOTFOUND;
+  long long wavedataofs;
+  int wavedatalen;
+  int result = find_wave_chunks_fd(fd, &m_wave_format, &wavedataofs, &wavedatalen);
+  if (result<=0) {
+    close (fd);
+    return result;
+  }
+  set_original_name(targetfile);
+
+  // Convert non-native data straight from file...
+  if ((m_wave_format.channels != 1) ||
+      (m_wave_format.samples_per_sec != PLEO_WAVE_SAMPLERATE) ||
+      (m_wave_format.block_alignment != 1) ||
+      (m_wave_format.bits_per_sample != 8))
+  {
+    bool converted = convert_sound_source(NULL, fd, wavedataofs, wavedatalen);
+    close (fd);
+    if (!converted) {
+      init_wave();
+      return SOUNDBASE_ERROR_INCOMPATIBLE;
+    }
+    return SOUNDBASE_FILE_CONVERTED;
   }
 
-  unsigned char *dataptr = (unsigned char *)xmalloc(datalen);
-  if (dataptr==NULL) {
-    fclose (fileid);
-    return SOUNDBASE_ERROR_FILENOTFOUND;
+  // Map native data in place (mapping must start on a page)...
+  if (flags & SOUNDBASE_FLAG_MMAP) {
+    long long mapofs = wavedataofs & ~(long long)(sysconf(_SC_PAGESIZE)-1);
+    size_t maplen = (size_t)(wavedataofs-mapofs)+wavedatalen;
+    void *mapping = mmap(NULL, maplen, PROT_READ, MAP_PRIVATE, fd, (off_t)mapofs);
+    if (mapping != MAP_FAILED) {
+      close (fd);
+      m_wave_mapping = (unsigned char *)mapping;
+      m_wave_mappinglen = maplen;
+      m_wave_data = &m_wave_mapping[wavedataofs-mapofs];
+      m_wave_datalen = m_wave_maxdatalen = wavedatalen;
+      m_wave_borrowed = true;
+      return result;
+    }
   }
 
-  int readlen = fread(dataptr, 1, datalen, fileid);
-  fclose(fileid);
-  if (readlen != datalen) {
-    free(dataptr);
+  // ...or read just the data chunk...
+  m_wave_maxdatalen = wavedatalen+WAVE_DATA_MARGIN;
+  m_wave_data = (unsigned char *)xmalloc(m_wave_maxdatalen);
+  if (m_wave_data==NULL) {
+    close (fd);
+    init_wave();
+    return SOUNDBASE_ERROR_TOOBIG;
+  }
+  int readlen = 0;
+  while (readlen<wavedatalen) {
+    ssize_t len = pread(fd, &m_wave_data[readlen], wavedatalen-readlen, (off_t)(wavedataofs+readlen));
+    if (len<=0) break;
+    readlen += (int)len;
+  }
+  close (fd);
+  if (readlen != wavedatalen) {
+    init_wave();
     return SOUNDBASE_ERROR_FILENOTFOUND;
   }
-
-  int result = read_wave_image(targetfile, dataptr, datalen, flags);
-  free(dataptr);
+  m_wave_datalen = wavedatalen;
   return result;
 }
 
 
 
+//
+// Generate "original" name from msg (file name less path & extension)...
+//
+void sound_base_type::set_original_name(const char *msg)
+{
+  int i=0,j=0,extofs=-1;
+  for (i=0; msg[i] && (i<sizeof(m_original_name)); i++) {
+    if ((msg[i]=='\\') || (msg[i]==':')) {j=0; extofs=-1;}
+    else {
+      if (msg[i]=='.') extofs=j;
+      if (j<sizeof(m_original_name)) m_original_name[j++] = msg[i];
+    }
+  }
+  if (extofs>=0) m_original_name[extofs]=0;
+  else m_original_name[j]=0;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////////
 //
 // Read WAVE format memory image.
@@ -185,17 +312,7 @@ int sound_base_type::read_wave_image (const char *msg, unsigned char *imagedata,
   bool got_fact_chunk = false;
   bool got_unknown_chunk = false;
 
-  // Generate "original" name from msg...
-  int i=0,j=0,extofs=-1;
-  for (i=0; msg[i] && (i<sizeof(m_original_name)); i++) {
-    if ((msg[i]=='\\') || (msg[i]==':')) {j=0; extofs=-1;}
-    else {
-      if (msg[i]=='.') extofs=j;
-      if (j<sizeof(m_original_name)) m_original_name[j++] = msg[i];
-    }
-  }
-  if (extofs>=0) m_original_name[extofs]=0;
-  else m_original_name[j]=0;
+  set_original_name(msg);
 
   while (rdofs<imagelen) {
     wave_chunk_type chunk_header;
@@ -228,14 +345,14 @@ int sound_base_type::read_wave_image (const char *msg, unsigned char *imagedata,
       if (!got_format_chunk)
         return SOUNDBASE_ERROR_BADIMAGE;
 
-      m_wave_datalen = chunk_header.chunklen;
-      m_wave_maxdatalen = m_wave_datalen+32768; // allocate a little extra room for user editing
-
-      m_wave_data = (unsigned char*)xmalloc(m_wave_maxdatalen);
-      if (m_wave_data==NULL) return SOUNDBASE_ERROR_TOOBIG;
-
-      // Copy wave data...
-      memcpy (m_wave_data, &imagedata[rdofs], m_wave_datalen);
+      // Reference wave data in place for now (truncated images give what
+      // is there).  It is converted from the image, or copied below unless
+      // the caller lends us the image...
+      release_wave_data();
+      m_wave_data = &imagedata[rdofs];
+      m_wave_datalen = (chunk_header.chunklen < imagelen-rdofs) ? chunk_header.chunklen : imagelen-rdofs;
+      m_wave_maxdatalen = m_wave_datalen;
+      m_wave_borrowed = true;
       rdofs += m_wave_datalen;
 
       // If reading data section doesn't reach end of file, then there is some
@@ -266,6 +383,11 @@ int sound_base_type::read_wave_image (const char *msg, unsigned char *imagedata,
       else if (got_unknown_chunk) 
         converted = true;
 
+      if (((flags & SOUNDBASE_FLAG_BORROW)==0) && !detach_wave()) {
+        init_wave();
+        return SOUNDBASE_ERROR_TOOBIG;
+      }
+
       return (converted) ? SOUNDBASE_FILE_CONVERTED : SOUNDBASE_FILE_OK;
     }
 
@@ -421,3 +543,623 @@ unsigned char *sound_base_type::write_wave_image (int *imagelen, int flags, int
   if (imagelen != NULL) *imagelen = wrofs;
   return (imagedata); 
 }
+
+
+
+///////////////////////////////////////////////////////////////////////////////////
+//
+// Locate format & data chunks of WAVE memory image without copying data.
+// Returns SOUNDBASE_FILE_OK, or negative value on error...
+//
+int sound_base_type::find_wave_chunks (unsigned char *imagedata, int imagelen, wave_format_type *format, unsigned char **wavedata, int *wavedatalen)
+{
+  // Sanity...
+  if ((imagedata==NULL) || (imagelen<(int)(sizeof(riff_header_type)+2*sizeof(wave_chunk_type))))
+    return SOUNDBASE_ERROR_NOIMAGE;
+
+  riff_header_type riff_header;
+  memcpy (&riff_header, imagedata, sizeof(riff_header));
+  if ((strncmp(riff_header.signature,"RIFF",4)!=0) || (strncmp(riff_header.rifftype,"WAVE",4)!=0))
+    return SOUNDBASE_ERROR_BADIMAGE; // image bad
+
+  bool got_format_chunk = false;
+  int rdofs = sizeof(riff_header);
+  while (rdofs+(int)sizeof(wave_chunk_type) <= imagelen) {
+    wave_chunk_type chunk_header;
+    memcpy (&chunk_header, &imagedata[rdofs], sizeof(chunk_header));
+    rdofs += sizeof(chunk_header);
+    if (chunk_header.chunklen<0) return SOUNDBASE_ERROR_BADIMAGE;
+
+    // Wave format block?
+    if (strncmp(chunk_header.signature,"fmt ",4)==0) {
+      if (got_format_chunk) return SOUNDBASE_ERROR_BADIMAGE; // more than one format block is bad...
+      if ((chunk_header.chunklen<(int)sizeof(wave_format_type)) || (rdofs+(int)sizeof(wave_format_type)>imagelen))
+        return SOUNDBASE_ERROR_BADIMAGE;
+      memcpy (format, &imagedata[rdofs], sizeof(wave_format_type));
+      if ((format->format_tag != 1) || 
+          (format->channels<1) || (format->channels>2) ||
+          ((format->bits_per_sample != 8) && (format->bits_per_sample != 16)) ||
+          (format->samples_per_sec<1))
+        return SOUNDBASE_ERROR_BADIMAGE;
+      got_format_chunk = true;
+    }
+
+    // Wave data block (truncated files give what is there)...
+    else if (strncmp(chunk_header.signature,"data",4)==0) {
+      if (!got_format_chunk) return SOUNDBASE_ERROR_BADIMAGE;
+      *wavedata = &imagedata[rdofs];
+      *wavedatalen = (chunk_header.chunklen < imagelen-rdofs) ? chunk_header.chunklen : imagelen-rdofs;
+      return SOUNDBASE_FILE_OK;
+    }
+
+    // Chunks are word aligned...
+    if (chunk_header.chunklen > imagelen-rdofs) break;
+    rdofs += chunk_header.chunklen + (chunk_header.chunklen & 1);
+  }
+
+  // If reach end of imagedata without finding wave "data" chunk, then error...
+  return SOUNDBASE_ERROR_TOOSMALL;
+}
+
+
+//
+// As find_wave_chunks, but walks chunk headers of an open file without
+// reading chunk bodies.  Gives file offset & length of data chunk.
+// Returns SOUNDBASE_FILE_OK, SOUNDBASE_FILE_CONVERTED if chunks other
+// than fmt/fact/data are present (dropped on rewrite), or negative value
+// on error...
+//
+int sound_base_type::find_wave_chunks_fd (int fd, wave_format_type *format, long long *wavedataofs, int *wavedatalen)
+{
+  struct stat filestat;
+  if (fstat(fd, &filestat)!=0) return SOUNDBASE_ERROR_FILENOTFOUND;
+  long long filelen = filestat.st_size;
+  if (filelen<(long long)(sizeof(riff_header_type)+2*sizeof(wave_chunk_type)))
+    return SOUNDBASE_ERROR_NOIMAGE;
+
+  riff_header_type riff_header;
+  if (pread(fd, &riff_header, sizeof(riff_header), 0) != sizeof(riff_header))
+    return SOUNDBASE_ERROR_FILENOTFOUND;
+  if ((strncmp(riff_header.signature,"RIFF",4)!=0) || (strncmp(riff_header.rifftype,"WAVE",4)!=0))
+    return SOUNDBASE_ERROR_BADIMAGE; // image bad
+
+  bool got_format_chunk = false;
+  bool got_unknown_chunk = false;
+  long long rdofs = sizeof(riff_header);
+  while (rdofs+(long long)sizeof(wave_chunk_type) <= filelen) {
+    wave_chunk_type chunk_header;
+    if (pread(fd, &chunk_header, sizeof(chunk_header), (off_t)rdofs) != sizeof(chunk_header))
+      return SOUNDBASE_ERROR_FILENOTFOUND;
+    rdofs += sizeof(chunk_header);
+    if (chunk_header.chunklen<0) return SOUNDBASE_ERROR_BADIMAGE;
+
+    // Wave format block?
+    if (strncmp(chunk_header.signature,"fmt ",4)==0) {
+      if (got_format_chunk) return SOUNDBASE_ERROR_BADIMAGE; // more than one format block is bad...
+      if ((chunk_header.chunklen<(int)sizeof(wave_format_type)) ||
+          (pread(fd, format, sizeof(wave_format_type), (off_t)rdofs) != sizeof(wave_format_type)))
+        return SOUNDBASE_ERROR_BADIMAGE;
+      if ((format->format_tag != 1) || 
+          (format->channels<1) || (format->channels>2) ||
+          (format->block_alignment<1) || (format->block_alignment>4) ||
+          ((format->bits_per_sample != 8) && (format->bits_per_sample != 16)) ||
+          (format->samples_per_sec<1))
+        return SOUNDBASE_ERROR_BADIMAGE;
+      got_format_chunk = true;
+    }
+
+    // Wave data block (truncated files give what is there)...
+    else if (strncmp(chunk_header.signature,"data",4)==0) {
+      if (!got_format_chunk) return SOUNDBASE_ERROR_BADIMAGE;
+      *wavedataofs = rdofs;
+      *wavedatalen = (chunk_header.chunklen < filelen-rdofs) ? chunk_header.chunklen : (int)(filelen-rdofs);
+
+      // Anything after data within the RIFF chunk is dropped too...
+      if (rdofs+chunk_header.chunklen+(chunk_header.chunklen & 1) < (long long)riff_header.chunklen+8)
+        got_unknown_chunk = true;
+      return (got_unknown_chunk) ? SOUNDBASE_FILE_CONVERTED : SOUNDBASE_FILE_OK;
+    }
+
+    else if (strncmp(chunk_header.signature,"fact",4)!=0)
+      got_unknown_chunk = true;
+
+    // Chunks are word aligned...
+    rdofs += chunk_header.chunklen + (chunk_header.chunklen & 1);
+  }
+
+  // If reach end of file without finding wave "data" chunk, then error...
+  return SOUNDBASE_ERROR_TOOSMALL;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////////
+//
+// Polyphase resampler filter banks.  One bank per reduced ratio holds a
+// windowed-sinc filter for each output phase, zero padded to a multiple of
+// 8 taps for the dot product...
+//
+struct sound_resample_banktype {
+  sound_resample_banktype *m_next;
+  unsigned int m_upsample;
+  unsigned int m_downsample;
+  int m_phases;
+  int m_taps;              // per phase
+  int m_lead;              // taps before the frame an output sample falls in
+  float *m_coeffs;         // m_phases*m_taps
+};
+
+static pthread_mutex_t g_resample_bank_lock = PTHREAD_MUTEX_INITIALIZER;
+static sound_resample_banktype *g_resample_banks = NULL;
+
+
+//
+// Modified Bessel function of first kind, order 0 (Kaiser window)...
+//
+static double resample_bessel_i0(double x)
+{
+  double sum = 1.0, term = 1.0;
+  for (int k=1; k<64; k++) {
+    term *= (x/(2*k))*(x/(2*k));
+    sum += term;
+    if (term < sum*1e-12) break;
+  }
+  return sum;
+}
+
+
+//
+// Build filter bank for upsample:downsample.  Cutoff sits below the lower
+// of the two Nyquist rates, so the same design serves up & down sampling.
+// Returns NULL if ratio needs more than SOUND_RESAMPLE_MAX_TAPS...
+//
+static sound_resample_banktype *build_resample_bank(unsigned int upsample, unsigned int downsample)
+{
+  double cutoff = 0.5*SOUND_RESAMPLE_ROLLOFF; // cycles per source frame
+  if (upsample<downsample) cutoff *= (double)upsample/downsample;
+  int half = (int)ceil(SOUND_RESAMPLE_ZEROS/(2*cutoff));
+  int taps = (2*half+7) & ~7;
+  if (taps > SOUND_RESAMPLE_MAX_TAPS) return NULL;
+
+  sound_resample_banktype *bank = (sound_resample_banktype *)xmalloc(sizeof(sound_resample_banktype));
+  if (bank==NULL) return NULL;
+  bank->m_next = NULL;
+  bank->m_upsample = upsample;
+  bank->m_downsample = downsample;
+  bank->m_phases = (upsample < SOUND_RESAMPLE_MAX_PHASES) ? upsample : SOUND_RESAMPLE_MAX_PHASES;
+  bank->m_taps = taps;
+  bank->m_lead = half-1;
+  bank->m_coeffs = (float *)xmalloc(sizeof(float)*bank->m_phases*taps);
+  if (bank->m_coeffs==NULL) {
+    xfree (bank);
+    return NULL;
+  }
+  double *phase_coeffs = (double *)xmalloc(sizeof(double)*2*half);
+  if (phase_coeffs==NULL) {
+    xfree (bank->m_coeffs);
+    xfree (bank);
+    return NULL;
+  }
+  memset (bank->m_coeffs, 0, sizeof(float)*bank->m_phases*taps);
+
+  double window_scale = 1.0/resample_bessel_i0(SOUND_RESAMPLE_BETA);
+  for (int phase=0; phase<bank->m_phases; phase++) {
+    double frac = (double)phase/bank->m_phases;
+    double sum = 0;
+    for (int i=0; i<2*half; i++) {
+      double x = i - bank->m_lead - frac; // source frames from output position
+      double t = x/half;
+      double window = (t*t<1.0) ? resample_bessel_i0(SOUND_RESAMPLE_BETA*sqrt(1.0-t*t))*window_scale : 0.0;
+      double arg = 2*cutoff*x*M_PI;
+      double sinc = (arg==0) ? 1.0 : sin(arg)/arg;
+      phase_coeffs[i] = 2*cutoff*sinc*window;
+      sum += phase_coeffs[i];
+    }
+
+    // Normalise each phase for unity DC gain (no ripple at phase rate)...
+    for (int i=0; i<2*half; i++) bank->m_coeffs[phase*taps+i] = (float)(phase_coeffs[i]/sum);
+  }
+  xfree (phase_coeffs);
+  return bank;
+}
+
+
+//
+// Find or build bank for a ratio.  Banks live until the process exits...
+//
+static const sound_resample_banktype *get_resample_bank(unsigned int upsample, unsigned int downsample)
+{
+  pthread_mutex_lock (&g_resample_bank_lock);
+  sound_resample_banktype *bank = g_resample_banks;
+  while ((bank!=NULL) && ((bank->m_upsample!=upsample) || (bank->m_downsample!=downsample)))
+    bank = bank->m_next;
+
+  if (bank==NULL) {
+    bank = build_resample_bank(upsample, downsample);
+    if (bank!=NULL) {
+      bank->m_next = g_resample_banks;
+      g_resample_banks = bank;
+    }
+  }
+  pthread_mutex_unlock (&g_resample_bank_lock);
+  return bank;
+}
+
+
+//
+// FIR inner loop: dot product of count floats (count multiple of 8)...
+//
+static float resample_dot_scalar(const float *srcdata, const float *coeffs, int count)
+{
+  float sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+  for (int i=0; i<count; i+=4) {
+    sum0 += srcdata[i]*coeffs[i];
+    sum1 += srcdata[i+1]*coeffs[i+1];
+    sum2 += srcdata[i+2]*coeffs[i+2];
+    sum3 += srcdata[i+3]*coeffs[i+3];
+  }
+  return (sum0+sum1)+(sum2+sum3);
+}
+
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RESAMPLE_SIMD
+#include <xmmintrin.h>
+
+__attribute__((target("sse")))
+static float resample_dot_sse(const float *srcdata, const float *coeffs, int count)
+{
+  __m128 sum0 = _mm_setzero_ps();
+  __m128 sum1 = _mm_setzero_ps();
+  for (int i=0; i<count; i+=8) {
+    sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(&srcdata[i]), _mm_loadu_ps(&coeffs[i])));
+    sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(&srcdata[i+4]), _mm_loadu_ps(&coeffs[i+4])));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, _mm_add_ps(sum0, sum1));
+  return (lanes[0]+lanes[1])+(lanes[2]+lanes[3]);
+}
+#endif
+
+
+typedef float (*resample_dot_func_type)(const float *srcdata, const float *coeffs, int count);
+
+static resample_dot_func_type select_resample_dot()
+{
+#ifdef RESAMPLE_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse")) return resample_dot_sse;
+#endif
+  return resample_dot_scalar;
+}
+
+static resample_dot_func_type g_resample_dot = select_resample_dot();
+
+
+
+///////////////////////////////////////////////////////////////////////////////////
+//
+// Polyphase resampler...
+//
+sound_resample_type::sound_resample_type(unsigned int src_rate, unsigned int dst_rate)
+{
+  m_valid = false;
+  m_bank = NULL;
+  m_history = NULL;
+  m_history_start = 0;
+  m_history_len = 0;
+  m_frames_in = 0;
+  m_out_frame = 0;
+  m_out_phase = 0;
+  m_upsample = m_downsample = 1;
+  m_step_frames = 1;
+  m_step_phase = 0;
+  if ((src_rate<1) || (dst_rate<1)) return;
+
+  // Reduce ratio; output steps through source in whole frames plus phase...
+  unsigned int a = src_rate, b = dst_rate;
+  while (b != 0) {unsigned int r = a%b; a = b; b = r;}
+  m_upsample = dst_rate/a;
+  m_downsample = src_rate/a;
+  m_step_frames = m_downsample/m_upsample;
+  m_step_phase = m_downsample%m_upsample;
+
+  if (m_upsample != m_downsample) {
+    m_bank = get_resample_bank(m_upsample, m_downsample);
+    if (m_bank==NULL) return;
+    m_history = (float *)xmalloc(sizeof(float)*(m_bank->m_taps+SOUND_CONVERT_CHUNK));
+    if (m_history==NULL) return;
+
+    // Prime with silence so first output is centred on frame 0...
+    m_history_start = -m_bank->m_lead;
+    m_history_len = m_bank->m_lead;
+    memset (m_history, 0, sizeof(float)*m_history_len);
+  }
+  m_valid = true;
+}
+
+
+sound_resample_type::~sound_resample_type()
+{
+  if (m_history) xfree(m_history);
+}
+
+
+//
+// Upper bound on samples produced by process for srclen more source frames.
+// Also bounds flush, given srclen of at least SOUND_RESAMPLE_MAX_TAPS...
+//
+int sound_resample_type::get_output_maxlen(int srclen)
+{
+  return (int)(((long long)srclen*m_upsample)/m_downsample + 2);
+}
+
+
+//
+// Emit every output sample whose filter window lies within history (and
+// whose position is before frame_limit), then drop history behind the
+// next window...
+//
+int sound_resample_type::produce(long long frame_limit, float *destdata)
+{
+  const int taps = m_bank->m_taps;
+  const int lead = m_bank->m_lead;
+  long long history_end = m_history_start+m_history_len;
+  int count = 0;
+
+  while ((m_out_frame < frame_limit) && (m_out_frame-lead+taps <= history_end)) {
+    int phase = (int)(((unsigned long long)m_out_phase*m_bank->m_phases)/m_upsample);
+    destdata[count++] = g_resample_dot(&m_history[m_out_frame-lead-m_history_start], &m_bank->m_coeffs[phase*taps], taps);
+
+    m_out_frame += m_step_frames;
+    m_out_phase += m_step_phase;
+    if (m_out_phase >= m_upsample) {
+      m_out_phase -= m_upsample;
+      m_out_frame++;
+    }
+  }
+
+  int drop = (int)(m_out_frame-lead-m_history_start);
+  if (drop>0) {
+    m_history_len -= drop;
+    memmove (m_history, &m_history[drop], sizeof(float)*m_history_len);
+    m_history_start += drop;
+  }
+  return count;
+}
+
+
+//
+// Resample srclen frames.  Returns number of samples written to destdata
+// (at most get_output_maxlen(srclen))...
+//
+int sound_resample_type::process(const float *srcdata, int srclen, float *destdata)
+{
+  if (!m_valid) return 0;
+  m_frames_in += srclen;
+  if (m_bank==NULL) {
+    memcpy (destdata, srcdata, sizeof(float)*srclen);
+    return srclen;
+  }
+
+  int count = 0;
+  while (srclen>0) {
+    int len = m_bank->m_taps+SOUND_CONVERT_CHUNK-m_history_len;
+    if (len>srclen) len = srclen;
+    memcpy (&m_history[m_history_len], srcdata, sizeof(float)*len);
+    m_history_len += len;
+    srcdata += len;
+    srclen -= len;
+    count += produce(m_history_start+m_history_len, &destdata[count]);
+  }
+  return count;
+}
+
+
+//
+// Pad with silence to emit remaining samples up to the last source frame...
+//
+int sound_resample_type::flush(float *destdata)
+{
+  if (!m_valid || (m_bank==NULL)) return 0;
+
+  int count = 0;
+  while (m_out_frame < m_frames_in) {
+    int len = m_bank->m_taps+SOUND_CONVERT_CHUNK-m_history_len;
+    memset (&m_history[m_history_len], 0, sizeof(float)*len);
+    m_history_len += len;
+    count += produce(m_frames_in, &destdata[count]);
+  }
+  return count;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////////
+//
+// Streaming conversion to Pleo wave format...
+//
+sound_convert_type::sound_convert_type(const wave_format_type &format, double gain)
+  : m_resampler(format.samples_per_sec, PLEO_WAVE_SAMPLERATE)
+{
+  m_channels = format.channels;
+  m_samplesize = format.bits_per_sample/8;
+  m_gain = (float)gain;
+  m_frame_size = m_channels*m_samplesize;
+  m_resampled = NULL;
+  if ((format.format_tag != 1) || (m_channels<1) || (m_channels>2) ||
+      ((m_samplesize != 1) && (m_samplesize != 2)) || !m_resampler.is_valid())
+    m_frame_size = 0; // unsupported
+
+  if (m_frame_size) {
+    m_resampled = (float *)xmalloc(sizeof(float)*m_resampler.get_output_maxlen(SOUND_CONVERT_CHUNK));
+    if (m_resampled==NULL) m_frame_size = 0;
+  }
+}
+
+
+sound_convert_type::~sound_convert_type()
+{
+  if (m_resampled) xfree(m_resampled);
+}
+
+
+//
+// Upper bound on samples produced by convert for srclen more source bytes.
+// Flush output also fits in get_output_maxlen(SOUND_CONVERT_CHUNK frames)...
+//
+int sound_convert_type::get_output_maxlen(int srclen)
+{
+  if (m_frame_size==0) return 0;
+  return m_resampler.get_output_maxlen(srclen/m_frame_size);
+}
+
+
+//
+// Downmix & apply gain: frames to mono, 16-bit scale...
+//
+template <int samplesize, int channels>
+static void convert_downmix(const unsigned char *srcdata, int frames, float gain, float *destdata)
+{
+  if (channels==2) gain *= 0.5f;
+  for (int i=0; i<frames; i++, srcdata += samplesize*channels) {
+    float value;
+    if (samplesize==1) {
+      value = (float)((int)srcdata[0]-128)*256;
+      if (channels==2) value += (float)((int)srcdata[1]-128)*256;
+    }
+    else {
+      short left, right;
+      memcpy (&left, srcdata, sizeof(left));
+      value = left;
+      if (channels==2) {
+        memcpy (&right, &srcdata[2], sizeof(right));
+        value += right;
+      }
+    }
+    destdata[i] = value*gain;
+  }
+}
+
+
+//
+// Requantise resampled chunk to 8-bit range...
+//
+int sound_convert_type::requantise(int count, short *destdata)
+{
+  for (int i=0; i<count; i++) {
+    int sample = (int)floorf(m_resampled[i]/256 + 0.5f);
+    if (sample>127) sample = 127; else if (sample<-128) sample = -128;
+    destdata[i] = (short)sample;
+  }
+  return count;
+}
+
+
+//
+// Convert whole frames of srcdata.  Returns number of samples written to
+// destdata (at most get_output_maxlen(srclen))...
+//
+int sound_convert_type::convert(const unsigned char *srcdata, int srclen, short *destdata)
+{
+  if (m_frame_size==0) return 0;
+  float mono[SOUND_CONVERT_CHUNK];
+  int frames = srclen/m_frame_size;
+  int count = 0;
+
+  for (int ofs=0; ofs<frames; ofs+=SOUND_CONVERT_CHUNK) {
+    int len = (frames-ofs < SOUND_CONVERT_CHUNK) ? frames-ofs : SOUND_CONVERT_CHUNK;
+    const unsigned char *chunk = &srcdata[ofs*m_frame_size];
+    switch (m_frame_size) {
+      case 1 : convert_downmix<1,1>(chunk, len, m_gain, mono); break;
+      case 2 : if (m_samplesize==1) convert_downmix<1,2>(chunk, len, m_gain, mono);
+               else convert_downmix<2,1>(chunk, len, m_gain, mono);
+               break;
+      case 4 : convert_downmix<2,2>(chunk, len, m_gain, mono); break;
+    }
+    int resampled = m_resampler.process(mono, len, m_resampled);
+    count += requantise(resampled, &destdata[count]);
+  }
+  return count;
+}
+
+
+//
+// Emit resampler tail once source is exhausted...
+//
+int sound_convert_type::flush(short *destdata)
+{
+  if (m_frame_size==0) return 0;
+  return requantise(m_resampler.flush(m_resampled), destdata);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////////
+//
+// Convert wave data to Pleo format (8-bit mono PLEO_WAVE_SAMPLERATE)...
+//
+bool sound_base_type::convert_sound_data()
+{
+  return convert_sound_source(m_wave_data, -1, 0, m_wave_datalen);
+}
+
+
+//
+// Convert srclen bytes in m_wave_format from srcdata, or if srcdata is
+// NULL from fd at srcofs, replacing current wave data.  The source is
+// streamed through sound_convert_type straight into the new buffer...
+//
+bool sound_base_type::convert_sound_source(const unsigned char *srcdata, int fd, long long srcofs, int srclen)
+{
+  sound_convert_type converter(m_wave_format);
+  if (!converter.is_valid()) return false;
+
+  int maxlen = converter.get_output_maxlen(srclen);
+  unsigned char *newbuf = (unsigned char*)xmalloc(maxlen+WAVE_DATA_MARGIN);
+  int chunklen = SOUND_CONVERT_CHUNK*converter.get_frame_size();
+  short *chunkbuf = (short*)xmalloc(sizeof(short)*converter.get_output_maxlen(chunklen));
+  unsigned char *readbuf = (srcdata==NULL) ? (unsigned char*)xmalloc(chunklen) : NULL;
+  if ((newbuf==NULL) || (chunkbuf==NULL) || ((srcdata==NULL) && (readbuf==NULL))) {
+    if (newbuf) xfree(newbuf);
+    if (chunkbuf) xfree(chunkbuf);
+    if (readbuf) xfree(readbuf);
+    return false;
+  }
+
+  int newbuf_datalen = 0;
+  for (int ofs=0; ofs<srclen+chunklen; ofs+=chunklen) {
+    int count;
+    if (ofs<srclen) {
+      int len = (srclen-ofs < chunklen) ? srclen-ofs : chunklen;
+      const unsigned char *chunk = &srcdata[ofs];
+      if (readbuf) {
+        if (pread(fd, readbuf, len, (off_t)(srcofs+ofs)) != len) {
+          xfree (newbuf);
+          xfree (chunkbuf);
+          xfree (readbuf);
+          return false;
+        }
+        chunk = readbuf;
+      }
+      count = converter.convert(chunk, len, chunkbuf);
+    }
+    else count = converter.flush(chunkbuf); // resampler tail
+    for (int i=0; i<count; i++) newbuf[newbuf_datalen++] = (unsigned char)(chunkbuf[i]+128);
+  }
+  xfree (chunkbuf);
+  if (readbuf) xfree(readbuf);
+
+  release_wave_data();
+  m_wave_data = newbuf;
+  m_wave_datalen = newbuf_datalen;
+  m_wave_maxdatalen = maxlen+WAVE_DATA_MARGIN;
+
+  m_wave_format.format_tag = 1;
+  m_wave_format.channels = 1;
+  m_wave_format.samples_per_sec = PLEO_WAVE_SAMPLERATE;
+  m_wave_format.average_bytes_per_sec = PLEO_WAVE_SAMPLERATE;
+  m_wave_format.block_alignment = 1;
+  m_wave_format.bits_per_sample = 8;
+  return true;
+}
@@ -26,6 +26,7 @@
 #include <malloc.h>
 #include <memory.h>
 #include <string.h>
+#include <stddef.h>
 
 #define swapdata(swaptype,a,b) {swaptype temp=a; a=b; b=temp;}
 
@@ -34,10 +35,21 @@
 #endif
 
 #define PLEO_WAVE_SAMPLERATE 11025
+#define PLEO_WAVE_CONVERT_GAIN 0.98 // headroom for resampling overshoot (as wav2usf.py)
+#define SOUND_CONVERT_CHUNK 2048    // source frames per conversion pass (stays in L1)
+
+// Polyphase resampler filter design...
+#define SOUND_RESAMPLE_ZEROS 16         // sinc zero crossings each side of centre
+#define SOUND_RESAMPLE_ROLLOFF 0.88     // cutoff as fraction of lower Nyquist
+#define SOUND_RESAMPLE_BETA 6.8         // Kaiser window beta (~70dB stopband)
+#define SOUND_RESAMPLE_MAX_PHASES 1024  // odd ratios quantise phase beyond this
+#define SOUND_RESAMPLE_MAX_TAPS 2048    // limits downsampling ratio (~50:1)
 
 // Wave file read/write control flags...
 #define SOUNDBASE_FLAG_NONE            0x00000000
 #define SOUNDBASE_FLAG_NEEDFACTCHUNK   0x00000001
+#define SOUNDBASE_FLAG_BORROW          0x00000002 // read_wave_image: reference data in image (must outlive sound)
+#define SOUNDBASE_FLAG_MMAP            0x00000004 // read_wave_file: map native data rather than read it
 
 // Sound errors...
 #define SOUNDBASE_FILE_CONVERTED 2
@@ -76,8 +88,8 @@ struct wave_chunk_type {
 struct wave_format_type {
   short          format_tag;
   unsigned short channels;
-  unsigned long  samples_per_sec;
-  unsigned long  average_bytes_per_sec;
+  unsigned int   samples_per_sec;
+  unsigned int   average_bytes_per_sec;
   unsigned short block_alignment;
   unsigned short bits_per_sample;
 
@@ -88,6 +100,87 @@ struct wave_format_type {
 
 
 
+//
+// Polyphase windowed-sinc resampler.  Filter banks are built once per
+// reduced src:dst ratio & shared (thread safe) by every resampler using
+// that ratio.  Output lags input by half the filter length, so call flush
+// after the last process to emit the tail...
+//
+struct sound_resample_banktype;
+
+class sound_resample_type
+{
+public:
+  sound_resample_type(unsigned int src_rate, unsigned int dst_rate);
+  ~sound_resample_type();
+
+  bool is_valid() {return m_valid;}
+  int get_output_maxlen(int srclen);
+  int process(const float *srcdata, int srclen, float *destdata);
+  int flush(float *destdata);
+
+protected:
+  bool m_valid;
+  const sound_resample_banktype *m_bank; // NULL = rates equal, straight copy
+  long long m_step_frames;  // whole source frames per output sample
+  unsigned int m_step_phase; // remaining fraction, in 1/m_upsample units
+  unsigned int m_upsample;   // reduced ratio dst:src = m_upsample:m_downsample
+  unsigned int m_downsample;
+
+  long long m_frames_in;    // source frames received
+  long long m_out_frame;    // source frame of next output sample
+  unsigned int m_out_phase; // and its fraction, in 1/m_upsample units
+
+  float *m_history;         // source frames from m_history_start onwards
+  long long m_history_start;
+  int m_history_len;
+
+  int produce(long long frame_limit, float *destdata);
+
+private:
+  sound_resample_type(const sound_resample_type &);
+  sound_resample_type &operator=(const sound_resample_type &);
+};
+
+
+
+//
+// Streaming wave converter.  8/16-bit mono/stereo PCM at any rate to mono
+// PLEO_WAVE_SAMPLERATE samples in signed 8-bit range (-128..127), in one
+// pass per chunk: downmix, gain, resample, requantise.  State is kept
+// between convert calls, so a source can be fed in any number of pieces;
+// flush emits the resampler tail once the source is exhausted...
+//
+class sound_convert_type
+{
+public:
+  sound_convert_type(const wave_format_type &format, double gain=PLEO_WAVE_CONVERT_GAIN);
+  ~sound_convert_type();
+
+  bool is_valid() {return m_frame_size>0;}
+  int get_frame_size() {return m_frame_size;}
+  int get_output_maxlen(int srclen);
+  int convert(const unsigned char *srcdata, int srclen, short *destdata);
+  int flush(short *destdata);
+
+protected:
+  int m_channels;
+  int m_samplesize;        // bytes per channel sample
+  int m_frame_size;        // bytes per frame (0 = unsupported format)
+  float m_gain;
+
+  sound_resample_type m_resampler;
+  float *m_resampled;      // resampler output for one chunk
+
+  int requantise(int count, short *destdata);
+
+private:
+  sound_convert_type(const sound_convert_type &);
+  sound_convert_type &operator=(const sound_convert_type &);
+};
+
+
+
 //
 // Wave data class...
 //
@@ -100,6 +193,12 @@ public:
   int m_wave_maxdatalen;
   int m_wave_datalen;
 
+  // Borrowed wave data (BORROW/MMAP reads) is never freed or edited in
+  // place; it is copied first (see detach_wave)...
+  bool m_wave_borrowed;
+  unsigned char *m_wave_mapping;
+  size_t m_wave_mappinglen;
+
   // Attributes...
   char m_original_name[256];
 
@@ -129,6 +228,9 @@ public:
     swapdata (int, m_wave_maxdatalen, target.m_wave_maxdatalen);
     swapdata (wave_format_type, m_wave_format, target.m_wave_format);
     swapdata (unsigned char*, m_wave_data, target.m_wave_data);
+    swapdata (bool, m_wave_borrowed, target.m_wave_borrowed);
+    swapdata (unsigned char*, m_wave_mapping, target.m_wave_mapping);
+    swapdata (size_t, m_wave_mappinglen, target.m_wave_mappinglen);
   }
 
 public:
@@ -136,12 +238,20 @@ public:
   virtual void init_wave();
   virtual void set_wave_datamaxlen(int datalen);
   virtual void set_wave_datalen(int datalen);
+  virtual bool detach_wave();
 
-  virtual bool convert_sound_data() {return false;}
+  virtual bool convert_sound_data();
+  static int find_wave_chunks (unsigned char *imagedata, int imagelen, wave_format_type *format, unsigned char **wavedata, int *wavedatalen);
+  static int find_wave_chunks_fd (int fd, wave_format_type *format, long long *wavedataofs, int *wavedatalen);
   virtual int read_wave_file (const char *targetfile, int flags=SOUNDBASE_FLAG_NONE);
   virtual int read_wave_image (const char *msg, unsigned char *imagedata, int imagelen, int flags=SOUNDBASE_FLAG_NONE);
   virtual bool write_wave_file (const char *targetfile, int flags=SOUNDBASE_FLAG_NONE);
   virtual unsigned char *write_wave_image (int *imagelen, int flags=SOUNDBASE_FLAG_NONE, int starttime=-1, int stoptime=-1);
+
+protected:
+  void release_wave_data();
+  void set_original_name(const char *msg);
+  bool convert_sound_source(const unsigned char *srcdata, int fd, long long srcofs, int srclen);
 };
 
 
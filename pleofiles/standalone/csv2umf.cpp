@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2010 John of dogsbodynet.com
+ *                    Gareth Nelson
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../pleomotion.h"
+
+void usage() {
+     printf("csv2umf [-o umf_file] [-s angle_step] [-c cache_dir] csvfile [motion_name]\n");
+     printf("\t compiles a motion CSV (time in ms, then one angle per joint) to motion_name.umf\n");
+     printf("\t (default name: csvfile without path or extension)\n");
+     printf("\t -o: output file\n");
+     printf("\t -s: quantise angles to steps of angle_step tenths of a degree (default %d)\n",PLEO_MOTION_ANGLE_STEP);
+     printf("\t -c: keep compiled motions in cache_dir, keyed by a hash of the CSV & settings,\n");
+     printf("\t     so an unchanged motion is copied from there rather than compiled again\n");
+     printf("\t     (the entry used is printed as \"Cache entry <file>\")\n");
+}
+
+/* 64-bit FNV-1a, continuing from hash.
+ */
+unsigned long long hash_bytes(unsigned long long hash, const void *data, int len)
+{
+  const unsigned char *p = (const unsigned char*)data;
+  for(int i=0; i<len; i++) {
+     hash ^= p[i];
+     hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/* Read a whole file (malloc'd, NULL if it can't).
+ */
+unsigned char *read_file(const char *filename, int *len)
+{
+  FILE *fp = fopen(filename,"rb");
+  if(fp==NULL) return NULL;
+  fseek(fp,0,SEEK_END);
+  *len = ftell(fp);
+  fseek(fp,0,SEEK_SET);
+  unsigned char *data = (*len>0) ? (unsigned char*)malloc(*len) : NULL;
+  if((data!=NULL) && (fread(data,1,*len,fp)!=(size_t)*len)) {
+     free(data);
+     data = NULL;
+  }
+  fclose(fp);
+  return data;
+}
+
+/* Write a file, via a temporary & rename so that a reader (or another
+ * csv2umf filling the same cache entry) never sees half of one.
+ */
+bool write_file(const char *filename, const unsigned char *data, int len)
+{
+  char temp_file[1100];
+  snprintf(temp_file,sizeof(temp_file),"%s.%d.tmp",filename,(int)getpid());
+  FILE *fp = fopen(temp_file,"wb");
+  if(fp==NULL) return false;
+  bool ok = (fwrite(data,1,len,fp)==(size_t)len);
+  if((fclose(fp)!=0) || !ok || (rename(temp_file,filename)!=0)) {
+     unlink(temp_file);
+     return false;
+  }
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  const char *umf_file = NULL;
+  const char *cache_dir = NULL;
+  int angle_step = PLEO_MOTION_ANGLE_STEP;
+  int opt;
+  while((opt = getopt(argc,argv,"o:s:c:"))!=-1) {
+     switch(opt) {
+        case 'o' : umf_file = optarg; break;
+        case 's' : angle_step = atoi(optarg); break;
+        case 'c' : cache_dir = optarg; break;
+        default :
+          usage();
+          return 1;
+     }
+  }
+  if((optind>=argc) || (angle_step<1) || (angle_step>255)) {
+     usage();
+     return 1;
+  }
+  char* csv_file = argv[optind];
+
+  // Default motion name is the file's base name...
+  char motion_name[256];
+  if(optind+1<argc) {
+     snprintf(motion_name,sizeof(motion_name),"%s",argv[optind+1]);
+  } else {
+     const char *name = strrchr(csv_file,'/');
+     snprintf(motion_name,sizeof(motion_name),"%s",(name==NULL) ? csv_file : name+1);
+     char *ext = strchr(motion_name,'.');
+     if(ext!=NULL) *ext = 0;
+  }
+  char default_file[300];
+  if(umf_file==NULL) {
+     snprintf(default_file,sizeof(default_file),"%s.umf",motion_name);
+     umf_file = default_file;
+  }
+
+  int fd = open(csv_file,O_RDONLY);
+  struct stat st;
+  if((fd<0) || (fstat(fd,&st)!=0)) {
+     fprintf(stderr,"Error reading %s!\n",csv_file);
+     if(fd>=0) close(fd);
+     return 1;
+  }
+  void *image = (st.st_size>0) ? mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0) : NULL;
+  close(fd);
+  if(image==MAP_FAILED) {
+     fprintf(stderr,"Error reading %s!\n",csv_file);
+     return 1;
+  }
+
+  // Cache key covers everything that goes into the image...
+  char cache_file[1100] = "";
+  unsigned char *umfdata = NULL;
+  int umflen = 0;
+  bool cached = false;
+  if(cache_dir!=NULL) {
+     /* Name as the UMF stores it: UMF_NAME_MAXLEN bytes, zero padded */
+     char name_field[UMF_NAME_MAXLEN+1];
+     size_t namelen = strlen(motion_name);
+     if(namelen>UMF_NAME_MAXLEN) namelen = UMF_NAME_MAXLEN;
+     memset(name_field,0,sizeof(name_field));
+     memcpy(name_field,motion_name,namelen);
+     int settings[2] = {PLEO_UMF_VERSION,angle_step};
+     unsigned long long hash = hash_bytes(14695981039346656037ULL,image,st.st_size);
+     hash = hash_bytes(hash,name_field,UMF_NAME_MAXLEN);
+     hash = hash_bytes(hash,settings,sizeof(settings));
+     mkdir(cache_dir,0777);
+     snprintf(cache_file,sizeof(cache_file),"%s/%016llx.umf",cache_dir,hash);
+     umfdata = read_file(cache_file,&umflen);
+     cached = (umfdata!=NULL) && (umflen>=4) && (memcmp(umfdata,"UGMF",4)==0);
+     if(!cached && (umfdata!=NULL)) {
+        free(umfdata);
+        umfdata = NULL;
+     }
+  }
+
+  if(!cached) {
+     pleo_motion_type motion;
+     motion.set_motion_name(motion_name);
+     int result = motion.read_motion_csv_image((const char*)image,st.st_size);
+     if(result<0) {
+        fprintf(stderr,"%s: %s\n",csv_file,motion.m_error);
+        if(image) munmap(image,st.st_size);
+        return 1;
+     }
+     umfdata = motion.write_pleo_umf_image(&umflen,angle_step);
+     if(umfdata==NULL) {
+        fprintf(stderr,"Error compiling %s!\n",csv_file);
+        if(image) munmap(image,st.st_size);
+        return 1;
+     }
+     printf("Compiled %s: %d frames, %d joints, %d bytes\n",csv_file,motion.m_frame_count,motion.m_joint_count,umflen);
+     if((cache_file[0]!=0) && !write_file(cache_file,umfdata,umflen))
+        fprintf(stderr,"Warning: can't write %s\n",cache_file);
+  }
+  else printf("Cached %s: %d bytes\n",csv_file,umflen);
+  if(cache_file[0]!=0) printf("Cache entry %s\n",cache_file);
+  if(image) munmap(image,st.st_size);
+
+  bool ok = write_file(umf_file,umfdata,umflen);
+  free(umfdata);
+  if(!ok) {
+     fprintf(stderr,"Error writing %s!\n",umf_file);
+     return 1;
+  }
+  return 0;
+}
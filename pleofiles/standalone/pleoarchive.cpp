@@ -25,6 +25,14 @@
 //
 #include <stdlib.h>
 #include <stdio.h>
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#endif
 #include "pleoarchive.h"
 #include "time.h"
 
@@ -55,6 +63,17 @@ pleo_archive_type::pleo_archive_type()
   m_toc_refinfo[PLEO_TOC_COMMAND].resource_list = &m_commands;
   m_toc_refinfo[PLEO_TOC_SCRIPT].resource_list = &m_scripts;
   m_toc_refinfo[PLEO_TOC_PROPERTY].resource_list = &m_properties;
+  m_mappings = NULL;
+  m_lazy_fd = -1;
+}
+
+
+//
+// Destructor...
+//
+pleo_archive_type::~pleo_archive_type()
+{
+  init_archive();
 }
 
 
@@ -73,6 +92,64 @@ void pleo_archive_type::init_archive()
   for (int i=0; i<MAX_RESOURCE_TYPES; i++)
     if (m_toc_refinfo[i].resource_list)
       m_toc_refinfo[i].resource_list->init_resource();
+
+  // Resources no longer reference mapped images or lazy file...
+  unmap_archive_files();
+#ifndef _WIN32
+  if (m_lazy_fd>=0) close (m_lazy_fd);
+#endif
+  m_lazy_fd = -1;
+}
+
+
+
+//
+// Map archive file into memory (private copy-on-write pages)...
+//
+unsigned char *pleo_archive_type::map_archive_file (const char *targetfile, int *binfilelen)
+{
+#ifdef _WIN32
+  return NULL;
+#else
+  int fd = open(targetfile, O_RDONLY);
+  if (fd<0) return NULL;
+
+  struct stat st;
+  if ((fstat(fd,&st) != 0) || (st.st_size<MIN_ELEMENT_DATALEN)) { // must be at least a signature...
+    close (fd);
+    return NULL;
+  }
+
+  void *image = mmap(NULL, st.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (image==MAP_FAILED) return NULL;
+
+  pleo_archive_mapping_type *mapping = (pleo_archive_mapping_type *)malloc(sizeof(pleo_archive_mapping_type));
+  if (mapping==NULL) {
+    munmap (image, st.st_size);
+    return NULL;
+  }
+  mapping->m_image = (unsigned char *)image;
+  mapping->m_imagelen = st.st_size;
+  mapping->m_next = m_mappings;
+  m_mappings = mapping;
+
+  *binfilelen = st.st_size;
+  return mapping->m_image;
+#endif
+}
+
+
+void pleo_archive_type::unmap_archive_files()
+{
+  while (m_mappings) {
+    pleo_archive_mapping_type *next = m_mappings->m_next;
+#ifndef _WIN32
+    munmap (m_mappings->m_image, m_mappings->m_imagelen);
+#endif
+    free (m_mappings);
+    m_mappings = next;
+  }
 }
 
 
@@ -82,6 +159,21 @@ void pleo_archive_type::init_archive()
 //
 int pleo_archive_type::read_archive_file (const char *targetfile, int flags)
 {
+#ifndef _WIN32
+  // Only read TOC, payloads fetched later...
+  if (flags & PLEO_ARCHIVE_FLAG_LAZY)
+    return read_archive_toc(targetfile, flags);
+
+  // Reference resources straight out of mapped file...
+  if (flags & PLEO_ARCHIVE_FLAG_MMAP) {
+    int datalen;
+    unsigned char *dataptr = map_archive_file(targetfile, &datalen);
+    if (dataptr==NULL) return -1;
+    return read_archive_image(targetfile, dataptr, datalen, flags);
+  }
+#endif
+  flags &= ~(PLEO_ARCHIVE_FLAG_MMAP|PLEO_ARCHIVE_FLAG_LAZY); // image freed below
+
   FILE *fileid = fopen(targetfile,"rb");
   if (fileid==NULL) return -1;
   if (fseek(fileid,0,SEEK_END) != 0) {
@@ -120,6 +212,19 @@ int pleo_archive_type::read_archive_file (const char *targetfile, int flags)
 
 
 
+//
+// Add resource from archive image.  Copied unless PLEO_ARCHIVE_FLAG_MMAP
+// (then the image must outlive the resource, or until update_element)...
+//
+static int add_archive_element(pleo_resource_type *rl, const char *element_name, unsigned char *element_data, int element_datalen, int flags)
+{
+  if (flags & PLEO_ARCHIVE_FLAG_MMAP)
+    return rl->add_borrowed_element(element_name, element_data, element_datalen);
+  return rl->add_new_element(element_name, element_data, element_datalen);
+}
+
+
+
 //
 // Import image of Pleo resource archive...
 //
@@ -162,6 +267,14 @@ int pleo_archive_type::read_archive_image (const char *targetfile, unsigned char
   int expected_size = sizeinfo->m_size;
   rdofs += sizeof(pleo_archive_sizetype);
 
+  // Verify Adler32 trailer (everything before it is checksummed)...
+  if (flags & PLEO_ARCHIVE_FLAG_VERIFY) {
+    if ((expected_size<0) || ((expected_size + sizeof(pleo_archive_crctype))>rdlen)) return -2;
+    pleo_archive_crctype *crc = (pleo_archive_crctype*)(&binfile[expected_size]);
+    if (strncmp(crc->m_crc_signature, PLEO_ARCHIVE_CRC_SIGNATURE, 4) != 0) return -2;
+    if (adler32(0, binfile, expected_size) != crc->m_crc) return -3;
+  }
+
   // Read resource entries...
   for (i=0; i<MAX_RESOURCE_TYPES; i++) {
     int tocofs = m_toc_refinfo[i].binofs;
@@ -174,17 +287,29 @@ int pleo_archive_type::read_archive_image (const char *targetfile, unsigned char
       if ((entry_count>0) && (entry_count<MAX_RESOURCE_ENTRIES)) {
         pleo_archive_toc_entrytype *toc_entry = (pleo_archive_toc_entrytype*)&binfile[tocofs+sizeof(pleo_archive_toctype)];
 
+        // Size list & payload pool up front (nothing copied if mapped)...
+        if (m_toc_refinfo[i].resource_list) {
+          pleo_resource_type *rl = m_toc_refinfo[i].resource_list;
+          long long datalen = 0;
+          if ((flags & PLEO_ARCHIVE_FLAG_MMAP)==0)
+            for (int j=0; j<entry_count; j++)
+              if ((toc_entry[j].entry_len>0) && (toc_entry[j].entry_len<=rdlen))
+                datalen += (i==PLEO_TOC_PROPERTY) ? 4 : toc_entry[j].entry_len;
+          if (datalen>rdlen) datalen = rdlen;
+          rl->reserve_elements(rl->m_count+entry_count, (int)datalen);
+        }
+
         if (m_toc_refinfo[i].resource_list)
           if (i==PLEO_TOC_PROPERTY) {
             for (int j=0; j<entry_count; j++,toc_entry++)
-              if ((toc_entry->entry_ofs>0) && (toc_entry->entry_ofs<rdlen) && (toc_entry->entry_len>0))
-                m_toc_refinfo[i].resource_list->add_new_element(toc_entry->entry_name, &binfile[toc_entry->entry_ofs], 4);
+              if ((toc_entry->entry_ofs>0) && (toc_entry->entry_ofs<=rdlen-4) && (toc_entry->entry_len>0))
+                add_archive_element(m_toc_refinfo[i].resource_list, toc_entry->entry_name, &binfile[toc_entry->entry_ofs], 4, flags);
               else m_toc_refinfo[i].resource_list->add_filler();
           }
           else {
             for (int j=0; j<entry_count; j++,toc_entry++)
-              if ((toc_entry->entry_ofs>0) && (toc_entry->entry_ofs<rdlen) && (toc_entry->entry_len>0))
-                m_toc_refinfo[i].resource_list->add_new_element(toc_entry->entry_name, &binfile[toc_entry->entry_ofs], toc_entry->entry_len);
+              if ((toc_entry->entry_ofs>0) && (toc_entry->entry_ofs<rdlen) && (toc_entry->entry_len>0) && (toc_entry->entry_len<=rdlen-toc_entry->entry_ofs))
+                add_archive_element(m_toc_refinfo[i].resource_list, toc_entry->entry_name, &binfile[toc_entry->entry_ofs], toc_entry->entry_len, flags);
               else m_toc_refinfo[i].resource_list->add_filler();
           }
       }
@@ -197,13 +322,59 @@ int pleo_archive_type::read_archive_image (const char *targetfile, unsigned char
 
 
 
+//
+// Find earlier element with identical content (for PLEO_ARCHIVE_FLAG_DEDUP)...
+//
+static int find_duplicate_element(pleo_resource_type *rl, int index)
+{
+  if (rl->m_resource_list[index].m_element_size<MIN_ELEMENT_DATALEN) return -1;
+  if (rl->load_element(index)==NULL) return -1;
+  int dupindex = rl->find_element_index(&rl->m_resource_list[index]);
+  return (dupindex<index) ? dupindex : -1;
+}
+
+
+
+//
+// Generate table-of-contents record for an element...
+//
+static void fill_toc_entry(int resource_index, resource_type *res, pleo_archive_toc_entrytype *toc_entry)
+{
+  if (res->m_toc_offset == 0) { // filler
+    memset (toc_entry, 0, sizeof(pleo_archive_toc_entrytype));
+    toc_entry->entry_ofs = 0xFFFFFFFF;
+  }
+  else {
+    memcpy (toc_entry->entry_name, res->m_element_name, sizeof(toc_entry->entry_name));
+    toc_entry->entry_ofs = res->m_toc_offset;
+
+    if (resource_index==PLEO_TOC_PROPERTY)
+      toc_entry->entry_len = strlen(res->m_element_name); // namelen versas datalen for other resources
+    else toc_entry->entry_len = res->m_element_size;
+  }
+}
+
+
+
 //
 // Compute amount of memory needed to store archive...
 //
 int pleo_archive_type::compute_archive_filesize (int flags)
+  {return layout_archive(flags);}
+
+
+
+//
+// Assign archive offsets to every element (m_toc_offset) & to each
+// resource type's TOC block (m_toc_refinfo[].binofs).  Accounts for each
+// byte in budget if given (entries array sized by caller).  Returns total
+// archive size...
+//
+int pleo_archive_type::layout_archive (int flags, pleo_archive_budgettype *budget)
 {
   int i,j;
   int count=0;
+  int entry_count=0;
   pleo_resource_type *rl;
 
   // Header...
@@ -214,37 +385,101 @@ int pleo_archive_type::compute_archive_filesize (int flags)
 
   // Size record...
   count += sizeof(pleo_archive_sizetype);
+  if (budget) budget->header = count;
 
 
   // Resource entries...
   for (i=0; i<MAX_RESOURCE_TYPES; i++)
     if (rl = m_toc_refinfo[i].resource_list) {
+      pleo_archive_budget_sectiontype *section = budget ? &budget->sections[i] : NULL;
+
       // Align to 512 byte boundary...
-      if (count & 0x1FF) count += 0x200-(count & 0x1FF); 
+      if (count & 0x1FF) {
+        if (section) section->section_padding = 0x200-(count & 0x1FF);
+        count += 0x200-(count & 0x1FF); 
+      }
       int align = g_resource_info[i].archive_alignment;
       for (j=0; j<(rl->m_count); j++) {
-        if (count & (align-1)) count += align-(count & (align-1)); 
-        count += rl->m_resource_list[j].m_element_size;
+        int padding = (count & (align-1)) ? align-(count & (align-1)) : 0;
+        count += padding;
+        resource_type *res = &rl->m_resource_list[j];
+        int dupindex = ((flags & PLEO_ARCHIVE_FLAG_DEDUP) || budget) ? find_duplicate_element(rl,j) : -1;
+
+        if (budget) {
+          pleo_archive_budget_entrytype *entry = &budget->entries[entry_count++];
+          entry->resource_index = i;
+          entry->element_index = j;
+          entry->size = res->m_element_size;
+          entry->payload = ((dupindex>=0) && (flags & PLEO_ARCHIVE_FLAG_DEDUP)) ? 0 : res->m_element_size;
+          entry->padding = padding;
+          entry->duplicate_of = dupindex;
+          section->count++;
+          section->payload += entry->payload;
+          section->element_padding += padding;
+          if (dupindex>=0) section->duplicate_bytes += res->m_element_size;
+        }
+
+        if ((dupindex>=0) && (flags & PLEO_ARCHIVE_FLAG_DEDUP)) {
+          res->m_toc_offset = rl->m_resource_list[dupindex].m_toc_offset; // payload shared
+          continue;
+        }
+        res->m_toc_offset = (res->m_element_size>0) ? count : 0xFFFFFFFF;
+        count += res->m_element_size;
       }
     }
 
   // TOC entries...
-  if (count & 0x1FF) count += 0x200-(count & 0x1FF); // align to 512 byte boundary
+  if (count & 0x1FF) { // align to 512 byte boundary
+    if (budget) budget->toc_padding = 0x200-(count & 0x1FF);
+    count += 0x200-(count & 0x1FF);
+  }
   for (i=0; i<MAX_RESOURCE_TYPES; i++)
     if (rl = m_toc_refinfo[i].resource_list) {
-      count += sizeof(pleo_archive_toctype); // toc header
-      for (j=0; j<(rl->m_count); j++) count += sizeof(pleo_archive_toc_entrytype); // toc entries
+      m_toc_refinfo[i].binofs = count;
+      int toclen = sizeof(pleo_archive_toctype); // toc header
+      for (j=0; j<(rl->m_count); j++) toclen += sizeof(pleo_archive_toc_entrytype); // toc entries
+      if (budget) budget->sections[i].toc = toclen;
+      count += toclen;
     }
 
   // Alder32 CRC entry...
+  int crcofs = count;
   if (count & 7) count += 8-(count & 7); // align to 8 byte boundary
   count += sizeof(pleo_archive_crctype);
+  if (budget) {
+    budget->crc = count-crcofs;
+    budget->total = count;
+    budget->entry_count = entry_count;
+  }
 
   return count;
 }
 
 
 
+//
+// Break archive size down by resource type & element (see
+// pleo_archive_budgettype).  Elements are loaded to find duplicates.
+// Element offsets are left as for flags...
+//
+bool pleo_archive_type::report_archive_budget (pleo_archive_budgettype *budget, int flags)
+{
+  memset (budget, 0, sizeof(pleo_archive_budgettype));
+
+  int entry_count=0;
+  for (int i=0; i<MAX_RESOURCE_TYPES; i++)
+    if (m_toc_refinfo[i].resource_list) entry_count += m_toc_refinfo[i].resource_list->m_count;
+  budget->entries = (pleo_archive_budget_entrytype *)malloc(sizeof(pleo_archive_budget_entrytype)*(entry_count ? entry_count : 1));
+  if (budget->entries==NULL) return false;
+  memset (budget->entries, 0, sizeof(pleo_archive_budget_entrytype)*(entry_count ? entry_count : 1));
+
+  budget->dedup_savings = layout_archive(flags & ~PLEO_ARCHIVE_FLAG_DEDUP) - layout_archive(flags | PLEO_ARCHIVE_FLAG_DEDUP);
+  layout_archive(flags, budget);
+  return true;
+}
+
+
+
 //
 // Write Pleo resource archive to memory image...
 //
@@ -304,9 +539,17 @@ unsigned char *pleo_archive_type::write_archive_image (const char *targetfile, i
         }
         
         int esize = rl->m_resource_list[j].m_element_size;
-        if (esize>0) {
+        int dupindex = (flags & PLEO_ARCHIVE_FLAG_DEDUP) ? find_duplicate_element(rl,j) : -1;
+        if (dupindex>=0)
+          rl->m_resource_list[j].m_toc_offset = rl->m_resource_list[dupindex].m_toc_offset;
+        else if (esize>0) {
+          unsigned char *dataptr = rl->load_element(j);
+          if (dataptr==NULL) {
+            delete [] wrdata;
+            return NULL;
+          }
           rl->m_resource_list[j].m_toc_offset = wrofs;
-          memcpy (&wrdata[wrofs], rl->m_resource_list[j].m_element, esize);
+          memcpy (&wrdata[wrofs], dataptr, esize);
           wrofs += esize;
         }
         else rl->m_resource_list[j].m_toc_offset = 0xFFFFFFFF;
@@ -339,18 +582,7 @@ unsigned char *pleo_archive_type::write_archive_image (const char *targetfile, i
         pleo_archive_toc_entrytype *toc_entry = (pleo_archive_toc_entrytype *)&wrdata[wrofs];
         wrofs += sizeof(pleo_archive_toc_entrytype);
 
-        if (rl->m_resource_list[j].m_toc_offset == 0) { // filler
-          memset (toc_entry, 0, sizeof(pleo_archive_toc_entrytype));
-          toc_entry->entry_ofs = 0xFFFFFFFF;
-        }
-        else {
-          memcpy (toc_entry->entry_name, rl->m_resource_list[j].m_element_name, sizeof(toc_entry->entry_name));
-          toc_entry->entry_ofs = rl->m_resource_list[j].m_toc_offset;
-
-          if (i==PLEO_TOC_PROPERTY)
-            toc_entry->entry_len = strlen(rl->m_resource_list[j].m_element_name); // namelen versas datalen for other resources
-          else toc_entry->entry_len = rl->m_resource_list[j].m_element_size;
-        }
+        fill_toc_entry (i, &rl->m_resource_list[j], toc_entry);
       }
     }
 
@@ -396,14 +628,12 @@ unsigned char *pleo_archive_type::write_archive_image (const char *targetfile, i
 #define NMAX 5552
 // NMAX is the largest n such that 255n(n+1)/2 + (n+1)(BASE-1) <= 2^32-1
 
-unsigned int pleo_archive_type::adler32(unsigned int adler, unsigned char *buf, unsigned int len)
+static unsigned int adler32_scalar(unsigned int adler, const unsigned char *buf, unsigned int len)
 {
     unsigned long s1 = adler & 0xffff;
     unsigned long s2 = (adler >> 16) & 0xffff;
     int k;
 
-    if (buf == NULL) return 1L;
-
     while (len > 0) {
         k = len < NMAX ? len : NMAX;
         len -= k;
@@ -423,9 +653,370 @@ unsigned int pleo_archive_type::adler32(unsigned int adler, unsigned char *buf,
 }
 
 
+// =========================================================================
+// Vectorised Adler-32 (SSE2 / AVX2), selected at runtime.
+//
+// Each block of W bytes adds W*s1 (s1 at block start) plus the bytes
+// weighted W..1 to s2.  Per-block s1 values are accumulated in vector
+// lanes and folded into s2 once per NMAX-sized chunk.
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ADLER32_SIMD
+#include <immintrin.h>
+
+#define NMAX_SIMD 5536 // largest multiple of 32 not above NMAX
+
+__attribute__((target("sse2")))
+static unsigned long long adler32_hsum_sse2(__m128i v)
+{
+  unsigned int lanes[4];
+  _mm_storeu_si128((__m128i*)lanes, v);
+  return (unsigned long long)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+__attribute__((target("sse2")))
+static unsigned int adler32_sse2(unsigned int adler, const unsigned char *buf, unsigned int len)
+{
+  unsigned long long s1 = adler & 0xffff;
+  unsigned long long s2 = (adler >> 16) & 0xffff;
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i weights_hi = _mm_setr_epi16(16,15,14,13,12,11,10,9);
+  const __m128i weights_lo = _mm_setr_epi16(8,7,6,5,4,3,2,1);
+
+  while (len >= 16) {
+    unsigned int blocks = (len < NMAX_SIMD ? len : NMAX_SIMD) / 16;
+    len -= blocks*16;
+    s2 += s1 * 16 * blocks;
+
+    __m128i vs1 = zero, vs2 = zero, vps = zero;
+    for (unsigned int k=0; k<blocks; k++, buf += 16) {
+      __m128i bytes = _mm_loadu_si128((const __m128i*)buf);
+      vps = _mm_add_epi32(vps, vs1);
+      vs1 = _mm_add_epi32(vs1, _mm_sad_epu8(bytes, zero));
+      vs2 = _mm_add_epi32(vs2, _mm_madd_epi16(_mm_unpacklo_epi8(bytes, zero), weights_hi));
+      vs2 = _mm_add_epi32(vs2, _mm_madd_epi16(_mm_unpackhi_epi8(bytes, zero), weights_lo));
+    }
+
+    s2 += 16*adler32_hsum_sse2(vps) + adler32_hsum_sse2(vs2);
+    s1 += adler32_hsum_sse2(vs1);
+    s1 %= BASE;
+    s2 %= BASE;
+  }
+  return adler32_scalar((unsigned int)((s2 << 16) | s1), buf, len);
+}
+
+__attribute__((target("avx2")))
+static unsigned long long adler32_hsum_avx2(__m256i v)
+{
+  unsigned int lanes[8];
+  _mm256_storeu_si256((__m256i*)lanes, v);
+  unsigned long long sum = 0;
+  for (int i=0; i<8; i++) sum += lanes[i];
+  return sum;
+}
+
+__attribute__((target("avx2")))
+static unsigned int adler32_avx2(unsigned int adler, const unsigned char *buf, unsigned int len)
+{
+  unsigned long long s1 = adler & 0xffff;
+  unsigned long long s2 = (adler >> 16) & 0xffff;
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i weights_hi = _mm256_setr_epi16(32,31,30,29,28,27,26,25,24,23,22,21,20,19,18,17);
+  const __m256i weights_lo = _mm256_setr_epi16(16,15,14,13,12,11,10,9,8,7,6,5,4,3,2,1);
+
+  while (len >= 32) {
+    unsigned int blocks = (len < NMAX_SIMD ? len : NMAX_SIMD) / 32;
+    len -= blocks*32;
+    s2 += s1 * 32 * blocks;
+
+    __m256i vs1 = zero, vs2 = zero, vps = zero;
+    for (unsigned int k=0; k<blocks; k++, buf += 32) {
+      __m256i bytes = _mm256_loadu_si256((const __m256i*)buf);
+      vps = _mm256_add_epi32(vps, vs1);
+      vs1 = _mm256_add_epi32(vs1, _mm256_sad_epu8(bytes, zero));
+      __m256i lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes));
+      __m256i hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1));
+      vs2 = _mm256_add_epi32(vs2, _mm256_madd_epi16(lo, weights_hi));
+      vs2 = _mm256_add_epi32(vs2, _mm256_madd_epi16(hi, weights_lo));
+    }
+
+    s2 += 32*adler32_hsum_avx2(vps) + adler32_hsum_avx2(vs2);
+    s1 += adler32_hsum_avx2(vs1);
+    s1 %= BASE;
+    s2 %= BASE;
+  }
+  return adler32_sse2((unsigned int)((s2 << 16) | s1), buf, len);
+}
+#endif // ADLER32_SIMD
+
 
 //
-// Write Pleo resource archive file...
+// Adjust Adler32 of a total_len byte stream for len bytes replaced at ofs.
+// A byte at position p adds to s1 once & to s2 (total_len-p) times...
+//
+static unsigned int adler32_patch(unsigned int adler, unsigned int total_len, unsigned int ofs, const unsigned char *olddata, const unsigned char *newdata, unsigned int len)
+{
+  long long s1 = adler & 0xffff;
+  long long s2 = (adler >> 16) & 0xffff;
+  for (unsigned int i=0; i<len; i++) {
+    int delta = (int)newdata[i] - (int)olddata[i];
+    if (delta==0) continue;
+    s1 += delta;
+    s2 += (long long)delta * ((total_len - ofs - i) % BASE);
+  }
+  s1 %= BASE; if (s1<0) s1 += BASE;
+  s2 %= BASE; if (s2<0) s2 += BASE;
+  return (unsigned int)((s2 << 16) | s1);
+}
+
+
+typedef unsigned int (*adler32_func_type)(unsigned int adler, const unsigned char *buf, unsigned int len);
+
+static adler32_func_type select_adler32()
+{
+#ifdef ADLER32_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return adler32_avx2;
+  if (__builtin_cpu_supports("sse2")) return adler32_sse2;
+#endif
+  return adler32_scalar;
+}
+
+static adler32_func_type g_adler32 = select_adler32();
+
+
+unsigned int pleo_archive_type::adler32(unsigned int adler, unsigned char *buf, unsigned int len)
+{
+  if (buf == NULL) return 1L;
+  return g_adler32(adler, buf, len);
+}
+
+
+
+#ifndef _WIN32
+//
+// Gathers archive output into writev batches, keeping a running Adler32.
+// Element payloads are referenced in place; headers, TOC records, padding
+// & lazy payloads read from the archive file are staged in a small buffer...
+//
+#define ARCHIVE_STREAM_IOVMAX 64
+#define ARCHIVE_STREAM_STAGELEN 4096
+
+struct archive_stream_type {
+  int fd;
+  int offset;
+  unsigned int adler;
+  bool failed;
+  struct iovec iov[ARCHIVE_STREAM_IOVMAX];
+  int iovcnt;
+  unsigned char stage[ARCHIVE_STREAM_STAGELEN];
+  int stagelen;
+
+  archive_stream_type(int target_fd) {
+    fd = target_fd;
+    offset = 0;
+    adler = 0;
+    failed = false;
+    iovcnt = 0;
+    stagelen = 0;
+  }
+
+  bool flush() {
+    struct iovec *vec = iov;
+    int count = iovcnt;
+    while ((count>0) && !failed) {
+      ssize_t written = writev(fd, vec, count);
+      if (written<0) {
+        if (errno==EINTR) continue;
+        failed = true;
+        break;
+      }
+      // Skip fully written vectors, trim partially written one...
+      while ((count>0) && (written >= (ssize_t)vec->iov_len)) {
+        written -= vec->iov_len;
+        vec++;
+        count--;
+      }
+      if (count>0) {
+        vec->iov_base = (char *)vec->iov_base + written;
+        vec->iov_len -= written;
+      }
+    }
+    iovcnt = 0;
+    stagelen = 0;
+    return !failed;
+  }
+
+  void add_iov(const void *data, int len) {
+    if (iovcnt==ARCHIVE_STREAM_IOVMAX) flush();
+    iov[iovcnt].iov_base = (void *)data;
+    iov[iovcnt].iov_len = len;
+    iovcnt++;
+  }
+
+  // Reference data in place (must stay valid until flushed)...
+  void put_ref(const unsigned char *data, int len) {
+    if (len<=0) return;
+    adler = g_adler32(adler, data, len);
+    offset += len;
+    add_iov(data, len);
+  }
+
+  // Append small data to stage buffer (copied when data non-NULL, else '0' filled)...
+  void put_copy(const void *data, int len) {
+    if (len<=0) return;
+    if ((stagelen+len > ARCHIVE_STREAM_STAGELEN) || (iovcnt==ARCHIVE_STREAM_IOVMAX)) flush();
+    unsigned char *dest = &stage[stagelen];
+    if (data) memcpy (dest, data, len);
+    else memset (dest, '0', len);
+    add_stage(dest, len);
+  }
+
+  // Read data from another file straight into stage buffer, a chunk at a time...
+  bool put_file(int src_fd, int src_ofs, int len) {
+    while ((len>0) && !failed) {
+      if ((stagelen==ARCHIVE_STREAM_STAGELEN) || (iovcnt==ARCHIVE_STREAM_IOVMAX)) flush();
+      int chunk = ARCHIVE_STREAM_STAGELEN-stagelen;
+      if (chunk>len) chunk = len;
+      unsigned char *dest = &stage[stagelen];
+      ssize_t result = pread(src_fd, dest, chunk, src_ofs);
+      if ((result<0) && (errno==EINTR)) continue;
+      if (result<=0) return false;
+      add_stage(dest, result);
+      src_ofs += result;
+      len -= result;
+    }
+    return !failed;
+  }
+
+  // Account for data just placed in stage buffer...
+  void add_stage(unsigned char *dest, int len) {
+    stagelen += len;
+    adler = g_adler32(adler, dest, len);
+    offset += len;
+    // Extend previous vector if contiguous...
+    if ((iovcnt>0) && ((unsigned char *)iov[iovcnt-1].iov_base + iov[iovcnt-1].iov_len == dest))
+      iov[iovcnt-1].iov_len += len;
+    else add_iov(dest, len);
+  }
+
+  void pad(int alignment) {
+    if (offset & (alignment-1)) put_copy(NULL, alignment-(offset & (alignment-1)));
+  }
+};
+
+
+
+//
+// Write Pleo resource archive straight to file descriptor, without building
+// the image in memory.  Returns archive length, or -1 on error...
+//
+int pleo_archive_type::write_archive_stream (int fd, int flags)
+{
+  int i,j;
+  pleo_resource_type *rl;
+
+  // Assign every offset up front, so header & TOC can be streamed in order...
+  int imagesize = layout_archive(flags);
+  archive_stream_type stream(fd);
+
+  // Header...
+  pleo_archive_hdrtype hdr;
+  memcpy (hdr.m_signature, PLEO_ARCHIVE_SIGNATURE, sizeof(hdr.m_signature));
+  hdr.m_format = 1;
+  time (&(hdr.m_buildtime)); // time in seconds
+  hdr.m_version = 0;
+  stream.put_copy (&hdr, sizeof(hdr));
+
+  // TOC offset records...
+  for (i=0; i<MAX_RESOURCE_TYPES; i++) {
+    pleo_archive_toctype toc;
+    memcpy (toc.m_toc_signature, g_resource_info[i].signature, sizeof(toc.m_toc_signature));
+    toc.m_toc_offset = (m_toc_refinfo[i].resource_list) ? m_toc_refinfo[i].binofs : 0;
+    stream.put_copy (&toc, sizeof(toc));
+  }
+
+  // Size record...
+  pleo_archive_sizetype sizerec;
+  memcpy (sizerec.m_size_signature, PLEO_ARCHIVE_SIZE_SIGNATURE, sizeof(sizerec.m_size_signature));
+  sizerec.m_size = imagesize-sizeof(pleo_archive_crctype);
+  stream.put_copy (&sizerec, sizeof(sizerec));
+
+  // Resource entries (each resource type padded to 512 byte boundary)...
+  for (i=0; i<MAX_RESOURCE_TYPES; i++)
+    if ((rl = m_toc_refinfo[i].resource_list)) {
+      stream.pad (0x200);
+      int align = g_resource_info[i].archive_alignment;
+      for (j=0; j<(rl->m_count); j++) {
+        stream.pad (align);
+        resource_type *res = &rl->m_resource_list[j];
+        if ((res->m_element_size>0) && ((int)res->m_toc_offset == stream.offset)) {
+          // Lazy elements are copied from the archive file, not loaded into the pool...
+          if (res->m_element_flags & RESOURCE_ELEMENT_LAZY) {
+            if ((rl->m_lazy_fd<0) || !stream.put_file(rl->m_lazy_fd, res->m_file_offset, res->m_element_size)) return -1;
+          }
+          else stream.put_ref (res->m_element, res->m_element_size);
+        }
+      }
+    }
+
+  // TOC...
+  stream.pad (0x200);
+  for (i=0; i<MAX_RESOURCE_TYPES; i++)
+    if ((rl = m_toc_refinfo[i].resource_list)) {
+      if (m_toc_refinfo[i].binofs != stream.offset) return -1; // layout mismatch
+
+      pleo_archive_toctype toc;
+      memcpy (toc.m_toc_signature, g_resource_info[i].signature, sizeof(toc.m_toc_signature));
+      toc.m_toc_offset = sizeof(pleo_archive_toc_entrytype)*(rl->m_count);
+      stream.put_copy (&toc, sizeof(toc));
+
+      for (j=0; j<(rl->m_count); j++) {
+        pleo_archive_toc_entrytype toc_entry;
+        memset (&toc_entry, 0, sizeof(toc_entry));
+        fill_toc_entry (i, &rl->m_resource_list[j], &toc_entry);
+        stream.put_copy (&toc_entry, sizeof(toc_entry));
+      }
+    }
+
+  // Alder32 CRC (aligned to 8 byte boundary)...
+  stream.pad (8);
+  if (stream.offset != (int)(imagesize-sizeof(pleo_archive_crctype))) return -1;
+
+  pleo_archive_crctype crc;
+  memcpy (crc.m_crc_signature, PLEO_ARCHIVE_CRC_SIGNATURE, sizeof(crc.m_crc_signature));
+  crc.m_crc = stream.adler;
+  stream.put_copy (&crc, sizeof(crc));
+
+  if (!stream.flush()) return -1;
+  return stream.offset;
+}
+#endif
+
+
+
+//
+// Drop pool space replaced & removed elements left behind, in every resource
+// list.  Moves pooled element data, so pointers from get_element_dataptr are
+// no longer valid; never done implicitly (writing leaves the archive as is)...
+//
+bool pleo_archive_type::compact_pools()
+{
+  bool ok = true;
+  for (int i=0; i<MAX_RESOURCE_TYPES; i++)
+    if (m_toc_refinfo[i].resource_list && !m_toc_refinfo[i].resource_list->compact_pool()) ok = false;
+  return ok;
+}
+
+
+
+//
+// Write Pleo resource archive file.  Streamed to a unique "<target>.XXXXXX"
+// beside it & renamed over the target once complete, so mapped resources read
+// from the file being replaced stay valid & a failed write never destroys the
+// original.  A symlinked target has the file it points at replaced (the link
+// is kept) & the new file takes the old one's mode & owner.  Other hard links
+// to the old file keep the old contents...
 //
 int pleo_archive_type::write_archive_file (const char *targetfile, int flags)
 {
@@ -433,6 +1024,58 @@ int pleo_archive_type::write_archive_file (const char *targetfile, int flags)
   if (targetfile==NULL) return -1;
   if (targetfile[0]==0) return -1;
 
+#ifndef _WIN32
+  // Write through symlinks to the file they point at...
+  struct stat st;
+  bool exists = (lstat(targetfile, &st)==0);
+  char *resolved = NULL;
+  if (exists && S_ISLNK(st.st_mode)) {
+    resolved = realpath(targetfile, NULL);
+    if ((resolved==NULL) || (stat(resolved, &st) != 0)) { // dangling link
+      free (resolved);
+      return -1;
+    }
+    targetfile = resolved;
+  }
+
+  int templen = strlen(targetfile)+8;
+  char *tempfile = (char *)malloc(templen);
+  if (tempfile==NULL) {
+    free (resolved);
+    return -1;
+  }
+  snprintf (tempfile, templen, "%s.XXXXXX", targetfile);
+
+  // Create temporary file (O_EXCL, 0600) & give it the target's permissions...
+  int fd = mkstemp(tempfile);
+  if (fd<0) {
+    free (tempfile);
+    free (resolved);
+    return -1;
+  }
+  bool ok = true;
+  if (exists) {
+    if (fchown(fd, st.st_uid, st.st_gid) != 0) {} // best effort, needs privilege
+    ok = (fchmod(fd, st.st_mode & 07777)==0);
+  }
+  else {
+    mode_t mask = umask(0);
+    umask (mask);
+    ok = (fchmod(fd, 0666 & ~mask)==0);
+  }
+
+  // Stream archive to temporary file...
+  if (ok && (write_archive_stream(fd, flags)<=0)) ok = false;
+  if (ok && (fsync(fd) != 0)) ok = false;
+  if (close(fd) != 0) ok = false;
+
+  // Replace target (or discard partial file)...
+  if (ok && (rename(tempfile, targetfile) != 0)) ok = false;
+  if (!ok) unlink (tempfile);
+  free (tempfile);
+  free (resolved);
+  return ok ? 1 : -1;
+#else
   // Generate archive image...
   int imagelen;
   unsigned char *dataptr = write_archive_image (targetfile, &imagelen, flags);
@@ -448,8 +1091,428 @@ int pleo_archive_type::write_archive_file (const char *targetfile, int flags)
   // Save image to file...
   int writelen = fwrite (dataptr, 1, imagelen, fileid);
 
-  // Cleanup...
-  fclose (fileid);
+  // Cleanup (partial file removed)...
+  bool ok = (fclose(fileid)==0) && (writelen==imagelen);
   delete [] dataptr;
-  return (writelen==imagelen);
+  if (!ok) remove (targetfile);
+  return ok ? 1 : -1;
+#endif
+}
+
+
+
+#ifndef _WIN32
+static bool pread_all(int fd, void *buf, int len, int ofs)
+{
+  unsigned char *ptr = (unsigned char *)buf;
+  while (len>0) {
+    ssize_t result = pread(fd, ptr, len, ofs);
+    if ((result<0) && (errno==EINTR)) continue;
+    if (result<=0) return false;
+    ptr += result; ofs += result; len -= result;
+  }
+  return true;
+}
+
+
+static bool pwrite_all(int fd, const void *buf, int len, int ofs)
+{
+  const unsigned char *ptr = (const unsigned char *)buf;
+  while (len>0) {
+    ssize_t result = pwrite(fd, ptr, len, ofs);
+    if ((result<0) && (errno==EINTR)) continue;
+    if (result<=0) return false;
+    ptr += result; ofs += result; len -= result;
+  }
+  return true;
+}
+
+
+//
+// Patch 4-byte field within checksummed region & queue write...
+//
+static unsigned int patch_archive_field(int fd, unsigned int adler, unsigned int total_len, int ofs, unsigned int old_value, unsigned int new_value, bool *ok)
+{
+  if (!pwrite_all(fd, &new_value, sizeof(new_value), ofs)) *ok = false;
+  return adler32_patch(adler, total_len, ofs, (unsigned char *)&old_value, (unsigned char *)&new_value, sizeof(new_value));
+}
+
+
+//
+// Archive layout as found on disk (header records & whole TOC region)...
+//
+struct archive_ondisk_type {
+  int filesize;
+  int recpos[MAX_RESOURCE_TYPES]; // file offset of per-type TOC offset record
+  int tocpos[MAX_RESOURCE_TYPES]; // file offset of per-type TOC block (-1 = none)
+  int sizepos;                    // file offset of SIZE record
+  int expected_size;              // SIZE value (offset of ADLR record)
+  unsigned int crc;
+  int toc_start;
+  int toc_len;
+  unsigned char *tocbuf;          // [toc_start, expected_size)
+
+  pleo_archive_toctype *get_block(int i)
+    {return (pleo_archive_toctype *)&tocbuf[tocpos[i]-toc_start];}
+  pleo_archive_toc_entrytype *get_entries(int i)
+    {return (pleo_archive_toc_entrytype *)&tocbuf[tocpos[i]-toc_start+sizeof(pleo_archive_toctype)];}
+  int get_entry_count(int i)
+    {return (tocpos[i]<0) ? 0 : get_block(i)->m_toc_offset/sizeof(pleo_archive_toc_entrytype);}
+};
+
+
+static int read_archive_ondisk(int fd, pleo_archive_type *archive, archive_ondisk_type *disk)
+{
+  int i;
+  struct stat st;
+  disk->tocbuf = NULL;
+  if (fstat(fd,&st) != 0) return -1;
+  disk->filesize = st.st_size;
+
+  // Header & TOC offset records all precede the first 512-byte section...
+  unsigned char hdrbuf[0x200];
+  int hdrlen = (disk->filesize < (int)sizeof(hdrbuf)) ? disk->filesize : sizeof(hdrbuf);
+  if (hdrlen < (int)(sizeof(pleo_archive_hdrtype)+sizeof(pleo_archive_sizetype))) return -2;
+  if (!pread_all(fd, hdrbuf, hdrlen, 0)) return -1;
+  if (strncmp(((pleo_archive_hdrtype*)hdrbuf)->m_signature,PLEO_ARCHIVE_SIGNATURE,4) != 0) return -2;
+
+  for (i=0; i<MAX_RESOURCE_TYPES; i++) disk->recpos[i] = disk->tocpos[i] = -1;
+  int rdofs = sizeof(pleo_archive_hdrtype);
+  for (;;) {
+    if ((rdofs + (int)sizeof(pleo_archive_toctype)) > hdrlen) return -2;
+    pleo_archive_toctype *toc = (pleo_archive_toctype*)(&hdrbuf[rdofs]);
+    if (strncmp(toc->m_toc_signature, PLEO_ARCHIVE_SIZE_SIGNATURE, 4)==0) break;
+    int resource_index = archive->get_resource_type(&hdrbuf[rdofs]);
+    if ((resource_index>=0) && (toc->m_toc_offset>0)) {
+      disk->recpos[resource_index] = rdofs;
+      disk->tocpos[resource_index] = toc->m_toc_offset;
+    }
+    rdofs += sizeof(pleo_archive_toctype);
+  }
+  disk->sizepos = rdofs;
+  disk->expected_size = ((pleo_archive_sizetype*)(&hdrbuf[rdofs]))->m_size;
+  if ((disk->expected_size<rdofs) || ((disk->expected_size+(int)sizeof(pleo_archive_crctype)) > disk->filesize)) return -2;
+
+  pleo_archive_crctype crc;
+  if (!pread_all(fd, &crc, sizeof(crc), disk->expected_size)) return -1;
+  if (strncmp(crc.m_crc_signature, PLEO_ARCHIVE_CRC_SIGNATURE, 4) != 0) return -2;
+  disk->crc = crc.m_crc;
+
+  // Read TOC region (from first TOC block up to the CRC)...
+  disk->toc_start = disk->expected_size;
+  for (i=0; i<MAX_RESOURCE_TYPES; i++)
+    if ((disk->tocpos[i]>=0) && (disk->tocpos[i]<disk->toc_start)) disk->toc_start = disk->tocpos[i];
+  if (disk->toc_start < (int)(disk->sizepos+sizeof(pleo_archive_sizetype))) return -2;
+  disk->toc_len = disk->expected_size - disk->toc_start;
+  disk->tocbuf = (unsigned char *)malloc(disk->toc_len+1);
+  if (disk->tocbuf==NULL) return -1;
+  if (!pread_all(fd, disk->tocbuf, disk->toc_len, disk->toc_start)) return -1;
+
+  // Validate TOC blocks...
+  for (i=0; i<MAX_RESOURCE_TYPES; i++)
+    if (disk->tocpos[i]>=0) {
+      if ((disk->tocpos[i]+(int)sizeof(pleo_archive_toctype)) > disk->expected_size) return -2;
+      if (archive->get_resource_type((unsigned char*)disk->get_block(i)) != i) return -2;
+      unsigned int blocklen = disk->get_block(i)->m_toc_offset;
+      if ((blocklen % sizeof(pleo_archive_toc_entrytype)) ||
+          (disk->tocpos[i]+sizeof(pleo_archive_toctype)+blocklen > (unsigned int)disk->expected_size)) return -2;
+    }
+  return 1;
+}
+
+
+//
+// Open Pleo resource archive reading only header & TOC.  Resources keep
+// their name & size; payloads are read from the file when first asked for
+// (get_element_dataptr), which keeps it open until init_archive.  Returns
+// as read_archive_image...
+//
+int pleo_archive_type::read_archive_toc (const char *targetfile, int flags)
+{
+  int i,j;
+  int fd = open(targetfile, O_RDONLY);
+  if (fd<0) return -1;
+
+  archive_ondisk_type disk;
+  int result = read_archive_ondisk(fd, this, &disk);
+
+  // Verify Adler32 trailer (reads whole file, in chunks)...
+  if ((result>0) && (flags & PLEO_ARCHIVE_FLAG_VERIFY)) {
+    unsigned char *buf = (unsigned char *)malloc(0x10000);
+    if (buf==NULL) result = -1;
+    unsigned int adler = 0;
+    for (int ofs=0; (result>0) && (ofs<disk.expected_size); ofs += 0x10000) {
+      int len = (disk.expected_size-ofs < 0x10000) ? disk.expected_size-ofs : 0x10000;
+      if (!pread_all(fd, buf, len, ofs)) result = -1;
+      else adler = adler32(adler, buf, len);
+    }
+    if ((result>0) && (adler != disk.crc)) result = -3;
+    if (buf) free (buf);
+  }
+
+  if (result<=0) {
+    if (disk.tocbuf) free (disk.tocbuf);
+    close (fd);
+    return result;
+  }
+
+  // Earlier lazy resources would lose their file...
+  if (m_lazy_fd>=0) {
+    for (i=0; i<MAX_RESOURCE_TYPES; i++)
+      if (m_toc_refinfo[i].resource_list) m_toc_refinfo[i].resource_list->load_all_elements();
+    close (m_lazy_fd);
+  }
+  m_lazy_fd = fd;
+
+  // Add resources (same validation as read_archive_image)...
+  unsigned int rdlen = disk.filesize;
+  for (i=0; i<MAX_RESOURCE_TYPES; i++) {
+    pleo_resource_type *rl = m_toc_refinfo[i].resource_list;
+    if (rl==NULL) continue;
+    rl->m_lazy_fd = fd;
+
+    int entry_count = disk.get_entry_count(i);
+    if ((entry_count<=0) || (entry_count>=MAX_RESOURCE_ENTRIES)) continue;
+    rl->reserve_elements(rl->m_count+entry_count);
+
+    pleo_archive_toc_entrytype *toc_entry = disk.get_entries(i);
+    for (j=0; j<entry_count; j++,toc_entry++) {
+      if (i==PLEO_TOC_PROPERTY) {
+        if ((toc_entry->entry_ofs>0) && (toc_entry->entry_ofs<=rdlen-4) && (toc_entry->entry_len>0))
+          rl->add_lazy_element(toc_entry->entry_name, toc_entry->entry_ofs, 4);
+        else rl->add_filler();
+      }
+      else {
+        if ((toc_entry->entry_ofs>0) && (toc_entry->entry_ofs<rdlen) && (toc_entry->entry_len>0) && (toc_entry->entry_len<=rdlen-toc_entry->entry_ofs))
+          rl->add_lazy_element(toc_entry->entry_name, toc_entry->entry_ofs, toc_entry->entry_len);
+        else rl->add_filler();
+      }
+    }
+  }
+
+  free (disk.tocbuf);
+  return true;
+}
+
+
+//
+// Rewrite payload in its existing slot (element data plus padding up to the
+// next payload)...
+//
+static int update_archive_inplace(int fd, archive_ondisk_type *disk, int resource_index, int entry_index, unsigned int slot_end, unsigned char *element_data, int element_datalen)
+{
+  pleo_archive_toc_entrytype *toc_entry = &disk->get_entries(resource_index)[entry_index];
+  int ofs = toc_entry->entry_ofs;
+  int slotlen = slot_end-ofs;
+  if ((slotlen<element_datalen) || (element_datalen<0)) return -2;
+  unsigned char *oldbuf = (unsigned char *)malloc(2*slotlen);
+  if (oldbuf==NULL) return -1;
+  unsigned char *newbuf = &oldbuf[slotlen];
+
+  if (!pread_all(fd, oldbuf, slotlen, ofs)) {
+    free (oldbuf);
+    return -1;
+  }
+  memcpy (newbuf, element_data, element_datalen);
+  memset (&newbuf[element_datalen], '0', slotlen-element_datalen);
+
+  unsigned int crc = adler32_patch(disk->crc, disk->expected_size, ofs, oldbuf, newbuf, slotlen);
+  bool ok = pwrite_all(fd, newbuf, slotlen, ofs);
+  free (oldbuf);
+
+  // TOC entry length (properties record name length instead)...
+  if (resource_index != PLEO_TOC_PROPERTY) {
+    int entrypos = disk->tocpos[resource_index]+sizeof(pleo_archive_toctype)+entry_index*sizeof(pleo_archive_toc_entrytype);
+    crc = patch_archive_field(fd, crc, disk->expected_size, entrypos+4, toc_entry->entry_len, element_datalen, &ok);
+  }
+
+  pleo_archive_crctype crcrec;
+  memcpy (crcrec.m_crc_signature, PLEO_ARCHIVE_CRC_SIGNATURE, sizeof(crcrec.m_crc_signature));
+  crcrec.m_crc = crc;
+  if (!pwrite_all(fd, &crcrec, sizeof(crcrec), disk->expected_size)) ok = false;
+  return ok ? 1 : -1;
+}
+
+
+//
+// Append payload as a tail section after the archive, followed by a
+// relocated TOC & new ADLR record, then point the header at them.  The tail
+// is on disk (fsync) before the header records change, & those are patched
+// with one write, so an interrupted update leaves the original archive.
+// Existing payloads are untouched; the old TOC is left as dead space...
+//
+static int update_archive_append(int fd, archive_ondisk_type *disk, int resource_index, int entry_index, const char *element_name, unsigned char *element_data, int element_datalen)
+{
+  int i;
+  int oldend = disk->expected_size+sizeof(pleo_archive_crctype);
+  int tailpos = oldend;
+  if (tailpos & 0x1FF) tailpos += 0x200-(tailpos & 0x1FF);
+  int new_toc_start = tailpos+element_datalen;
+  if (new_toc_start & 0x1FF) new_toc_start += 0x200-(new_toc_start & 0x1FF);
+
+  // Build relocated TOC (one entry larger when adding)...
+  int bufofs = new_toc_start-(tailpos+element_datalen);
+  int buflen = bufofs+disk->toc_len+sizeof(pleo_archive_toc_entrytype)+8+sizeof(pleo_archive_crctype);
+  unsigned char *newbuf = (unsigned char *)malloc(buflen);
+  if (newbuf==NULL) return -1;
+  memset (newbuf, '0', buflen);
+
+  int new_tocpos[MAX_RESOURCE_TYPES];
+  bool copied[MAX_RESOURCE_TYPES];
+  memset (copied, 0, sizeof(copied));
+  for (;;) {
+    // Copy blocks in their original order...
+    int next = -1;
+    for (i=0; i<MAX_RESOURCE_TYPES; i++)
+      if ((disk->tocpos[i]>=0) && !copied[i] && ((next<0) || (disk->tocpos[i]<disk->tocpos[next])))
+        next = i;
+    if (next<0) break;
+    copied[next] = true;
+
+    int count = disk->get_entry_count(next);
+    int blocklen = sizeof(pleo_archive_toctype)+count*sizeof(pleo_archive_toc_entrytype);
+    new_tocpos[next] = tailpos+element_datalen+bufofs;
+    memcpy (&newbuf[bufofs], disk->get_block(next), blocklen);
+    pleo_archive_toctype *block = (pleo_archive_toctype *)&newbuf[bufofs];
+    pleo_archive_toc_entrytype *entries = (pleo_archive_toc_entrytype *)&newbuf[bufofs+sizeof(pleo_archive_toctype)];
+    bufofs += blocklen;
+
+    if (next==resource_index) {
+      pleo_archive_toc_entrytype *toc_entry;
+      if (entry_index<0) {
+        toc_entry = &entries[count];
+        memset (toc_entry, 0, sizeof(pleo_archive_toc_entrytype));
+        int namelen = strlen(element_name);
+        memcpy (toc_entry->entry_name, element_name, (namelen<(int)sizeof(toc_entry->entry_name)) ? namelen : sizeof(toc_entry->entry_name));
+        block->m_toc_offset += sizeof(pleo_archive_toc_entrytype);
+        bufofs += sizeof(pleo_archive_toc_entrytype);
+      }
+      else toc_entry = &entries[entry_index];
+      toc_entry->entry_ofs = tailpos;
+      if (resource_index==PLEO_TOC_PROPERTY)
+        toc_entry->entry_len = strlen(element_name);
+      else toc_entry->entry_len = element_datalen;
+    }
+  }
+
+  // Align to 8 byte boundary before CRC...
+  int endpos = tailpos+element_datalen+bufofs;
+  if (endpos & 7) {
+    bufofs += 8-(endpos & 7);
+    endpos += 8-(endpos & 7);
+  }
+
+  // Header records as they'll be (TOC offsets & SIZE)...
+  int hdrpos = sizeof(pleo_archive_hdrtype);
+  int hdrlen = disk->sizepos+sizeof(pleo_archive_sizetype)-hdrpos;
+  unsigned char oldhdr[0x200], newhdr[0x200], padding[0x200];
+  bool ok = pread_all(fd, oldhdr, hdrlen, hdrpos);
+  memcpy (newhdr, oldhdr, hdrlen);
+  for (i=0; i<MAX_RESOURCE_TYPES; i++)
+    if (disk->tocpos[i]>=0)
+      memcpy (&newhdr[disk->recpos[i]+4-hdrpos], &new_tocpos[i], 4);
+  memcpy (&newhdr[disk->sizepos+4-hdrpos], &endpos, 4);
+
+  // Checksum: old stream & its ADLR record, padding & new tail, then the
+  // header records patched...
+  pleo_archive_crctype oldcrc;
+  memcpy (oldcrc.m_crc_signature, PLEO_ARCHIVE_CRC_SIGNATURE, sizeof(oldcrc.m_crc_signature));
+  oldcrc.m_crc = disk->crc;
+  memset (padding, '0', sizeof(padding));
+  unsigned int crc = g_adler32(disk->crc, (unsigned char *)&oldcrc, sizeof(oldcrc));
+  crc = g_adler32(crc, padding, tailpos-oldend);
+  crc = g_adler32(crc, element_data, element_datalen);
+  crc = g_adler32(crc, newbuf, bufofs);
+  crc = adler32_patch(crc, endpos, hdrpos, oldhdr, newhdr, hdrlen);
+
+  pleo_archive_crctype *crcrec = (pleo_archive_crctype *)&newbuf[bufofs];
+  memcpy (crcrec->m_crc_signature, PLEO_ARCHIVE_CRC_SIGNATURE, sizeof(crcrec->m_crc_signature));
+  crcrec->m_crc = crc;
+  bufofs += sizeof(pleo_archive_crctype);
+
+  // Tail first (past the archive's end), then the header...
+  if (ok && !pwrite_all(fd, padding, tailpos-oldend, oldend)) ok = false;
+  if (ok && !pwrite_all(fd, element_data, element_datalen, tailpos)) ok = false;
+  if (ok && !pwrite_all(fd, newbuf, bufofs, tailpos+element_datalen)) ok = false;
+  if (ok && (ftruncate(fd, tailpos+element_datalen+bufofs) != 0)) ok = false;
+  if (ok && (fsync(fd) != 0)) ok = false;
+  if (ok && !pwrite_all(fd, newhdr, hdrlen, hdrpos)) ok = false;
+  if (ok && (fsync(fd) != 0)) ok = false;
+  free (newbuf);
+  return ok ? 1 : -1;
+}
+#endif
+
+
+
+//
+// Replace (or add) a single resource in an archive file without rebuilding
+// it.  If the new data fits the existing slot (including alignment padding)
+// it is rewritten in place, otherwise it is appended as a tail section &
+// only the TOC is rewritten.  Only touched bytes are read to update the
+// Adler32 trailer.  Returns 1 on success, -1 on I/O error, -2 bad archive
+// or request...
+//
+int pleo_archive_type::update_archive_file (const char *targetfile, int resource_index, const char *element_name, unsigned char *element_data, int element_datalen, int /*flags*/)
+{
+#ifdef _WIN32
+  return -1;
+#else
+  int i,j;
+  if ((resource_index<0) || (resource_index>=MAX_RESOURCE_TYPES)) return -2;
+  if ((element_name==NULL) || (element_name[0]==0)) return -2;
+  if ((element_data==NULL) || (element_datalen<MIN_ELEMENT_DATALEN)) return -2;
+  if ((resource_index==PLEO_TOC_PROPERTY) && (element_datalen!=4)) return -2;
+
+  int fd = open(targetfile, O_RDWR);
+  if (fd<0) return -1;
+
+  archive_ondisk_type disk;
+  int result = read_archive_ondisk(fd, this, &disk);
+  if ((result>0) && (disk.tocpos[resource_index]<0)) result = -2; // no TOC block for resource type
+
+  if (result>0) {
+    // Find existing entry...
+    int count = disk.get_entry_count(resource_index);
+    pleo_archive_toc_entrytype *entries = disk.get_entries(resource_index);
+    int entry_index = -1;
+    for (j=0; j<count; j++)
+      if (strncmp(entries[j].entry_name, element_name, sizeof(entries[j].entry_name))==0) {
+        entry_index = j;
+        break;
+      }
+
+    // Slot runs to next payload (or TOC).  Fillers (offset 0xFFFFFFFF) & empty
+    // entries hold no payload.  Payloads shared by several entries aren't patched...
+    unsigned int slot_end = 0;
+    if (entry_index>=0) {
+      unsigned int ofs = entries[entry_index].entry_ofs;
+      bool shared = false;
+      if ((ofs>0) && (ofs<(unsigned int)disk.toc_start)) {
+        slot_end = disk.toc_start;
+        for (i=0; (i<MAX_RESOURCE_TYPES) && !shared; i++) {
+          pleo_archive_toc_entrytype *other = (disk.tocpos[i]>=0) ? disk.get_entries(i) : NULL;
+          for (int k=0; (k<disk.get_entry_count(i)) && !shared; k++) {
+            if ((i==resource_index) && (k==entry_index)) continue;
+            if ((other[k].entry_ofs==0xFFFFFFFF) || (other[k].entry_ofs==0) || (other[k].entry_len==0)) continue;
+            if (other[k].entry_ofs == ofs) shared = true;
+            else if ((other[k].entry_ofs > ofs) && (other[k].entry_ofs < slot_end)) slot_end = other[k].entry_ofs;
+          }
+        }
+      }
+      if (shared) slot_end = 0;
+    }
+    else if (count+1 >= MAX_RESOURCE_ENTRIES) result = -2;
+
+    if (result>0) {
+      if ((slot_end>0) && ((unsigned int)element_datalen <= slot_end-entries[entry_index].entry_ofs))
+        result = update_archive_inplace(fd, &disk, resource_index, entry_index, slot_end, element_data, element_datalen);
+      else result = update_archive_append(fd, &disk, resource_index, entry_index, element_name, element_data, element_datalen);
+    }
+  }
+
+  if (disk.tocbuf) free (disk.tocbuf);
+  if (close(fd) != 0) return -1;
+  return result;
+#endif
 }
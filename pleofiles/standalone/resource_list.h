@@ -29,6 +29,15 @@
 #define MIN_ELEMENT_DATALEN 4
 #define MAX_RESOURCE_NAMELEN 32
 
+// Element storage flags...
+#define RESOURCE_ELEMENT_OWNED    0x00 // element data malloc'd & freed by list
+#define RESOURCE_ELEMENT_BORROWED 0x01 // element data points into caller's image (never freed)
+#define RESOURCE_ELEMENT_HASHED   0x02 // m_content_hash valid
+#define RESOURCE_ELEMENT_POOLED   0x04 // element data in list's pool (freed by init_resource)
+#define RESOURCE_ELEMENT_LAZY     0x08 // element data still in archive file (see load_element)
+
+#define RESOURCE_POOL_BLOCKSIZE 0x10000 // default element pool block size
+
 
 //
 // Structure for tracking binary elements...
@@ -39,6 +48,20 @@ struct resource_type {
   int m_toc_offset; // offset within toc archive (when saved)...
   unsigned int m_element_size; // size of element data
   unsigned char *m_element;
+  int m_element_flags; // RESOURCE_ELEMENT_xxx
+  unsigned long long m_content_hash; // xxHash64 of element data (when hashed)
+  unsigned int m_file_offset; // offset within archive file (lazy elements)
+};
+
+
+
+//
+// Element pool block.  Bump allocated, all blocks freed together...
+//
+struct resource_pool_blocktype {
+  resource_pool_blocktype *m_next;
+  int m_size; // bytes of data following header
+  int m_used;
 };
 
 
@@ -53,12 +76,35 @@ public:
   int m_max_count;
   int m_count;
 
+  // Open-addressing name->index table (slot holds index+1, 0=empty)...
+  int *m_name_hash;
+  int m_name_hash_size; // power of 2
+  bool m_name_hash_dirty; // rebuilt on next lookup
+
+  // Open-addressing content->index table, built on first find_element_index...
+  int *m_content_hash;
+  int m_content_hash_size; // power of 2
+  bool m_content_hash_dirty;
+
+  // Element payload pool (head block is current).  Space of replaced &
+  // removed elements is counted in m_pool_stale until compact_pool...
+  resource_pool_blocktype *m_pool;
+  int m_pool_stale;
+
+  // Archive file lazy elements are fetched from (-1=none, owned by archive)...
+  int m_lazy_fd;
+
   // Operations...
   void init_resource();
+  bool reserve_elements(int count, int datalen=0);
   bool set_element_count(int new_count);
+  unsigned char *pool_alloc(int datalen);
+  bool compact_pool();
   void free_element(int index);
   int add_new_element(const char *element_name, unsigned char *m_element_data, int m_element_datalen, bool assume_ownership=false);
   int add_new_element(const char *element_name, resource_type *resource_ptr);
+  int add_borrowed_element(const char *element_name, unsigned char *m_element_data, int m_element_datalen);
+  int add_lazy_element(const char *element_name, unsigned int file_offset, int m_element_datalen);
   int update_element(const char *element_name, int index, unsigned char *m_element_data, int m_element_datalen, bool assume_ownership=false);
   int update_element(const char *element_name, unsigned char *m_element_data, int m_element_datalen, bool assume_ownership=false);
   int add_filler();
@@ -71,7 +117,14 @@ public:
     return 2; // valid
   }
 
+  unsigned char *load_element(int index);
+  bool load_all_elements();
   unsigned char *get_element_dataptr(int index, char *element_name=NULL, int *element_datalen=NULL);
+  bool rebuild_name_hash();
+  void insert_name_hash(int index);
+  unsigned long long get_element_hash(int index);
+  bool rebuild_content_hash();
+  void insert_content_hash(int index);
   int get_element_index(const char *element_name);
   int find_element_index(unsigned char *m_element_data, int m_element_datalen);
   int find_element_index(resource_type *resource_ptr);
@@ -29,63 +29,57 @@
 #include <sys/types.h>
 #include <dirent.h>
 #include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <sys/time.h>
 #include "pleoarchive.h"
 #include "resource_list.h"
+#include "../pleosound.h"
 
 void usage() {
      printf("urf_tool command archive [path]\n");
+     printf("urf_tool b path archive [archive ...]\n");
      printf("commands:\n");
      printf("\t l list contents\n");
      printf("\t x extract all files to path specified (current directory if none)\n");
-     printf("\t c create archive with contents of path specified\n");
+     printf("\t c create archive with contents of path specified (laid out as x extracts; sounds may also be .wav)\n");
+     printf("\t   urf_tool c archive path [list]: list names the files below path to pack, one per line\n");
+     printf("\t   (e.g. sounds/bark.UGSF), in resource ID order; without it every file is packed, by name\n");
+     printf("\t b batch extract archives in parallel, each into its own directory under path\n");
+     printf("\t s size budget per resource: payload, padding, TOC & possible savings (path: json (default) or csv)\n");
+}
+
+// Per resource type extraction directory & file extension (indexed by PLEO_TOC_xxx)...
+struct urf_type_info {
+  const char *dirname;
+  const char *extension;
+  const char *readable_name;
+};
+
+urf_type_info g_urf_types[MAX_RESOURCE_TYPES] = {
+  {"sounds",     PLEO_TOC_SOUND_SIGNATURE,    "Sound"},
+  {"motions",    PLEO_TOC_MTN_SIGNATURE,      "Motion"},
+  {"commands",   PLEO_TOC_COMMAND_SIGNATURE,  "Command"},
+  {"scripts",    "AMX",                       "Script"},
+  {"properties", PLEO_TOC_PROPERTY_SIGNATURE, "Propertie"}};
+
+double get_time() {
+     struct timeval tv;
+     gettimeofday(&tv,NULL);
+     return tv.tv_sec + tv.tv_usec/1000000.0;
 }
 
 bool endswith(char* s1, char* s2) {
      int s1_len = strlen(s1);
      int s2_len = strlen(s2);
+     if (s1_len<s2_len) return false;
      s1 += (s1_len-s2_len);
      if (strncmp(s1,s2,s2_len)==0) return true;
      return false;
 }
 
-#define CHUNK 1024
-
-/* Read the contents of a file into a buffer.  Return the size of the file 
- * and set buf to point to a buffer allocated with malloc that contains  
- * the file contents.
- */
-int read_file(char* filename, char **buf) 
-{
-  FILE* fp = fopen(filename,"rb");
-  int n, np,r;
-  char *b, *b2;
-
-  n = CHUNK;
-  np = n;
-  b = (char*)malloc(sizeof(char)*n);
-  
-  while ((r = fread(b, sizeof(char), CHUNK, fp)) > 0) {
-    n += r;
-    if (np - n < CHUNK) { 
-      np *= 2;                      // buffer is too small, the next read could overflow!
-      b2 = (char*)malloc(np*sizeof(char));
-      memcpy(b2, b, n * sizeof(char));
-      free(b);
-      b = b2;
-    }
-  }
-  *buf = b;
-  fclose(fp);
-  return n;
-}
-
-// strip off file extensions
-char* splitstr(char* s1, char* s2) {
-    char* retval=strtok(s1,s2);
-    retval[strlen(retval)-1]=(char)0;
-    return retval;
-}
-
 #define DUMP_RES(__RES_TYPE__,__RES_EXTENSION__,__READABLE_NAME__) \
         if(urf.m_##__RES_TYPE__.m_count==0) { \
            printf("no %ss\n", __READABLE_NAME__); \
@@ -105,25 +99,564 @@ char* splitstr(char* s1, char* s2) {
           urf.m_##__RES_TYPE__.write_all_element_files((char*)#__RES_TYPE__,(char*)__RES_EXTENSION__); \
         }
 
-#define IMPORT_RES(__RES_TYPE__,__RES_EXTENSION__) \
-        chdir(#__RES_TYPE__); \
-        while (cur_ent != NULL) { \
-           cur_ent = readdir(dir);\
-           if(cur_ent != NULL) {\
-             if(endswith(cur_ent->d_name,__RES_EXTENSION__)) { \
-                printf("%s\n",splitstr(cur_ent->d_name,__RES_EXTENSION__)); \ 
-                cur_res = (resource_type*)malloc(sizeof(resource_type)); \
-                strncpy(__RES_EXTENSION__,cur_res->m_signature,4);\
-                cur_res->m_element_name = cur_ent->d_name; \
-                cur_res->m_element_size = read_file(cur_ent->d_name,cur_res->m_element); \
-             } \
-           }\ 
-        }\
-        closedir(dir); 
-
-
-#define LOAD_URF \
-        if(urf.read_archive_file(archive_file)<0) { \
+// Batch extraction job (one archive into its own directory)...
+struct extract_job_type {
+  const char *archive_file;
+  char dest_path[1024];
+  long long bytes;
+  bool ok;
+};
+
+struct extract_pool_type {
+  extract_job_type *jobs;
+  int job_count;
+  int next_job; // claimed atomically by workers
+};
+
+/* Extract one archive below job->dest_path without touching the process-wide
+ * CWD, so many can run at once.  Each element goes out in a single fwrite.
+ */
+void extract_archive(extract_job_type *job)
+{
+  pleo_archive_type urf;
+  job->ok = false;
+  job->bytes = 0;
+  if(urf.read_archive_file(job->archive_file,PLEO_ARCHIVE_FLAG_MMAP)<0) {
+     fprintf(stderr,"Error reading %s!\n",job->archive_file);
+     return;
+  }
+  mkdir(job->dest_path,(mode_t)0777);
+  job->ok = true;
+  for(int i=0; i<MAX_RESOURCE_TYPES; i++) {
+     pleo_resource_type *rl = urf.m_toc_refinfo[i].resource_list;
+     if(rl->m_count==0) continue;
+     char type_path[1024];
+     if(snprintf(type_path,sizeof(type_path),"%s/%s",job->dest_path,g_urf_types[i].dirname)>=(int)sizeof(type_path)) {
+        fprintf(stderr,"Path too long extracting %ss from %s!\n",g_urf_types[i].readable_name,job->archive_file);
+        job->ok = false;
+        continue;
+     }
+     mkdir(type_path,(mode_t)0777);
+     if(!rl->write_all_element_files(type_path,(char*)g_urf_types[i].extension)) {
+        fprintf(stderr,"Error extracting %ss from %s!\n",g_urf_types[i].readable_name,job->archive_file);
+        job->ok = false;
+     }
+     for(int j=0; j<rl->m_count; j++) job->bytes += rl->m_resource_list[j].m_element_size;
+  }
+}
+
+void *extract_worker(void *arg)
+{
+  extract_pool_type *pool = (extract_pool_type*)arg;
+  int index;
+  while((index = __sync_fetch_and_add(&pool->next_job,1)) < pool->job_count)
+     extract_archive(&pool->jobs[index]);
+  return NULL;
+}
+
+/* Batch extract: archive "dir/name.urf" goes to "dest_path/name" (with a
+ * numeric suffix if an earlier archive had the same name).
+ */
+int batch_extract(char *dest_path, int archive_count, char **archive_files)
+{
+  extract_job_type *jobs = (extract_job_type*)malloc(sizeof(extract_job_type)*archive_count);
+  if(jobs==NULL) return 1;
+  mkdir(dest_path,(mode_t)0777);
+  for(int i=0; i<archive_count; i++) {
+     jobs[i].archive_file = archive_files[i];
+     const char *name = strrchr(archive_files[i],'/');
+     name = (name==NULL) ? archive_files[i] : name+1;
+     int namelen = strlen(name);
+     if(endswith((char*)name,(char*)".urf") || endswith((char*)name,(char*)".URF")) namelen -= 4;
+     snprintf(jobs[i].dest_path,sizeof(jobs[i].dest_path),"%s/%.*s",dest_path,namelen,name);
+     int suffix = 1;
+     for(int j=0; j<i; j++)
+        if(strcmp(jobs[i].dest_path,jobs[j].dest_path)==0) {
+           snprintf(jobs[i].dest_path,sizeof(jobs[i].dest_path),"%s/%.*s-%d",dest_path,namelen,name,suffix++);
+           j = -1; // recheck against all earlier names
+        }
+  }
+
+  int thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+  if(thread_count<1) thread_count = 1;
+  if(thread_count>archive_count) thread_count = archive_count;
+
+  extract_pool_type pool;
+  pool.jobs = jobs;
+  pool.job_count = archive_count;
+  pool.next_job = 0;
+
+  double start_time = get_time();
+  pthread_t *threads = (pthread_t*)malloc(sizeof(pthread_t)*thread_count);
+  int started = 0;
+  for(int i=0; i<thread_count; i++)
+     if(pthread_create(&threads[started],NULL,extract_worker,&pool)==0) started++;
+  if(started==0) extract_worker(&pool);
+  for(int i=0; i<started; i++) pthread_join(threads[i],NULL);
+  double elapsed = get_time()-start_time;
+
+  long long total_bytes = 0;
+  int failed = 0;
+  for(int i=0; i<archive_count; i++) {
+     total_bytes += jobs[i].bytes;
+     if(!jobs[i].ok) failed++;
+  }
+  printf("Extracted %d archives (%d failed) into %s using %d threads\n",archive_count-failed,failed,dest_path,started ? started : 1);
+  printf("%.1f MB in %.3f s: %.1f MB/s\n",total_bytes/1048576.0,elapsed,(elapsed>0) ? total_bytes/1048576.0/elapsed : 0.0);
+
+  free(threads);
+  free(jobs);
+  return failed ? 1 : 0;
+}
+
+// Archive creation job (one file below the source path)...
+struct ingest_job_type {
+  int resource_index;               // PLEO_TOC_xxx
+  char filename[1024];
+  char element_name[MAX_RESOURCE_NAMELEN+1];
+  bool convert_wave;                // .wav to be converted to USF
+  unsigned char *data;              // mapped file, or malloc'd USF image
+  int datalen;
+  bool mapped;
+  bool ok;
+  bool done;                        // guarded by pool lock
+};
+
+struct ingest_scan_type {
+  char dirname[1024];
+  char **names;
+  int count;
+  int max_count;
+};
+
+struct ingest_pool_type {
+  ingest_scan_type scans[MAX_RESOURCE_TYPES];
+  ingest_job_type *jobs;
+  int job_count;
+  int next_scan; // claimed atomically by workers
+  int next_job;  // claimed atomically by workers
+  pthread_mutex_t lock;
+  pthread_cond_t job_done;
+};
+
+int compare_names(const void *a, const void *b)
+{
+  return strcmp(*(char**)a,*(char**)b);
+}
+
+// Length of extension (including '.') if name ends with ".ext" in any case, else 0...
+int match_extension(const char *name, const char *ext)
+{
+  int namelen = strlen(name);
+  int extlen = strlen(ext);
+  if (namelen<=extlen+1 || name[namelen-extlen-1]!='.') return 0;
+  return (strcasecmp(&name[namelen-extlen],ext)==0) ? extlen+1 : 0;
+}
+
+// File name has the extension of the resource type (or is a WAV sound)...
+bool is_resource_file(const char *name, int resource_index)
+{
+  return match_extension(name,g_urf_types[resource_index].extension) ||
+         ((resource_index==PLEO_TOC_SOUND) && match_extension(name,"wav"));
+}
+
+bool add_scan_name(ingest_scan_type *scan, const char *name)
+{
+  if(scan->count>=scan->max_count) {
+     int max_count = scan->max_count ? scan->max_count*2 : 64;
+     char **names = (char**)realloc(scan->names,sizeof(char*)*max_count);
+     if(names==NULL) return false;
+     scan->names = names;
+     scan->max_count = max_count;
+  }
+  char *copy = strdup(name);
+  if(copy==NULL) return false;
+  scan->names[scan->count++] = copy;
+  return true;
+}
+
+/* List one resource type directory (e.g. path/sounds), sorted by name so
+ * the resource IDs in the archive don't depend on readdir order.
+ */
+void scan_resource_dir(ingest_scan_type *scan, int resource_index)
+{
+  DIR *dir = opendir(scan->dirname);
+  if(dir==NULL) return;
+  struct dirent *cur_ent;
+  while((cur_ent = readdir(dir)) != NULL) {
+     if(!is_resource_file(cur_ent->d_name,resource_index)) continue;
+     if(!add_scan_name(scan,cur_ent->d_name)) break;
+  }
+  closedir(dir);
+  qsort(scan->names,scan->count,sizeof(char*),compare_names);
+}
+
+/* Take the files to pack from a list of "typedir/file" lines rather than
+ * scanning, keeping its order (resource IDs follow it, per type).
+ */
+bool read_resource_list(ingest_pool_type *pool, const char *list_file)
+{
+  FILE *fileid = fopen(list_file,"r");
+  if(fileid==NULL) {
+     fprintf(stderr,"Error reading %s!\n",list_file);
+     return false;
+  }
+  bool ok = true;
+  char line[1100];
+  while(ok && (fgets(line,sizeof(line),fileid)!=NULL)) {
+     line[strcspn(line,"\r\n")] = 0;
+     if(line[0]==0) continue;
+     char *name = strchr(line,'/');
+     int resource_index = -1;
+     for(int i=0; (name!=NULL) && (i<MAX_RESOURCE_TYPES); i++)
+        if(((int)strlen(g_urf_types[i].dirname)==name-line) && (strncmp(line,g_urf_types[i].dirname,name-line)==0))
+           resource_index = i;
+     if((resource_index<0) || !is_resource_file(name+1,resource_index) || (strchr(name+1,'/')!=NULL)) {
+        fprintf(stderr,"%s: %s is not a resource file!\n",list_file,line);
+        ok = false;
+     }
+     else if(!add_scan_name(&pool->scans[resource_index],name+1)) {
+        fprintf(stderr,"Out of memory!\n");
+        ok = false;
+     }
+  }
+  fclose(fileid);
+  return ok;
+}
+
+void *scan_worker(void *arg)
+{
+  ingest_pool_type *pool = (ingest_pool_type*)arg;
+  int index;
+  while((index = __sync_fetch_and_add(&pool->next_scan,1)) < MAX_RESOURCE_TYPES)
+     scan_resource_dir(&pool->scans[index],index);
+  return NULL;
+}
+
+/* Check element data looks like the resource type it is being filed under.
+ * Properties are bare 4 byte values; scripts are compiled AMX files.
+ */
+bool validate_resource(int resource_index, unsigned char *data, int datalen)
+{
+  switch(resource_index) {
+     case PLEO_TOC_PROPERTY :
+       return (datalen==4);
+     case PLEO_TOC_SCRIPT :
+       return (datalen>=6) && (((data[4] | (data[5]<<8)) & 0xFFF0)==0xF1E0); // AMX_MAGIC
+     default :
+       return (memcmp(data,g_urf_types[resource_index].extension,4)==0);
+  }
+}
+
+/* Read one file for the archive: map it, convert it if it is a WAV file,
+ * and validate it.
+ */
+void ingest_file(ingest_job_type *job)
+{
+  job->ok = false;
+  int fd = open(job->filename,O_RDONLY);
+  if(fd<0) {
+     fprintf(stderr,"Error opening %s!\n",job->filename);
+     return;
+  }
+  struct stat st;
+  if((fstat(fd,&st)!=0) || (st.st_size<MIN_ELEMENT_DATALEN)) {
+     fprintf(stderr,"%s is too small!\n",job->filename);
+     close(fd);
+     return;
+  }
+  void *image = mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd);
+  if(image==MAP_FAILED) {
+     fprintf(stderr,"Error mapping %s!\n",job->filename);
+     return;
+  }
+  job->data = (unsigned char*)image;
+  job->datalen = st.st_size;
+  job->mapped = true;
+
+  if(job->convert_wave) {
+     pleo_sound_type sound;
+     int usflen, result;
+     unsigned char *usfdata = sound.convert_wave_image_to_usf(job->element_name,job->data,job->datalen,&usflen,0,&result);
+     munmap(job->data,job->datalen);
+     job->data = usfdata;
+     job->datalen = usflen;
+     job->mapped = false;
+     if(usfdata==NULL) {
+        fprintf(stderr,"Error converting %s (%d)!\n",job->filename,result);
+        return;
+     }
+  }
+
+  if(!validate_resource(job->resource_index,job->data,job->datalen)) {
+     fprintf(stderr,"%s is not a valid %s!\n",job->filename,g_urf_types[job->resource_index].readable_name);
+     return;
+  }
+  job->ok = true;
+}
+
+void *ingest_worker(void *arg)
+{
+  ingest_pool_type *pool = (ingest_pool_type*)arg;
+  int index;
+  while((index = __sync_fetch_and_add(&pool->next_job,1)) < pool->job_count) {
+     ingest_file(&pool->jobs[index]);
+     pthread_mutex_lock(&pool->lock);
+     pool->jobs[index].done = true;
+     pthread_cond_broadcast(&pool->job_done);
+     pthread_mutex_unlock(&pool->lock);
+  }
+  return NULL;
+}
+
+int start_workers(pthread_t *threads, int thread_count, void *(*worker)(void*), void *arg)
+{
+  int started = 0;
+  for(int i=0; i<thread_count; i++)
+     if(pthread_create(&threads[started],NULL,worker,arg)==0) started++;
+  return started;
+}
+
+/* Release everything ingest allocated: mapped files & converted images still
+ * held by jobs, scanned names, the job list & pool synchronisation.
+ */
+void free_ingest_pool(ingest_pool_type *pool)
+{
+  for(int i=0; (pool->jobs!=NULL) && (i<pool->job_count); i++) {
+     if(pool->jobs[i].data==NULL) continue;
+     if(pool->jobs[i].mapped) munmap(pool->jobs[i].data,pool->jobs[i].datalen);
+     else free(pool->jobs[i].data);
+  }
+  for(int i=0; i<MAX_RESOURCE_TYPES; i++) {
+     for(int j=0; j<pool->scans[i].count; j++) free(pool->scans[i].names[j]);
+     free(pool->scans[i].names);
+  }
+  free(pool->jobs);
+  pthread_cond_destroy(&pool->job_done);
+  pthread_mutex_destroy(&pool->lock);
+}
+
+/* Create archive from path/sounds, path/motions etc. (the layout 'x'
+ * extracts to), or the files list_file names there.  Files are scanned,
+ * mapped, converted and validated on a worker pool; this thread adds them to
+ * the archive strictly in order as they complete, then streams the archive
+ * out.
+ */
+int create_archive(char *archive_file, char *src_path, const char *list_file)
+{
+  ingest_pool_type pool;
+  memset(&pool,0,sizeof(pool));
+  pthread_mutex_init(&pool.lock,NULL);
+  pthread_cond_init(&pool.job_done,NULL);
+  for(int i=0; i<MAX_RESOURCE_TYPES; i++)
+     snprintf(pool.scans[i].dirname,sizeof(pool.scans[i].dirname),"%s/%s",src_path,g_urf_types[i].dirname);
+
+  int thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+  if(thread_count<1) thread_count = 1;
+  pthread_t *threads = (pthread_t*)malloc(sizeof(pthread_t)*thread_count);
+  if(threads==NULL) {
+     fprintf(stderr,"Out of memory!\n");
+     free_ingest_pool(&pool);
+     return 1;
+  }
+
+  double start_time = get_time();
+
+  // Scan type directories (or read list)...
+  int failed = 0;
+  if(list_file!=NULL) {
+     if(!read_resource_list(&pool,list_file)) failed++;
+  }
+  else {
+     int started = start_workers(threads,(thread_count<MAX_RESOURCE_TYPES) ? thread_count : MAX_RESOURCE_TYPES,scan_worker,&pool);
+     if(started==0) scan_worker(&pool);
+     for(int i=0; i<started; i++) pthread_join(threads[i],NULL);
+  }
+
+  for(int i=0; i<MAX_RESOURCE_TYPES; i++) {
+     if(pool.scans[i].count>=MAX_RESOURCE_ENTRIES) {
+        fprintf(stderr,"Too many %ss in %s (maximum %d)!\n",g_urf_types[i].readable_name,pool.scans[i].dirname,MAX_RESOURCE_ENTRIES-1);
+        failed++;
+     }
+     pool.job_count += pool.scans[i].count;
+  }
+
+  // One job per file, in archive order...
+  pool.jobs = (ingest_job_type*)malloc(sizeof(ingest_job_type)*(pool.job_count+1));
+  if(pool.jobs==NULL) {
+     fprintf(stderr,"Out of memory!\n");
+     free_ingest_pool(&pool);
+     free(threads);
+     return 1;
+  }
+  memset(pool.jobs,0,sizeof(ingest_job_type)*(pool.job_count+1));
+  int job_count = 0;
+  for(int i=0; i<MAX_RESOURCE_TYPES; i++)
+     for(int j=0; j<pool.scans[i].count; j++) {
+        ingest_job_type *job = &pool.jobs[job_count++];
+        char *name = pool.scans[i].names[j];
+        job->resource_index = i;
+        snprintf(job->filename,sizeof(job->filename),"%s/%s",pool.scans[i].dirname,name);
+        int extlen = match_extension(name,g_urf_types[i].extension);
+        job->convert_wave = (extlen==0);
+        if(job->convert_wave) extlen = match_extension(name,"wav");
+        snprintf(job->element_name,sizeof(job->element_name),"%.*s",(int)strlen(name)-extlen,name);
+        if((int)strlen(name)-extlen>MAX_RESOURCE_NAMELEN) {
+           fprintf(stderr,"%s: name longer than %d characters!\n",job->filename,MAX_RESOURCE_NAMELEN);
+           failed++;
+        }
+     }
+
+  // Ingest in parallel, add to archive in order...
+  int started = failed ? 0 : start_workers(threads,(thread_count<pool.job_count) ? thread_count : pool.job_count,ingest_worker,&pool);
+  if((started==0) && (failed==0)) ingest_worker(&pool);
+
+  pleo_archive_type urf;
+  long long total_bytes = 0;
+  for(int i=0; (i<pool.job_count) && (failed==0); i++) {
+     ingest_job_type *job = &pool.jobs[i];
+     pthread_mutex_lock(&pool.lock);
+     while(!job->done) pthread_cond_wait(&pool.job_done,&pool.lock);
+     pthread_mutex_unlock(&pool.lock);
+     if(!job->ok) {
+        failed++;
+        continue;
+     }
+
+     pleo_resource_type *rl = urf.m_toc_refinfo[job->resource_index].resource_list;
+     if(rl->get_element_index(job->element_name)>=0) {
+        fprintf(stderr,"%s: duplicate %s name %s!\n",job->filename,g_urf_types[job->resource_index].readable_name,job->element_name);
+        failed++;
+        continue;
+     }
+     int index = job->mapped ? rl->add_borrowed_element(job->element_name,job->data,job->datalen)
+                             : rl->add_new_element(job->element_name,job->data,job->datalen,true);
+     if(index<0) {
+        fprintf(stderr,"Error adding %s!\n",job->filename);
+        failed++;
+        continue;
+     }
+     if(!job->mapped) job->data = NULL; // now owned by archive
+     total_bytes += job->datalen;
+  }
+
+  // Stop remaining workers early if anything failed...
+  if(failed) __sync_lock_test_and_set(&pool.next_job,pool.job_count);
+  for(int i=0; i<started; i++) pthread_join(threads[i],NULL);
+
+  if(failed==0) {
+     if(urf.write_archive_file(archive_file)<=0) {
+        fprintf(stderr,"Error writing %s!\n",archive_file);
+        failed++;
+     }
+  }
+  double elapsed = get_time()-start_time;
+  if(failed==0) {
+     printf("Packed %d resources from %s into %s using %d threads\n",pool.job_count,src_path,archive_file,started ? started : 1);
+     printf("%.1f MB in %.3f s: %.1f MB/s\n",total_bytes/1048576.0,elapsed,(elapsed>0) ? total_bytes/1048576.0/elapsed : 0.0);
+  }
+
+  // Archive borrows mapped files until here...
+  urf.init_archive();
+  free_ingest_pool(&pool);
+  free(threads);
+  return failed ? 1 : 0;
+}
+
+// Print string as JSON string literal...
+void print_json_string(const char *s) {
+     putchar('"');
+     for(; *s; s++) {
+        if((*s=='"') || (*s=='\\')) printf("\\%c",*s);
+        else if((unsigned char)*s<0x20) printf("\\u%04x",*s);
+        else putchar(*s);
+     }
+     putchar('"');
+}
+
+/* Report where the archive's bytes go, per resource type & per resource,
+ * with the savings ADPCM re-encoding, deduplication & silence trimming
+ * would give.  JSON or CSV (one row per resource, section & archive) so
+ * size regressions can be tracked by machine.
+ */
+int report_budget(char *archive_file, const char *format)
+{
+  bool csv = (strcmp(format,"csv")==0);
+  if(!csv && (strcmp(format,"json")!=0)) {
+     usage();
+     return 1;
+  }
+  pleo_archive_type urf;
+  if(urf.read_archive_file(archive_file,PLEO_ARCHIVE_FLAG_MMAP)<0) {
+     fprintf(stderr,"Error reading!\n");
+     return 1;
+  }
+  pleo_archive_budgettype budget;
+  if(!urf.report_archive_budget(&budget)) {
+     fprintf(stderr,"Out of memory!\n");
+     return 1;
+  }
+
+  // Sound estimates...
+  int adpcm_savings = 0, silence_savings = 0;
+  for(int i=0; i<budget.entry_count; i++) {
+     pleo_archive_budget_entrytype *entry = &budget.entries[i];
+     if((entry->resource_index!=PLEO_TOC_SOUND) || (entry->payload==0)) continue;
+     pleo_sound_type sound;
+     sound.estimate_usf_savings(urf.m_sounds.load_element(entry->element_index),entry->size,&entry->adpcm_savings,&entry->silence_savings);
+     adpcm_savings += entry->adpcm_savings;
+     silence_savings += entry->silence_savings;
+  }
+
+  if(csv) {
+     printf("kind,type,name,size,payload,padding,toc,duplicate_bytes,duplicate_of,adpcm_savings,silence_savings\n");
+     printf("archive,,,%d,,%d,,,,%d,%d\n",budget.total,budget.header+budget.toc_padding+budget.crc,adpcm_savings,silence_savings);
+     printf("dedup,,,%d,,,,,,,\n",budget.dedup_savings);
+     for(int i=0; i<MAX_RESOURCE_TYPES; i++) {
+        pleo_archive_budget_sectiontype *section = &budget.sections[i];
+        printf("section,%s,,%d,%d,%d,%d,%d,,,\n",g_urf_types[i].dirname,
+               section->payload+section->element_padding+section->section_padding+section->toc,
+               section->payload,section->element_padding+section->section_padding,section->toc,section->duplicate_bytes);
+     }
+     for(int i=0; i<budget.entry_count; i++) {
+        pleo_archive_budget_entrytype *entry = &budget.entries[i];
+        pleo_resource_type *rl = urf.m_toc_refinfo[entry->resource_index].resource_list;
+        printf("resource,%s,\"%s\",%d,%d,%d,,,",g_urf_types[entry->resource_index].dirname,
+               rl->m_resource_list[entry->element_index].m_element_name,entry->size,entry->payload,entry->padding);
+        if(entry->duplicate_of>=0) printf("\"%s\"",rl->m_resource_list[entry->duplicate_of].m_element_name);
+        printf(",%d,%d\n",entry->adpcm_savings,entry->silence_savings);
+     }
+  } else {
+     printf("{\n  \"archive\": ");
+     print_json_string(archive_file);
+     printf(",\n  \"total\": %d,\n  \"header\": %d,\n  \"toc_padding\": %d,\n  \"crc\": %d,\n",budget.total,budget.header,budget.toc_padding,budget.crc);
+     printf("  \"savings\": {\"dedup\": %d, \"adpcm\": %d, \"silence\": %d},\n",budget.dedup_savings,adpcm_savings,silence_savings);
+     printf("  \"sections\": [");
+     for(int i=0; i<MAX_RESOURCE_TYPES; i++) {
+        pleo_archive_budget_sectiontype *section = &budget.sections[i];
+        printf("%s\n    {\"type\": \"%s\", \"count\": %d, \"payload\": %d, \"element_padding\": %d, \"section_padding\": %d, \"toc\": %d, \"duplicate_bytes\": %d}",
+               i ? "," : "",g_urf_types[i].dirname,section->count,section->payload,section->element_padding,section->section_padding,section->toc,section->duplicate_bytes);
+     }
+     printf("\n  ],\n  \"resources\": [");
+     for(int i=0; i<budget.entry_count; i++) {
+        pleo_archive_budget_entrytype *entry = &budget.entries[i];
+        pleo_resource_type *rl = urf.m_toc_refinfo[entry->resource_index].resource_list;
+        printf("%s\n    {\"type\": \"%s\", \"name\": ",i ? "," : "",g_urf_types[entry->resource_index].dirname);
+        print_json_string(rl->m_resource_list[entry->element_index].m_element_name);
+        printf(", \"size\": %d, \"payload\": %d, \"padding\": %d, \"duplicate_of\": ",entry->size,entry->payload,entry->padding);
+        if(entry->duplicate_of>=0) print_json_string(rl->m_resource_list[entry->duplicate_of].m_element_name);
+        else printf("null");
+        printf(", \"adpcm_savings\": %d, \"silence_savings\": %d}",entry->adpcm_savings,entry->silence_savings);
+     }
+     printf("\n  ]\n}\n");
+  }
+  free(budget.entries);
+  return 0;
+}
+
+#define LOAD_URF(__FLAGS__) \
+        if(urf.read_archive_file(archive_file,__FLAGS__)<0) { \
            fprintf(stderr,"Error reading!\n"); \
            return 1; \
         }
@@ -138,11 +671,19 @@ int main(int argc, char* argv[])
   char* command      = argv[1];
   char* archive_file = argv[2];
 
+  if(strncmp(command,"b",1)==0) {
+     if(argc<4) {
+        usage();
+        return 1;
+     }
+     return batch_extract(argv[2],argc-3,&argv[3]);
+  }
+
   pleo_archive_type urf;
   resource_type res;
 
   if(strncmp(command,"l",1)==0) {
-     LOAD_URF
+     LOAD_URF(PLEO_ARCHIVE_FLAG_LAZY) // names & sizes only
      printf("%-30s\t\t%-30s\t\t%-30s\n","Name","Size","Type");
      DUMP_RES(sounds,PLEO_TOC_SOUND_SIGNATURE,"Sound")
      DUMP_RES(motions,PLEO_TOC_MTN_SIGNATURE,"Motion")
@@ -152,7 +693,7 @@ int main(int argc, char* argv[])
      return 0;
   }
   if(strncmp(command,"x",1)==0) {
-     LOAD_URF
+     LOAD_URF(PLEO_ARCHIVE_FLAG_MMAP)
      char *dest_path;
      if(argc==4) {
         dest_path = argv[3];
@@ -174,24 +715,15 @@ int main(int argc, char* argv[])
      EXTRACT_RES(scripts,"AMX","Script")
      EXTRACT_RES(properties,PLEO_TOC_PROPERTY_SIGNATURE,"Propertie")
   }
+  if(strncmp(command,"s",1)==0) {
+     return report_budget(archive_file,(argc>3) ? argv[3] : "json");
+  }
   if(strncmp(command,"c",1)==0) {
-     char *dest_path;
      if(argc<4) {
         usage();
         return 1;
      }
-     dest_path = argv[3];
-     if(chdir(dest_path)==-1) {
-        fprintf(stderr,"Could not change CWD - does the destination path exist?\n");
-        return 1;
-     }
-     urf.init_archive();
-     DIR* dir;
-     struct dirent* cur_ent;
-     resource_type* cur_res;
-     
-     IMPORT_RES(sounds,PLEO_TOC_SOUND_SIGNATURE)
-     IMPORT_RES(motions,PLEO_TOC_MTN_SIGNATURE)
+     return create_archive(archive_file,argv[3],(argc>4) ? argv[4] : NULL);
   }
 }
 
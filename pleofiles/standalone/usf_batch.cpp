@@ -0,0 +1,353 @@
+/*
+ * Copyright (c) 2010 John of dogsbodynet.com
+ *                    Gareth Nelson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include "../pleosound.h"
+#include "../pleoproject.h"
+
+void usage() {
+     printf("usf_batch [-j threads] [-o outdir] [-p] [-b] [-q] [-t] [-P dB | -R dB] manifest\n");
+     printf("\t converts every sound listed in manifest to outdir/name.usf (default: current directory)\n");
+     printf("\t manifest is a .upf project (its <sound> resources) or a text file of \"path[<TAB>name]\" lines\n");
+     printf("\t -j worker threads (default: one per CPU)\n");
+     printf("\t -p write 8-bit PCM rather than ADPCM\n");
+     printf("\t -b write seekable blocked ADPCM\n");
+     printf("\t -q search encoder (lower ADPCM error, slower)\n");
+     printf("\t -t trim leading & trailing silence\n");
+     printf("\t -P/-R normalise peak/RMS level to dB (full scale 0, e.g. -1 or -16)\n");
+}
+
+double get_time() {
+     struct timeval tv;
+     gettimeofday(&tv,NULL);
+     return tv.tv_sec + tv.tv_usec/1000000.0;
+}
+
+// Pipeline stages timed per sound...
+enum {STAGE_READ, STAGE_CONVERT, STAGE_ENCODE, STAGE_WRITE, STAGE_COUNT};
+const char *g_stage_names[STAGE_COUNT] = {"read", "convert", "encode", "write"};
+
+// One sound to transcode.  Sound IDs are manifest positions (from 1), so a
+// given manifest always numbers its sounds the same way...
+struct transcode_job_type {
+  int id;
+  char path[1024];
+  char name[USF_NAME_MAXLEN+1];
+  char usf_path[1024];
+  int result;                  // read_wave_image result, or error
+  int wave_bytes;
+  int usf_bytes;
+  double stage_time[STAGE_COUNT];
+};
+
+struct transcode_pool_type {
+  transcode_job_type *jobs;
+  int job_count;
+  int next_job; // claimed atomically by workers
+  int flags;
+  bool trim;
+  int level_mode; // PLEO_LEVEL_xxx, -1 = keep level
+  double level_db;
+};
+
+struct manifest_type {
+  transcode_job_type *jobs;
+  int count;
+  int maxcount;
+};
+
+/* Add sound at path (relative paths are taken from base_dir).  Default
+ * name is the file name less directory & extension.
+ */
+bool add_sound(manifest_type *manifest, const char *base_dir, const char *path, const char *name)
+{
+  if(manifest->count==manifest->maxcount) {
+     int maxcount = manifest->maxcount ? 2*manifest->maxcount : 64;
+     transcode_job_type *jobs = (transcode_job_type*)realloc(manifest->jobs,sizeof(transcode_job_type)*maxcount);
+     if(jobs==NULL) return false;
+     manifest->jobs = jobs;
+     manifest->maxcount = maxcount;
+  }
+  transcode_job_type *job = &manifest->jobs[manifest->count];
+  memset(job,0,sizeof(*job));
+  job->id = manifest->count+1;
+  int pathlen;
+  if((path[0]=='/') || (base_dir[0]==0)) pathlen = snprintf(job->path,sizeof(job->path),"%s",path);
+  else pathlen = snprintf(job->path,sizeof(job->path),"%s/%s",base_dir,path);
+  if((pathlen<0) || (pathlen>=(int)sizeof(job->path))) {
+     fprintf(stderr,"Path too long: %s\n",path);
+     return false;
+  }
+
+  if((name==NULL) || (name[0]==0)) {
+     const char *base = strrchr(path,'/');
+     name = (base==NULL) ? path : base+1;
+  }
+  snprintf(job->name,sizeof(job->name),"%s",name);
+  if(strrchr(job->name,'.')!=NULL) *strrchr(job->name,'.') = 0;
+  if(job->name[0]==0) return false;
+  manifest->count++;
+  return true;
+}
+
+/* UPF project: its <resources> <sound> paths, ${VAR}s resolved.
+ */
+bool read_upf_sounds(manifest_type *manifest, const char *base_dir, const char *text, int textlen)
+{
+  pleo_project_type project;
+  if(project.read_project_image(text,textlen)<0) {
+     fprintf(stderr,"%s\n",project.m_error);
+     return false;
+  }
+  bool ok = true;
+  for(int i=0; i<project.get_entry_count(PLEO_PROJECT_RESOURCE); i++) {
+     if(strcmp(project.get_entry_name(PLEO_PROJECT_RESOURCE,i),"sound")!=0) continue;
+     if(!add_sound(manifest,base_dir,project.get_entry_value(PLEO_PROJECT_RESOURCE,i),NULL)) ok = false;
+  }
+  return ok;
+}
+
+/* Plain manifest: one "path[<TAB>name]" per line (the path may hold
+ * spaces & '#'), lines starting with '#' are comments.
+ */
+bool read_list_sounds(manifest_type *manifest, const char *base_dir, char *text)
+{
+  bool ok = true;
+  for(char *line=strtok(text,"\r\n"); line!=NULL; line=strtok(NULL,"\r\n")) {
+     if(line[0]=='#') continue;
+     char *name = strchr(line,'\t');
+     if(name!=NULL) *name++ = 0;
+     if(line[0]==0) continue;
+     if(!add_sound(manifest,base_dir,line,name)) ok = false;
+  }
+  return ok;
+}
+
+bool read_manifest(manifest_type *manifest, const char *manifest_file)
+{
+  FILE *fileid = fopen(manifest_file,"rb");
+  if(fileid==NULL) {
+     fprintf(stderr,"Error reading %s!\n",manifest_file);
+     return false;
+  }
+  fseek(fileid,0,SEEK_END);
+  long len = ftell(fileid);
+  fseek(fileid,0,SEEK_SET);
+  char *text = (char*)malloc(len+1);
+  if((text==NULL) || (fread(text,1,len,fileid)!=(size_t)len)) {
+     fclose(fileid);
+     free(text);
+     fprintf(stderr,"Error reading %s!\n",manifest_file);
+     return false;
+  }
+  fclose(fileid);
+  text[len] = 0;
+
+  char base_dir[1024];
+  snprintf(base_dir,sizeof(base_dir),"%s",manifest_file);
+  char *slash = strrchr(base_dir,'/');
+  if(slash!=NULL) *slash = 0;
+  else base_dir[0] = 0;
+
+  int namelen = strlen(manifest_file);
+  bool upf = (namelen>4) && (strcasecmp(&manifest_file[namelen-4],".upf")==0);
+  bool ok = upf ? read_upf_sounds(manifest,base_dir,text,len) : read_list_sounds(manifest,base_dir,text);
+  free(text);
+  if(!ok) fprintf(stderr,"Error in %s!\n",manifest_file);
+  return ok;
+}
+
+/* Read, convert (to 8-bit mono 11025Hz, trimmed & normalised if asked),
+ * encode & write one sound.  The converter reads the wave image in place,
+ * so the image is kept until encoding is done.
+ */
+void transcode_sound(transcode_job_type *job, transcode_pool_type *pool)
+{
+  double stage_start = get_time();
+  job->result = SOUNDBASE_ERROR_FILENOTFOUND;
+  int fd = open(job->path,O_RDONLY);
+  struct stat st;
+  if((fd<0) || (fstat(fd,&st)!=0) || (st.st_size==0) || (st.st_size>0x7FFFFFFF)) {
+     if(fd>=0) close(fd);
+     return;
+  }
+  int imagelen = (int)st.st_size;
+  unsigned char *image = (unsigned char*)malloc(imagelen);
+  int readlen = 0;
+  while(image && (readlen<imagelen)) {
+     ssize_t len = pread(fd,&image[readlen],imagelen-readlen,readlen);
+     if(len<=0) break;
+     readlen += (int)len;
+  }
+  close(fd);
+  if(readlen!=imagelen) {
+     free(image);
+     return;
+  }
+  job->wave_bytes = imagelen;
+  double now = get_time();
+  job->stage_time[STAGE_READ] = now-stage_start;
+  stage_start = now;
+
+  pleo_sound_type sound;
+  job->result = sound.read_wave_image(job->name,image,imagelen,SOUNDBASE_FLAG_BORROW);
+  snprintf(sound.m_original_name,sizeof(sound.m_original_name),"%s",job->name);
+  if((job->result>0) && pool->trim && (sound.trim_wave_silence()<0)) job->result = SOUNDBASE_ERROR_INCOMPATIBLE;
+  if((job->result>0) && (pool->level_mode>=0) && !sound.normalise_wave_level(pool->level_mode,pool->level_db)) job->result = SOUNDBASE_ERROR_INCOMPATIBLE;
+  now = get_time();
+  job->stage_time[STAGE_CONVERT] = now-stage_start;
+  stage_start = now;
+  if(job->result<=0) {
+     free(image);
+     return;
+  }
+
+  int usflen = 0;
+  unsigned char *usfdata = sound.write_pleo_usf_wave_image(&usflen,pool->flags);
+  sound.init_wave();
+  free(image);
+  now = get_time();
+  job->stage_time[STAGE_ENCODE] = now-stage_start;
+  stage_start = now;
+  if(usfdata==NULL) {
+     job->result = SOUNDBASE_ERROR_INCOMPATIBLE;
+     return;
+  }
+
+  FILE *fileid = fopen(job->usf_path,"wb");
+  if((fileid==NULL) || (fwrite(usfdata,1,usflen,fileid)!=(size_t)usflen)) job->result = SOUNDBASE_ERROR_FILENOTFOUND;
+  else job->usf_bytes = usflen;
+  if(fileid!=NULL) fclose(fileid);
+  free(usfdata);
+  job->stage_time[STAGE_WRITE] = get_time()-stage_start;
+}
+
+void *transcode_worker(void *arg)
+{
+  transcode_pool_type *pool = (transcode_pool_type*)arg;
+  int index;
+  while((index = __sync_fetch_and_add(&pool->next_job,1)) < pool->job_count)
+     transcode_sound(&pool->jobs[index],pool);
+  return NULL;
+}
+
+int main(int argc, char* argv[])
+{
+  int thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+  const char *out_dir = ".";
+  int flags = 0;
+  bool trim = false;
+  int level_mode = -1;
+  double level_db = 0;
+  int opt;
+  while((opt = getopt(argc,argv,"j:o:pbqtP:R:"))!=-1) {
+     switch(opt) {
+        case 'j': thread_count = atoi(optarg); break;
+        case 'o': out_dir = optarg; break;
+        case 'p': flags |= SOUNDBASE_PLEO_FORCE_PCM; break;
+        case 'b': flags |= SOUNDBASE_PLEO_ADPCM_BLOCKED; break;
+        case 'q': flags |= SOUNDBASE_PLEO_ADPCM_SEARCH; break;
+        case 't': trim = true; break;
+        case 'P': level_mode = PLEO_LEVEL_PEAK; level_db = atof(optarg); break;
+        case 'R': level_mode = PLEO_LEVEL_RMS; level_db = atof(optarg); break;
+        default: usage(); return 1;
+     }
+  }
+  if(optind!=argc-1) {
+     usage();
+     return 1;
+  }
+
+  manifest_type manifest = {NULL,0,0};
+  if(!read_manifest(&manifest,argv[optind])) return 1;
+  if(manifest.count==0) {
+     fprintf(stderr,"No sounds in %s!\n",argv[optind]);
+     return 1;
+  }
+
+  // Names must be unique, as they name the output files & resources...
+  for(int i=0; i<manifest.count; i++) {
+     for(int j=0; j<i; j++)
+        if(strcmp(manifest.jobs[i].name,manifest.jobs[j].name)==0) {
+           fprintf(stderr,"Duplicate sound name %s (%s and %s)!\n",manifest.jobs[i].name,manifest.jobs[j].path,manifest.jobs[i].path);
+           return 1;
+        }
+     snprintf(manifest.jobs[i].usf_path,sizeof(manifest.jobs[i].usf_path),"%s/%s.usf",out_dir,manifest.jobs[i].name);
+  }
+  mkdir(out_dir,(mode_t)0777);
+
+  if(thread_count<1) thread_count = 1;
+  if(thread_count>manifest.count) thread_count = manifest.count;
+
+  transcode_pool_type pool;
+  pool.jobs = manifest.jobs;
+  pool.job_count = manifest.count;
+  pool.next_job = 0;
+  pool.flags = flags;
+  pool.trim = trim;
+  pool.level_mode = level_mode;
+  pool.level_db = level_db;
+
+  double start_time = get_time();
+  pthread_t *threads = (pthread_t*)malloc(sizeof(pthread_t)*thread_count);
+  int started = 0;
+  for(int i=0; i<thread_count; i++)
+     if(pthread_create(&threads[started],NULL,transcode_worker,&pool)==0) started++;
+  if(started==0) transcode_worker(&pool);
+  for(int i=0; i<started; i++) pthread_join(threads[i],NULL);
+  double elapsed = get_time()-start_time;
+  free(threads);
+
+  // Report in manifest order, whatever order the workers finished in...
+  double stage_total[STAGE_COUNT] = {0};
+  long long wave_bytes = 0, usf_bytes = 0;
+  int failed = 0;
+  printf("%-5s %-32s %10s %10s\n","ID","Name","Wave","USF");
+  for(int i=0; i<manifest.count; i++) {
+     transcode_job_type *job = &manifest.jobs[i];
+     for(int j=0; j<STAGE_COUNT; j++) stage_total[j] += job->stage_time[j];
+     if(job->result<=0) {
+        fprintf(stderr,"Error converting %s (%d)!\n",job->path,job->result);
+        failed++;
+        continue;
+     }
+     printf("%-5d %-32s %10d %10d%s\n",job->id,job->name,job->wave_bytes,job->usf_bytes,(job->result==SOUNDBASE_FILE_CONVERTED) ? " (converted)" : "");
+     wave_bytes += job->wave_bytes;
+     usf_bytes += job->usf_bytes;
+  }
+
+  printf("Transcoded %d sounds (%d failed) into %s using %d threads\n",manifest.count-failed,failed,out_dir,started ? started : 1);
+  printf("Stage time (summed over sounds):");
+  for(int j=0; j<STAGE_COUNT; j++) printf(" %s %.3f s%s",g_stage_names[j],stage_total[j],(j<STAGE_COUNT-1) ? "," : "\n");
+  printf("%.1f MB wave to %.1f MB USF in %.3f s: %.1f MB/s\n",wave_bytes/1048576.0,usf_bytes/1048576.0,elapsed,(elapsed>0) ? wave_bytes/1048576.0/elapsed : 0.0);
+  free(manifest.jobs);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2010 John of dogsbodynet.com
+ *                    Gareth Nelson
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../pleosound.h"
+
+void usage() {
+     printf("usf_clip usffile start stop [sound_name]\n");
+     printf("\t writes samples start..stop of usffile to sound_name.usf (stop 0: to end)\n");
+     printf("\t ADPCM data is cut without re-encoding (default name: usffile name with _clip)\n");
+}
+
+int main(int argc, char* argv[])
+{
+  if(argc<4) {
+     usage();
+     return 1;
+  }
+  char* usf_file = argv[1];
+  int starttime = atoi(argv[2]);
+  int stoptime = atoi(argv[3]);
+
+  // Default sound name is the file's base name...
+  char sound_name[256];
+  if(argc>4) {
+     snprintf(sound_name,sizeof(sound_name),"%s",argv[4]);
+  } else {
+     const char *name = strrchr(usf_file,'/');
+     snprintf(sound_name,sizeof(sound_name),"%s",(name==NULL) ? usf_file : name+1);
+     char *ext = strchr(sound_name,'.');
+     if(ext!=NULL) *ext = 0;
+     strncat(sound_name,"_clip",sizeof(sound_name)-strlen(sound_name)-1);
+  }
+
+  int fd = open(usf_file,O_RDONLY);
+  struct stat st;
+  if((fd<0) || (fstat(fd,&st)!=0) || (st.st_size==0)) {
+     fprintf(stderr,"Error reading %s!\n",usf_file);
+     return 1;
+  }
+  void *image = mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd);
+  if(image==MAP_FAILED) {
+     fprintf(stderr,"Error reading %s!\n",usf_file);
+     return 1;
+  }
+
+  pleo_sound_type sound;
+  int cliplen, result;
+  unsigned char *clipdata = sound.extract_usf_clip_image(sound_name,(unsigned char*)image,st.st_size,starttime,stoptime,&cliplen,0,&result);
+  munmap(image,st.st_size);
+  if(clipdata==NULL) {
+     fprintf(stderr,"Error clipping %s (%d)!\n",usf_file,result);
+     return 1;
+  }
+
+  char clip_file[300];
+  snprintf(clip_file,sizeof(clip_file),"%s.usf",sound_name);
+  FILE *fp = fopen(clip_file,"wb");
+  if((fp==NULL) || (fwrite(clipdata,1,cliplen,fp)!=(size_t)cliplen)) {
+     fprintf(stderr,"Error writing %s!\n",clip_file);
+     if(fp) fclose(fp);
+     free(clipdata);
+     return 1;
+  }
+  fclose(fp);
+  free(clipdata);
+  return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2010 John of dogsbodynet.com
+ *                    Gareth Nelson
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../pleosound.h"
+
+void usage() {
+     printf("wav2usf wavefile [sound_name]\n");
+     printf("\t converts wavefile to sound_name.usf (default name: wavefile without path or extension)\n");
+}
+
+int main(int argc, char* argv[])
+{
+  if(argc<2) {
+     usage();
+     return 1;
+  }
+  char* wave_file = argv[1];
+
+  // Default sound name is the file's base name...
+  char sound_name[256];
+  if(argc>2) {
+     snprintf(sound_name,sizeof(sound_name),"%s",argv[2]);
+  } else {
+     const char *name = strrchr(wave_file,'/');
+     snprintf(sound_name,sizeof(sound_name),"%s",(name==NULL) ? wave_file : name+1);
+     char *ext = strchr(sound_name,'.');
+     if(ext!=NULL) *ext = 0;
+  }
+  printf("Converting %s\n",wave_file);
+
+  int fd = open(wave_file,O_RDONLY);
+  struct stat st;
+  if((fd<0) || (fstat(fd,&st)!=0) || (st.st_size==0)) {
+     fprintf(stderr,"Error reading %s!\n",wave_file);
+     return 1;
+  }
+  void *image = mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd);
+  if(image==MAP_FAILED) {
+     fprintf(stderr,"Error reading %s!\n",wave_file);
+     return 1;
+  }
+
+  pleo_sound_type sound;
+  int usflen, result;
+  unsigned char *usfdata = sound.convert_wave_image_to_usf(sound_name,(unsigned char*)image,st.st_size,&usflen,0,&result);
+  munmap(image,st.st_size);
+  if(usfdata==NULL) {
+     fprintf(stderr,"Error converting %s (%d)!\n",wave_file,result);
+     return 1;
+  }
+
+  char usf_file[300];
+  snprintf(usf_file,sizeof(usf_file),"%s.usf",sound_name);
+  FILE *fp = fopen(usf_file,"wb");
+  if((fp==NULL) || (fwrite(usfdata,1,usflen,fp)!=(size_t)usflen)) {
+     fprintf(stderr,"Error writing %s!\n",usf_file);
+     if(fp) fclose(fp);
+     free(usfdata);
+     return 1;
+  }
+  fclose(fp);
+  free(usfdata);
+  return 0;
+}
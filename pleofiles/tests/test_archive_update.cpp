@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2010 John of dogsbodynet.com
+ *                    Gareth Nelson
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+//
+// update_archive_file: a resource that still fits its slot is rewritten in
+// place (archive size unchanged), also when the archive has filler entries.
+// One that doesn't (grown, new element or property) is appended after the
+// archive with a relocated TOC, leaving the other resources as they were.
+// write_archive_file of a TOC only archive copies lazy payloads as is, & a
+// symlinked target keeps its link & mode...
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "../pleoarchive.h"
+
+#define TEST_ARCHIVE "test_archive_update.urf"
+#define TEST_LINK "test_archive_link.urf"
+#define TEST_VICTIM "test_archive_victim.txt"
+
+static int g_failures = 0;
+
+static void check(bool ok, const char *what)
+{
+  printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+  if (!ok) g_failures++;
+}
+
+static long file_size(const char *filename)
+{
+  struct stat st;
+  return (stat(filename,&st)==0) ? (long)st.st_size : -1;
+}
+
+// Archive with sounds a & b around a filler, plus a script...
+static bool write_test_archive(bool with_filler)
+{
+  unsigned char data[600];
+  for (int i=0; i<(int)sizeof(data); i++) data[i] = (unsigned char)(i*13+1);
+
+  pleo_archive_type archive;
+  archive.m_sounds.add_new_element("a", data, 500);
+  if (with_filler) archive.m_sounds.add_filler();
+  archive.m_sounds.add_new_element("b", data, 300);
+  archive.m_scripts.add_new_element("main", data, 200);
+  unsigned int volume = 7;
+  archive.m_properties.add_new_element("volume", (unsigned char *)&volume, 4);
+  return archive.write_archive_file(TEST_ARCHIVE) > 0;
+}
+
+// Element of a resource list matches data...
+static bool element_is(pleo_resource_type *rl, const char *name, const unsigned char *data, int len)
+{
+  int datalen = 0;
+  unsigned char *dataptr = rl->get_element_dataptr(rl->get_element_index(name), NULL, &datalen);
+  return (dataptr!=NULL) && (datalen==len) && (memcmp(dataptr,data,len)==0);
+}
+
+// Resources write_test_archive wrote, other than the one updated, are intact...
+static void check_untouched(pleo_archive_type *archive, const char *updated, const char *label)
+{
+  char what[128];
+  unsigned char data[600];
+  for (int i=0; i<(int)sizeof(data); i++) data[i] = (unsigned char)(i*13+1);
+  unsigned int volume = 7;
+  snprintf(what, sizeof(what), "other resources intact (%s)", label);
+  check(((strcmp(updated,"a")==0) || element_is(&archive->m_sounds, "a", data, 500)) &&
+        ((strcmp(updated,"b")==0) || element_is(&archive->m_sounds, "b", data, 300)) &&
+        ((strcmp(updated,"main")==0) || element_is(&archive->m_scripts, "main", data, 200)) &&
+        ((strcmp(updated,"volume")==0) || element_is(&archive->m_properties, "volume", (unsigned char *)&volume, 4)), what);
+}
+
+// Update that doesn't fit a slot: archive grows, verifies & reads back the
+// new data, whether read whole or TOC only...
+static void test_update_append(int resource_index, const char *name, int datalen, const char *label)
+{
+  char what[128];
+  check(write_test_archive(true), "write archive");
+  long before = file_size(TEST_ARCHIVE);
+
+  unsigned char newdata[2000];
+  for (int i=0; i<(int)sizeof(newdata); i++) newdata[i] = (unsigned char)(i*7+3);
+  int result = pleo_archive_type().update_archive_file(TEST_ARCHIVE, resource_index, name, newdata, datalen);
+  snprintf(what, sizeof(what), "update (%s)", label);
+  check(result==1, what);
+  snprintf(what, sizeof(what), "archive grown (%s): %ld -> %ld", label, before, file_size(TEST_ARCHIVE));
+  check(file_size(TEST_ARCHIVE)>before, what);
+
+  pleo_archive_type archive;
+  snprintf(what, sizeof(what), "updated archive verifies (%s)", label);
+  check(archive.read_archive_file(TEST_ARCHIVE, PLEO_ARCHIVE_FLAG_VERIFY)>0, what);
+  pleo_resource_type *rl = archive.m_toc_refinfo[resource_index].resource_list;
+  snprintf(what, sizeof(what), "updated resource read back (%s)", label);
+  check(element_is(rl, name, newdata, datalen), what);
+  check_untouched(&archive, name, label);
+
+  pleo_archive_type lazy;
+  snprintf(what, sizeof(what), "updated archive verifies TOC only (%s)", label);
+  check(lazy.read_archive_toc(TEST_ARCHIVE, PLEO_ARCHIVE_FLAG_VERIFY)>0, what);
+  rl = lazy.m_toc_refinfo[resource_index].resource_list;
+  snprintf(what, sizeof(what), "updated resource read back TOC only (%s)", label);
+  check(element_is(rl, name, newdata, datalen), what);
+}
+
+// Bytes left past the archive by an interrupted append don't stop it being
+// read or updated again...
+static void test_update_after_interrupted()
+{
+  check(write_test_archive(false), "write archive");
+  FILE *fileid = fopen(TEST_ARCHIVE, "ab");
+  unsigned char junk[1000];
+  memset (junk, 0x5A, sizeof(junk));
+  check((fileid!=NULL) && (fwrite(junk,1,sizeof(junk),fileid)==sizeof(junk)) && (fclose(fileid)==0), "append junk past archive");
+
+  pleo_archive_type archive;
+  check(archive.read_archive_file(TEST_ARCHIVE, PLEO_ARCHIVE_FLAG_VERIFY)>0, "archive with junk past it verifies");
+
+  unsigned char newdata[800];
+  for (int i=0; i<(int)sizeof(newdata); i++) newdata[i] = (unsigned char)(i*5);
+  check(pleo_archive_type().update_archive_file(TEST_ARCHIVE, PLEO_TOC_SOUND, "c", newdata, sizeof(newdata))==1, "update over junk");
+  pleo_archive_type updated;
+  check(updated.read_archive_file(TEST_ARCHIVE, PLEO_ARCHIVE_FLAG_VERIFY)>0, "archive updated over junk verifies");
+  check(element_is(&updated.m_sounds, "c", newdata, sizeof(newdata)), "sound added over junk read back");
+  check_untouched(&updated, "c", "updated over junk");
+}
+
+// Replace sound a with data of the same length, check size & contents...
+static void test_update_inplace(bool with_filler)
+{
+  char what[128];
+  const char *label = with_filler ? "with filler" : "no filler";
+  check(write_test_archive(with_filler), "write archive");
+  long before = file_size(TEST_ARCHIVE);
+
+  unsigned char newdata[500];
+  for (int i=0; i<(int)sizeof(newdata); i++) newdata[i] = (unsigned char)(255-i);
+  int result = pleo_archive_type().update_archive_file(TEST_ARCHIVE, PLEO_TOC_SOUND, "a", newdata, sizeof(newdata));
+  snprintf(what, sizeof(what), "update sound (%s)", label);
+  check(result==1, what);
+
+  snprintf(what, sizeof(what), "archive size unchanged (%s): %ld -> %ld", label, before, file_size(TEST_ARCHIVE));
+  check(file_size(TEST_ARCHIVE)==before, what);
+
+  pleo_archive_type archive;
+  snprintf(what, sizeof(what), "updated archive verifies (%s)", label);
+  check(archive.read_archive_file(TEST_ARCHIVE, PLEO_ARCHIVE_FLAG_VERIFY)>0, what);
+
+  int datalen = 0;
+  unsigned char *dataptr = archive.m_sounds.get_element_dataptr(archive.m_sounds.get_element_index("a"), NULL, &datalen);
+  snprintf(what, sizeof(what), "updated sound read back (%s)", label);
+  check((dataptr!=NULL) && (datalen==(int)sizeof(newdata)) && (memcmp(dataptr,newdata,datalen)==0), what);
+  snprintf(what, sizeof(what), "filler kept (%s)", label);
+  check(archive.m_sounds.m_count==(with_filler ? 3 : 2), what);
+}
+
+// Append that can't be written (file size limit) fails, leaving the original
+// archive readable & unchanged...
+static void test_update_failed_append()
+{
+  check(write_test_archive(false), "write archive");
+  long before = file_size(TEST_ARCHIVE);
+
+  struct rlimit oldlimit, limit;
+  getrlimit(RLIMIT_FSIZE, &oldlimit);
+  limit = oldlimit;
+  limit.rlim_cur = before+600;
+  signal(SIGXFSZ, SIG_IGN);
+  setrlimit(RLIMIT_FSIZE, &limit);
+  unsigned char newdata[2000];
+  memset (newdata, 0x33, sizeof(newdata));
+  int result = pleo_archive_type().update_archive_file(TEST_ARCHIVE, PLEO_TOC_SOUND, "b", newdata, sizeof(newdata));
+  setrlimit(RLIMIT_FSIZE, &oldlimit);
+  signal(SIGXFSZ, SIG_DFL);
+  check(result==-1, "append past file size limit fails");
+
+  pleo_archive_type archive;
+  check(archive.read_archive_file(TEST_ARCHIVE, PLEO_ARCHIVE_FLAG_VERIFY)>0, "archive after failed append verifies");
+  check_untouched(&archive, "", "after failed append");
+}
+
+// Archive read TOC only & written over itself: lazy payloads are copied from
+// the original file, not loaded, & the rewritten archive reads back intact...
+static void test_write_lazy()
+{
+  check(write_test_archive(true), "write archive");
+  pleo_archive_type lazy;
+  check(lazy.read_archive_toc(TEST_ARCHIVE, PLEO_ARCHIVE_FLAG_VERIFY)>0, "read archive TOC only");
+  check(lazy.write_archive_file(TEST_ARCHIVE)==1, "write TOC only archive over itself");
+
+  bool still_lazy = true;
+  for (int i=0; i<lazy.m_sounds.m_count; i++)
+    if ((lazy.m_sounds.m_resource_list[i].m_element_size>0) &&
+        ((lazy.m_sounds.m_resource_list[i].m_element_flags & RESOURCE_ELEMENT_LAZY)==0)) still_lazy = false;
+  check(still_lazy, "lazy sounds not loaded by write");
+
+  pleo_archive_type archive;
+  check(archive.read_archive_file(TEST_ARCHIVE, PLEO_ARCHIVE_FLAG_VERIFY)>0, "rewritten archive verifies");
+  check_untouched(&archive, "", "rewritten from TOC only");
+  check_untouched(&lazy, "", "lazy after rewrite");
+}
+
+// Writing through a symlink replaces the file it points at, keeping the link
+// & the file's mode, & never touches an existing "<target>.tmp"...
+static void test_write_replaces_target()
+{
+  check(write_test_archive(false), "write archive");
+  chmod (TEST_ARCHIVE, 0640);
+  remove (TEST_LINK);
+  check(symlink(TEST_ARCHIVE, TEST_LINK)==0, "symlink to archive");
+  FILE *fileid = fopen(TEST_VICTIM, "w");
+  check((fileid!=NULL) && (fputs("victim", fileid)>=0) && (fclose(fileid)==0), "write victim file");
+  remove (TEST_LINK ".tmp");
+  check(symlink(TEST_VICTIM, TEST_LINK ".tmp")==0, "symlink <target>.tmp to victim");
+
+  pleo_archive_type archive;
+  check(archive.read_archive_file(TEST_ARCHIVE, PLEO_ARCHIVE_FLAG_VERIFY)>0, "read archive");
+  check(archive.write_archive_file(TEST_LINK)==1, "write archive through symlink");
+
+  struct stat st;
+  check((lstat(TEST_LINK, &st)==0) && S_ISLNK(st.st_mode), "symlink kept");
+  check((stat(TEST_ARCHIVE, &st)==0) && ((st.st_mode & 07777)==0640), "target mode kept");
+  check(file_size(TEST_VICTIM)==6, "<target>.tmp left alone");
+  pleo_archive_type written;
+  check(written.read_archive_file(TEST_ARCHIVE, PLEO_ARCHIVE_FLAG_VERIFY)>0, "archive written through symlink verifies");
+  check_untouched(&written, "", "written through symlink");
+
+  remove (TEST_LINK ".tmp");
+  remove (TEST_LINK);
+  remove (TEST_VICTIM);
+}
+
+int main()
+{
+  test_update_inplace(false);
+  test_update_inplace(true);
+  test_update_append(PLEO_TOC_SOUND, "b", 2000, "grown sound");
+  test_update_append(PLEO_TOC_SOUND, "c", 1000, "new sound");
+  test_update_append(PLEO_TOC_SCRIPT, "main", 1500, "grown script");
+  test_update_append(PLEO_TOC_PROPERTY, "mode", 4, "new property");
+  test_update_after_interrupted();
+  test_update_failed_append();
+  test_write_lazy();
+  test_write_replaces_target();
+  remove(TEST_ARCHIVE);
+
+  if (g_failures) printf("%d check(s) failed\n", g_failures);
+  return g_failures ? 1 : 0;
+}
@@ -0,0 +1,92 @@
+#
+# Copyright (c) 2010 John of dogsbodynet.com
+#                    Gareth Nelson
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+
+""" parse_upf: the SWIG reader (pleofiles/_pleoproject.so) & the
+    BeautifulSoup fallback give the same result for a project
+"""
+import os
+import sys
+import pprint
+
+sys.path.insert(0,os.path.join(os.path.dirname(os.path.abspath(__file__)),'..','..'))
+import parse_upf
+
+SAMPLE_UPF = os.path.join(os.path.dirname(os.path.abspath(__file__)),'..','..','test_project','motion_example.upf')
+
+# set/set-default precedence, variables used before they're set, unknown
+# variables, entities & options nested below <options>...
+TRICKY_UPF = """<?xml version="1.0"?>
+<ugobe_project name="tricky &amp; co">
+  <set name="BASE" value="${ROOT}/base" />
+  <set-default name="ROOT" value="/default" />
+  <set name="ROOT" value="/root" />
+  <set-default name="ROOT" value="/ignored" />
+  <set-default name="OTHER" value="${UNKNOWN}/x" />
+  <options>
+    <set name="INC" value="${BASE}/include" />
+    <include value="${INC}::&lt;extra&gt;" />
+    <tools>
+      <pawn value="pawncc &quot;%i&quot;" />
+      <empty />
+    </tools>
+    <include value="later" />
+  </options>
+  <resources>
+    <!-- <sound path="commented.wav" /> -->
+    <script path="${BASE}/main.p" />
+    <sound path="${OTHER}/a.wav" />
+    <command path="${ROOT}/c.txt" />
+    <motion path="m&#46;csv" />
+  </resources>
+</ugobe_project>
+"""
+
+failures = 0
+
+def check(ok,what):
+    global failures
+    if ok:
+       print 'ok: %s' % what
+    else:
+       print 'FAILED: %s' % what
+       failures += 1
+
+def compare(s,what):
+    project = parse_upf.pleoproject.pleo_project_type()
+    check(project.read_project_image(s,len(s)) >= 0,'%s read by SWIG reader' % what)
+    native = parse_upf.read_native_project(project)
+    soup = parse_upf.parse_upf_soup(s)
+    if native != soup:
+       pprint.pprint(native)
+       pprint.pprint(soup)
+    check(native == soup,'%s same from SWIG reader & BeautifulSoup' % what)
+
+if __name__ == '__main__':
+   if parse_upf.pleoproject is None:
+      print 'skipped: pleofiles/_pleoproject.so not built (make -C pleofiles)'
+      sys.exit(0)
+   f = open(SAMPLE_UPF,'r')
+   compare(f.read(),'motion_example.upf')
+   f.close()
+   compare(TRICKY_UPF,'tricky project')
+   sys.exit(failures != 0)
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2010 John of dogsbodynet.com
+ *                    Gareth Nelson
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+//
+// extract_usf_clip_image: clips cut from plain & blocked ADPCM sources are
+// compared sample by sample with the decoded source.  The worst error is
+// checked, not just how many samples differ: past the start of a plain
+// clip (whose decoder starts from zero) it must stay within a few 8-bit
+// steps, & no clip may be worse than decoding & re-encoding the slice...
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../pleosound.h"
+
+#define TEST_SAMPLES 60000
+#define TEST_CLIPS 100
+#define TEST_SAMPLES_PER_BLOCK 2048
+#define TEST_STARTUP 32   // plain clip samples allowed to ramp up from zero
+#define TEST_MAX_ERROR 12 // worst error past start-up (8-bit steps)
+
+static int g_failures = 0;
+
+static void check(bool ok, const char *what)
+{
+  printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+  if (!ok) g_failures++;
+}
+
+static unsigned int g_random = 1;
+static int test_random(int range)
+{
+  g_random = g_random*1103515245 + 12345;
+  return (int)((g_random>>8) % (unsigned int)range);
+}
+
+// Tones near full scale, with stretches of noise (8-bit unsigned)...
+static void make_test_wave(unsigned char *pcm, int count)
+{
+  for (int i=0; i<count; i++) {
+    double t = i/22050.0;
+    double v = 0.55*sin(2*M_PI*220*t) + 0.25*sin(2*M_PI*1375*t+1) + 0.15*sin(2*M_PI*3100*t);
+    if ((i/5000)%4==1) v += 0.35*(test_random(2001)-1000)/1000.0;
+    int sample = (int)(v*0.95*127) + 128;
+    pcm[i] = (unsigned char)((sample<0) ? 0 : (sample>255) ? 255 : sample);
+  }
+}
+
+// USF image of ADPCM data (samples_per_block 0 = plain)...
+static unsigned char *make_usf_image(const unsigned char *adpcm, int adpcmlen, int samples_per_block, int *imagelen)
+{
+  int hdrlen = sizeof(pleo_usf_sound_hdrtype)+USF_NAME_MAXLEN+sizeof(pleo_usf_sound_infotype);
+  if (samples_per_block) hdrlen += sizeof(pleo_usf_adpcm_blockinfotype);
+  unsigned char *image = (unsigned char *)calloc(1, hdrlen+adpcmlen);
+  memcpy (image, "UGSF", 4);
+  image[4] = 1;
+  strcpy ((char *)&image[sizeof(pleo_usf_sound_hdrtype)], "test");
+
+  pleo_usf_sound_infotype info;
+  info.adpcm = samples_per_block ? 2 : 1;
+  info.bits_per_sample = 8;
+  info.num_channels = 1;
+  info.samples_per_sec = 22050;
+  info.loop_count = 0;
+  info.num_samples = 0xFFFFFFFF;
+  memcpy (&image[sizeof(pleo_usf_sound_hdrtype)+USF_NAME_MAXLEN], &info, sizeof(info));
+  if (samples_per_block) {
+    pleo_usf_adpcm_blockinfotype blockinfo;
+    blockinfo.samples_per_block = (unsigned short)samples_per_block;
+    memcpy (&image[hdrlen-sizeof(blockinfo)], &blockinfo, sizeof(blockinfo));
+  }
+  memcpy (&image[hdrlen], adpcm, adpcmlen);
+  *imagelen = hdrlen+adpcmlen;
+  return image;
+}
+
+// Decode count samples of a USF image made above (or clipped from one)...
+static short *decode_usf_image(pleo_sound_type &sound, unsigned char *image, int imagelen, int count)
+{
+  int hdrlen = sizeof(pleo_usf_sound_hdrtype)+USF_NAME_MAXLEN+sizeof(pleo_usf_sound_infotype);
+  pleo_usf_sound_infotype info;
+  memcpy (&info, &image[hdrlen-sizeof(info)], sizeof(info));
+  unsigned char *pcm = NULL;
+  int pcmlen;
+  if (info.adpcm==1)
+    sound.pleo_sound_convert_adpcm2pcm(&image[hdrlen], imagelen-hdrlen, &pcm, &pcmlen, 2);
+  else {
+    pleo_usf_adpcm_blockinfotype blockinfo;
+    memcpy (&blockinfo, &image[hdrlen], sizeof(blockinfo));
+    hdrlen += sizeof(blockinfo);
+    sound.pleo_sound_convert_adpcm2pcm_blocked(&image[hdrlen], imagelen-hdrlen, blockinfo.samples_per_block, 0, count, &pcm, &pcmlen, 2);
+  }
+  return (short *)pcm;
+}
+
+// Worst error of decode & re-encode of decoded source samples...
+static int reencoded_error(pleo_sound_type &sound, const short *source, int count, int samples_per_block)
+{
+  unsigned char *adpcm = NULL, *pcm = NULL;
+  int adpcmlen, pcmlen;
+  if (samples_per_block) {
+    sound.pleo_sound_convert_pcm2adpcm_blocked((unsigned char *)source, 2*count, 2, &adpcm, &adpcmlen, samples_per_block);
+    sound.pleo_sound_convert_adpcm2pcm_blocked(adpcm, adpcmlen, samples_per_block, 0, count, &pcm, &pcmlen, 2);
+  }
+  else {
+    sound.pleo_sound_convert_pcm2adpcm((unsigned char *)source, 2*count, 2, &adpcm, &adpcmlen);
+    sound.pleo_sound_convert_adpcm2pcm(adpcm, adpcmlen, &pcm, &pcmlen, 2);
+  }
+  int worst = 0;
+  for (int i=0; i<count; i++) {
+    int error = abs(((short *)pcm)[i]-source[i]);
+    if (error>worst) worst = error;
+  }
+  free(adpcm);
+  free(pcm);
+  return worst;
+}
+
+static void test_clips(const unsigned char *wave, int samples_per_block)
+{
+  char what[160];
+  const char *label = samples_per_block ? "blocked" : "plain";
+  pleo_sound_type sound;
+
+  unsigned char *adpcm = NULL;
+  int adpcmlen = 0;
+  if (samples_per_block) sound.pleo_sound_convert_pcm2adpcm_blocked((unsigned char *)wave, TEST_SAMPLES, 1, &adpcm, &adpcmlen, samples_per_block);
+  else sound.pleo_sound_convert_pcm2adpcm((unsigned char *)wave, TEST_SAMPLES, 1, &adpcm, &adpcmlen);
+  int imagelen;
+  unsigned char *image = make_usf_image(adpcm, adpcmlen, samples_per_block, &imagelen);
+  short *source = decode_usf_image(sound, image, imagelen, TEST_SAMPLES);
+
+  int worst = 0, worst_running = 0, worst_reencoded = 0;
+  long differ = 0, total = 0;
+  bool extracted = true;
+  for (int clip=0; clip<TEST_CLIPS; clip++) {
+    int start = test_random(TEST_SAMPLES-1000);
+    int count = 2*(1+test_random((TEST_SAMPLES-start)/2));
+    if (clip==0) start = samples_per_block; // on a block boundary (plain: any start)
+    if (start+count>TEST_SAMPLES) count = (TEST_SAMPLES-start) & ~1;
+
+    int cliplen, error;
+    unsigned char *clipimage = sound.extract_usf_clip_image(NULL, image, imagelen, start, start+count, &cliplen, 0, &error);
+    if (clipimage==NULL) {
+      extracted = false;
+      continue;
+    }
+    short *clipped = decode_usf_image(sound, clipimage, cliplen, count);
+    for (int i=0; i<count; i++) {
+      int sample_error = abs(clipped[i]-source[start+i]);
+      if (sample_error) differ++;
+      if (sample_error>worst) worst = sample_error;
+      if (((i>=TEST_STARTUP) || samples_per_block) && (sample_error>worst_running)) worst_running = sample_error;
+    }
+    total += count;
+    int reencoded = reencoded_error(sound, &source[start], count, samples_per_block);
+    if (reencoded>worst_reencoded) worst_reencoded = reencoded;
+    free(clipped);
+    free(clipimage);
+  }
+
+  snprintf(what, sizeof(what), "%s clips extracted", label);
+  check(extracted, what);
+  snprintf(what, sizeof(what), "%s worst error past start-up: %d (limit %d)", label, worst_running, TEST_MAX_ERROR);
+  check(worst_running<=TEST_MAX_ERROR, what);
+  snprintf(what, sizeof(what), "%s worst error: %d (decode & re-encode %d)", label, worst, worst_reencoded);
+  check(worst<=worst_reencoded, what);
+  snprintf(what, sizeof(what), "%s samples differing: %.2f%%", label, 100.0*differ/total);
+  check(differ*50<total, what);
+
+  free(source);
+  free(image);
+  free(adpcm);
+}
+
+int main()
+{
+  unsigned char *wave = (unsigned char *)malloc(TEST_SAMPLES);
+  make_test_wave(wave, TEST_SAMPLES);
+  test_clips(wave, 0);
+  test_clips(wave, TEST_SAMPLES_PER_BLOCK);
+  free(wave);
+
+  if (g_failures) printf("%d check(s) failed\n", g_failures);
+  return g_failures ? 1 : 0;
+}